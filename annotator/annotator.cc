@@ -18,7 +18,9 @@
 #include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <functional>
 #include <iterator>
+#include <map>
 #include <numeric>
 #include <string>
 #include <unordered_map>
@@ -38,9 +40,12 @@
 #include "utils/normalization.h"
 #include "utils/optional.h"
 #include "utils/regex-match.h"
+#include "utils/regex-prefilter.h"
+#include "utils/stage-trace.h"
 #include "utils/strings/append.h"
 #include "utils/strings/numbers.h"
 #include "utils/strings/split.h"
+#include "utils/thread-pool.h"
 #include "utils/utf8/unicodetext.h"
 #include "utils/utf8/unilib-common.h"
 #include "utils/zlib/zlib_regex.h"
@@ -159,10 +164,24 @@ DateAnnotationOptions ToDateAnnotationOptions(
 
 }  // namespace
 
+InterpreterManager::~InterpreterManager() {
+  if (selection_interpreter_pool_ != nullptr) {
+    selection_interpreter_pool_->Release(std::move(selection_interpreter_));
+  }
+  if (classification_interpreter_pool_ != nullptr) {
+    classification_interpreter_pool_->Release(
+        std::move(classification_interpreter_));
+  }
+}
+
 tflite::Interpreter* InterpreterManager::SelectionInterpreter() {
   if (!selection_interpreter_) {
-    TC3_CHECK(selection_executor_);
-    selection_interpreter_ = selection_executor_->CreateInterpreter();
+    if (selection_interpreter_pool_ != nullptr) {
+      selection_interpreter_ = selection_interpreter_pool_->Acquire();
+    } else {
+      TC3_CHECK(selection_executor_);
+      selection_interpreter_ = selection_executor_->CreateInterpreter();
+    }
     if (!selection_interpreter_) {
       TC3_LOG(ERROR) << "Could not build TFLite interpreter.";
     }
@@ -172,8 +191,13 @@ tflite::Interpreter* InterpreterManager::SelectionInterpreter() {
 
 tflite::Interpreter* InterpreterManager::ClassificationInterpreter() {
   if (!classification_interpreter_) {
-    TC3_CHECK(classification_executor_);
-    classification_interpreter_ = classification_executor_->CreateInterpreter();
+    if (classification_interpreter_pool_ != nullptr) {
+      classification_interpreter_ = classification_interpreter_pool_->Acquire();
+    } else {
+      TC3_CHECK(classification_executor_);
+      classification_interpreter_ =
+          classification_executor_->CreateInterpreter();
+    }
     if (!classification_interpreter_) {
       TC3_LOG(ERROR) << "Could not build TFLite interpreter.";
     }
@@ -366,6 +390,8 @@ void Annotator::ValidateAndInitialize(const Model* model, const UniLib* unilib,
       TC3_LOG(ERROR) << "Could not initialize selection executor.";
       return;
     }
+    selection_interpreter_pool_.reset(new TfLiteInterpreterPool(
+        selection_executor_.get(), kMaxPooledInterpreters));
     selection_feature_processor_.reset(
         new FeatureProcessor(model_->selection_feature_options(), unilib_));
   }
@@ -401,6 +427,8 @@ void Annotator::ValidateAndInitialize(const Model* model, const UniLib* unilib,
       TC3_LOG(ERROR) << "Could not initialize classification executor.";
       return;
     }
+    classification_interpreter_pool_.reset(new TfLiteInterpreterPool(
+        classification_executor_.get(), kMaxPooledInterpreters));
 
     classification_feature_processor_.reset(new FeatureProcessor(
         model_->classification_feature_options(), unilib_));
@@ -593,11 +621,13 @@ bool Annotator::InitializeRegexModel(ZlibDecompressor* decompressor) {
   // Initialize pattern recognizers.
   int regex_pattern_id = 0;
   for (const auto regex_pattern : *model_->regex_model()->patterns()) {
+    std::string pattern_text;
     std::unique_ptr<UniLib::RegexPattern> compiled_pattern =
         UncompressMakeRegexPattern(
             *unilib_, regex_pattern->pattern(),
             regex_pattern->compressed_pattern(),
-            model_->regex_model()->lazy_regex_compilation(), decompressor);
+            model_->regex_model()->lazy_regex_compilation(), decompressor,
+            &pattern_text);
     if (!compiled_pattern) {
       TC3_LOG(INFO) << "Failed to load regex pattern";
       return false;
@@ -615,6 +645,7 @@ bool Annotator::InitializeRegexModel(ZlibDecompressor* decompressor) {
     regex_patterns_.push_back({
         regex_pattern,
         std::move(compiled_pattern),
+        ExtractRequiredLiteral(pattern_text),
     });
     ++regex_pattern_id;
   }
@@ -622,6 +653,17 @@ bool Annotator::InitializeRegexModel(ZlibDecompressor* decompressor) {
   return true;
 }
 
+bool Annotator::CompileLazyRegexPatterns() const {
+  bool success = true;
+  for (const CompiledRegexPattern& regex_pattern : regex_patterns_) {
+    success &= regex_pattern.pattern->Compile();
+  }
+  if (datetime_parser_ != nullptr) {
+    success &= datetime_parser_->CompileLazyRegexPatterns();
+  }
+  return success;
+}
+
 bool Annotator::InitializeKnowledgeEngine(
     const std::string& serialized_config) {
   std::unique_ptr<KnowledgeEngine> knowledge_engine(new KnowledgeEngine());
@@ -912,32 +954,47 @@ CodepointSpan Annotator::SuggestSelection(
   // As we process a single string of context, the candidates will only
   // contain one vector of AnnotatedSpan.
   candidates.annotated_spans.resize(1);
-  InterpreterManager interpreter_manager(selection_executor_.get(),
-                                         classification_executor_.get());
+  InterpreterManager interpreter_manager(
+      selection_interpreter_pool_.get(),
+      classification_interpreter_pool_.get());
   std::vector<Token> tokens;
-  if (!ModelSuggestSelection(context_unicode, click_indices,
-                             detected_text_language_tags, &interpreter_manager,
-                             &tokens, &candidates.annotated_spans[0])) {
-    TC3_LOG(ERROR) << "Model suggest selection failed.";
-    return original_click_indices;
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "ModelSuggestSelection",
+                    &candidates.annotated_spans[0]);
+    if (!ModelSuggestSelection(context_unicode, click_indices,
+                               detected_text_language_tags,
+                               &interpreter_manager, &tokens,
+                               &candidates.annotated_spans[0])) {
+      TC3_LOG(ERROR) << "Model suggest selection failed.";
+      return original_click_indices;
+    }
   }
   const std::unordered_set<std::string> set;
   const EnabledEntityTypes is_entity_type_enabled(set);
-  if (!RegexChunk(context_unicode, selection_regex_patterns_,
-                  /*is_serialized_entity_data_enabled=*/false,
-                  is_entity_type_enabled, options.annotation_usecase,
-                  &candidates.annotated_spans[0])) {
-    TC3_LOG(ERROR) << "Regex suggest selection failed.";
-    return original_click_indices;
-  }
-  if (!DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
-                     /*reference_time_ms_utc=*/0, /*reference_timezone=*/"",
-                     options.locales, ModeFlag_SELECTION,
-                     options.annotation_usecase,
-                     /*is_serialized_entity_data_enabled=*/false,
-                     &candidates.annotated_spans[0])) {
-    TC3_LOG(ERROR) << "Datetime suggest selection failed.";
-    return original_click_indices;
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "RegexChunk",
+                    &candidates.annotated_spans[0]);
+    if (!RegexChunk(context_unicode, selection_regex_patterns_,
+                    /*is_serialized_entity_data_enabled=*/false,
+                    is_entity_type_enabled, options.annotation_usecase,
+                    options.use_regex_literal_prefilter,
+                    &candidates.annotated_spans[0])) {
+      TC3_LOG(ERROR) << "Regex suggest selection failed.";
+      return original_click_indices;
+    }
+  }
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "DatetimeChunk",
+                    &candidates.annotated_spans[0]);
+    if (!DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
+                       /*reference_time_ms_utc=*/0, /*reference_timezone=*/"",
+                       options.locales, ModeFlag_SELECTION,
+                       options.annotation_usecase,
+                       /*is_serialized_entity_data_enabled=*/false,
+                       &candidates.annotated_spans[0])) {
+      TC3_LOG(ERROR) << "Datetime suggest selection failed.";
+      return original_click_indices;
+    }
   }
   if (knowledge_engine_ != nullptr &&
       !knowledge_engine_->Chunk(context, options.annotation_usecase,
@@ -1007,11 +1064,15 @@ CodepointSpan Annotator::SuggestSelection(
             });
 
   std::vector<int> candidate_indices;
-  if (!ResolveConflicts(candidates.annotated_spans[0], context, tokens,
-                        detected_text_language_tags, options,
-                        &interpreter_manager, &candidate_indices)) {
-    TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
-    return original_click_indices;
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "ResolveConflicts",
+                    &candidate_indices);
+    if (!ResolveConflicts(candidates.annotated_spans[0], context, tokens,
+                          detected_text_language_tags, options,
+                          &interpreter_manager, &candidate_indices)) {
+      TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
+      return original_click_indices;
+    }
   }
 
   std::sort(candidate_indices.begin(), candidate_indices.end(),
@@ -1083,27 +1144,69 @@ bool Annotator::ResolveConflicts(
     std::vector<int>* result) const {
   result->clear();
   result->reserve(candidates.size());
+
+  // OPTIMIZATION: So that we don't have to classify all the ML model spans
+  // apriori, only the ones that conflict with something are classified, as
+  // their classification scores are needed to resolve the conflict. Collect
+  // them from all the conflicts first, to classify each distinct span once
+  // and all of them in a single batch.
+  std::vector<std::pair<int, int>> conflicts;
+  std::vector<CodepointSpan> model_spans;
+  std::vector<int> model_classification_indices(candidates.size(), -1);
+  std::map<CodepointSpan, int> model_span_indices;
   for (int i = 0; i < candidates.size();) {
-    int first_non_overlapping =
+    const int first_non_overlapping =
         FirstNonOverlappingSpanIndex(candidates, /*start_index=*/i);
-
     const bool conflict_found = first_non_overlapping != (i + 1);
     if (conflict_found) {
+      conflicts.push_back({i, first_non_overlapping});
+      for (int j = i; j < first_non_overlapping; ++j) {
+        if (!candidates[j].classification.empty()) {
+          continue;
+        }
+        const auto it_and_inserted = model_span_indices.insert(
+            {candidates[j].span, static_cast<int>(model_spans.size())});
+        if (it_and_inserted.second) {
+          model_spans.push_back(candidates[j].span);
+        }
+        model_classification_indices[j] = it_and_inserted.first->second;
+      }
+    }
+
+    // Skip over the whole conflicting group/go to next candidate.
+    i = first_non_overlapping;
+  }
+
+  std::vector<std::vector<ClassificationResult>> model_classifications;
+  if (!model_spans.empty()) {
+    // The context windows of the conflicting spans mostly overlap, share the
+    // embeddings of their tokens.
+    FeatureProcessor::EmbeddingCache embedding_cache;
+    if (!ModelClassifyTextBatch(context, cached_tokens,
+                                detected_text_language_tags, model_spans,
+                                options, interpreter_manager, &embedding_cache,
+                                &model_classifications)) {
+      return false;
+    }
+  }
+
+  auto conflict = conflicts.begin();
+  for (int i = 0; i < candidates.size();) {
+    if (conflict != conflicts.end() && conflict->first == i) {
       std::vector<int> candidate_indices;
-      if (!ResolveConflict(context, cached_tokens, candidates,
-                           detected_text_language_tags, i,
-                           first_non_overlapping, options, interpreter_manager,
-                           &candidate_indices)) {
+      if (!ResolveConflict(candidates, model_classifications,
+                           model_classification_indices, conflict->first,
+                           conflict->second, options, &candidate_indices)) {
         return false;
       }
       result->insert(result->end(), candidate_indices.begin(),
                      candidate_indices.end());
+      i = conflict->second;
+      ++conflict;
     } else {
       result->push_back(i);
+      ++i;
     }
-
-    // Skip over the whole conflicting group/go to next candidate.
-    i = first_non_overlapping;
   }
   return true;
 }
@@ -1156,35 +1259,20 @@ bool DoSourcesConflict(AnnotationUsecase annotation_usecase,
 }  // namespace
 
 bool Annotator::ResolveConflict(
-    const std::string& context, const std::vector<Token>& cached_tokens,
     const std::vector<AnnotatedSpan>& candidates,
-    const std::vector<Locale>& detected_text_language_tags, int start_index,
+    const std::vector<std::vector<ClassificationResult>>&
+        model_classifications,
+    const std::vector<int>& model_classification_indices, int start_index,
     int end_index, const BaseOptions& options,
-    InterpreterManager* interpreter_manager,
     std::vector<int>* chosen_indices) const {
   std::vector<int> conflicting_indices;
   std::unordered_map<int, std::pair<float, int>> scores_lengths;
   for (int i = start_index; i < end_index; ++i) {
     conflicting_indices.push_back(i);
-    if (!candidates[i].classification.empty()) {
-      scores_lengths[i] = {
-          GetPriorityScore(candidates[i].classification),
-          candidates[i].span.second - candidates[i].span.first};
-      continue;
-    }
-
-    // OPTIMIZATION: So that we don't have to classify all the ML model
-    // spans apriori, we wait until we get here, when they conflict with
-    // something and we need the actual classification scores. So if the
-    // candidate conflicts and comes from the model, we need to run a
-    // classification to determine its priority:
-    std::vector<ClassificationResult> classification;
-    if (!ModelClassifyText(context, cached_tokens, detected_text_language_tags,
-                           candidates[i].span, options, interpreter_manager,
-                           /*embedding_cache=*/nullptr, &classification)) {
-      return false;
-    }
-
+    const std::vector<ClassificationResult>& classification =
+        candidates[i].classification.empty()
+            ? model_classifications[model_classification_indices[i]]
+            : candidates[i].classification;
     if (!classification.empty()) {
       scores_lengths[i] = {
           GetPriorityScore(classification),
@@ -1194,7 +1282,7 @@ bool Annotator::ResolveConflict(
 
   std::sort(
       conflicting_indices.begin(), conflicting_indices.end(),
-      [this, &scores_lengths, candidates, conflicting_indices](int i, int j) {
+      [this, &scores_lengths](int i, int j) {
         if (scores_lengths[i].first == scores_lengths[j].first &&
             prioritize_longest_annotation_) {
           return scores_lengths[i].second > scores_lengths[j].second;
@@ -1341,7 +1429,7 @@ bool Annotator::ModelSuggestSelection(
           *tokens, extraction_span,
           /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
           embedding_executor_.get(),
-          /*embedding_cache=*/nullptr,
+          /*embedding_cache=*/nullptr, selection_token_embedding_cache_.get(),
           selection_feature_processor_->EmbeddingSize() +
               selection_feature_processor_->DenseFeaturesCount(),
           &cached_features)) {
@@ -1483,6 +1571,125 @@ bool Annotator::ModelClassifyText(
     return true;
   }
 
+  ModelClassificationInput input;
+  if (!PrepareModelClassification(context, cached_tokens, selection_indices,
+                                  embedding_cache, tokens, &input)) {
+    return false;
+  }
+  if (input.is_final) {
+    *classification_results = std::move(input.classification_results);
+    return true;
+  }
+
+  TensorView<float> logits = classification_executor_->ComputeLogits(
+      TensorView<float>(input.features.data(),
+                        {1, static_cast<int>(input.features.size())}),
+      interpreter_manager->ClassificationInterpreter());
+  if (!logits.is_valid()) {
+    TC3_LOG(ERROR) << "Couldn't compute logits.";
+    return false;
+  }
+
+  if (logits.dims() != 2 || logits.dim(0) != 1 ||
+      logits.dim(1) != classification_feature_processor_->NumCollections()) {
+    TC3_LOG(ERROR) << "Mismatching output";
+    return false;
+  }
+
+  LogitsToModelClassification(context, detected_text_language_tags,
+                              selection_indices, input.selection_num_tokens,
+                              options, logits.data(), logits.dim(1),
+                              classification_results);
+  return true;
+}
+
+bool Annotator::ModelClassifyTextBatch(
+    const std::string& context, const std::vector<Token>& cached_tokens,
+    const std::vector<Locale>& detected_text_language_tags,
+    const std::vector<CodepointSpan>& selection_indices,
+    const BaseOptions& options, InterpreterManager* interpreter_manager,
+    FeatureProcessor::EmbeddingCache* embedding_cache,
+    std::vector<std::vector<ClassificationResult>>* classification_results)
+    const {
+  classification_results->clear();
+  classification_results->resize(selection_indices.size());
+
+  if (model_->triggering_options() == nullptr ||
+      !(model_->triggering_options()->enabled_modes() &
+        ModeFlag_CLASSIFICATION)) {
+    return true;
+  }
+
+  if (!Locale::IsAnyLocaleSupported(detected_text_language_tags,
+                                    ml_model_triggering_locales_,
+                                    /*default_value=*/true)) {
+    return true;
+  }
+
+  // Extract the features of all the spans and stack them into one batch.
+  std::vector<ModelClassificationInput> inputs(selection_indices.size());
+  std::vector<int> batch_indices;
+  std::vector<float> batch_features;
+  int num_features = -1;
+  std::vector<Token> tokens;
+  for (int i = 0; i < selection_indices.size(); i++) {
+    if (!PrepareModelClassification(context, cached_tokens,
+                                    selection_indices[i], embedding_cache,
+                                    &tokens, &inputs[i])) {
+      return false;
+    }
+    if (inputs[i].is_final) {
+      (*classification_results)[i] =
+          std::move(inputs[i].classification_results);
+      continue;
+    }
+    if (num_features == -1) {
+      num_features = inputs[i].features.size();
+      batch_features.reserve(selection_indices.size() * num_features);
+    } else if (num_features != inputs[i].features.size()) {
+      TC3_LOG(ERROR) << "Mismatching feature sizes in batch.";
+      return false;
+    }
+    batch_features.insert(batch_features.end(), inputs[i].features.begin(),
+                          inputs[i].features.end());
+    batch_indices.push_back(i);
+  }
+
+  if (batch_indices.empty()) {
+    return true;
+  }
+
+  const int batch_size = batch_indices.size();
+  TensorView<float> logits = classification_executor_->ComputeLogits(
+      TensorView<float>(batch_features.data(), {batch_size, num_features}),
+      interpreter_manager->ClassificationInterpreter());
+  if (!logits.is_valid()) {
+    TC3_LOG(ERROR) << "Couldn't compute logits.";
+    return false;
+  }
+
+  if (logits.dims() != 2 || logits.dim(0) != batch_size ||
+      logits.dim(1) != classification_feature_processor_->NumCollections()) {
+    TC3_LOG(ERROR) << "Mismatching output";
+    return false;
+  }
+
+  for (int j = 0; j < batch_size; j++) {
+    const int i = batch_indices[j];
+    LogitsToModelClassification(
+        context, detected_text_language_tags, selection_indices[i],
+        inputs[i].selection_num_tokens, options,
+        logits.data() + j * logits.dim(1), logits.dim(1),
+        &(*classification_results)[i]);
+  }
+  return true;
+}
+
+bool Annotator::PrepareModelClassification(
+    const std::string& context, const std::vector<Token>& cached_tokens,
+    const CodepointSpan& selection_indices,
+    FeatureProcessor::EmbeddingCache* embedding_cache,
+    std::vector<Token>* tokens, ModelClassificationInput* input) const {
   if (cached_tokens.empty()) {
     *tokens = classification_feature_processor_->Tokenize(context);
   } else {
@@ -1499,10 +1706,12 @@ bool Annotator::ModelClassifyText(
   const TokenSpan selection_token_span =
       CodepointSpanToTokenSpan(*tokens, selection_indices);
   const int selection_num_tokens = selection_token_span.Size();
+  input->selection_num_tokens = selection_num_tokens;
   if (model_->classification_options()->max_num_tokens() > 0 &&
       model_->classification_options()->max_num_tokens() <
           selection_num_tokens) {
-    *classification_results = {{Collections::Other(), 1.0}};
+    input->is_final = true;
+    input->classification_results = {{Collections::Other(), 1.0}};
     return true;
   }
 
@@ -1541,7 +1750,8 @@ bool Annotator::ModelClassifyText(
 
   if (!classification_feature_processor_->HasEnoughSupportedCodepoints(
           *tokens, extraction_span)) {
-    *classification_results = {{Collections::Other(), 1.0}};
+    input->is_final = true;
+    input->classification_results = {{Collections::Other(), 1.0}};
     return true;
   }
 
@@ -1549,6 +1759,7 @@ bool Annotator::ModelClassifyText(
   if (!classification_feature_processor_->ExtractFeatures(
           *tokens, extraction_span, selection_indices,
           embedding_executor_.get(), embedding_cache,
+          classification_token_embedding_cache_.get(),
           classification_feature_processor_->EmbeddingSize() +
               classification_feature_processor_->DenseFeaturesCount(),
           &cached_features)) {
@@ -1556,36 +1767,29 @@ bool Annotator::ModelClassifyText(
     return false;
   }
 
-  std::vector<float> features;
-  features.reserve(cached_features->OutputFeaturesSize());
+  input->features.clear();
+  input->features.reserve(cached_features->OutputFeaturesSize());
   if (bounds_sensitive_features && bounds_sensitive_features->enabled()) {
     cached_features->AppendBoundsSensitiveFeaturesForSpan(selection_token_span,
-                                                          &features);
+                                                          &input->features);
   } else {
-    cached_features->AppendClickContextFeaturesForClick(click_pos, &features);
-  }
-
-  TensorView<float> logits = classification_executor_->ComputeLogits(
-      TensorView<float>(features.data(),
-                        {1, static_cast<int>(features.size())}),
-      interpreter_manager->ClassificationInterpreter());
-  if (!logits.is_valid()) {
-    TC3_LOG(ERROR) << "Couldn't compute logits.";
-    return false;
-  }
-
-  if (logits.dims() != 2 || logits.dim(0) != 1 ||
-      logits.dim(1) != classification_feature_processor_->NumCollections()) {
-    TC3_LOG(ERROR) << "Mismatching output";
-    return false;
+    cached_features->AppendClickContextFeaturesForClick(click_pos,
+                                                        &input->features);
   }
+  return true;
+}
 
-  const std::vector<float> scores =
-      ComputeSoftmax(logits.data(), logits.dim(1));
+void Annotator::LogitsToModelClassification(
+    const std::string& context,
+    const std::vector<Locale>& detected_text_language_tags,
+    const CodepointSpan& selection_indices, int selection_num_tokens,
+    const BaseOptions& options, const float* logits, int num_logits,
+    std::vector<ClassificationResult>* classification_results) const {
+  const std::vector<float> scores = ComputeSoftmax(logits, num_logits);
 
   if (scores.empty()) {
     *classification_results = {{Collections::Other(), 1.0}};
-    return true;
+    return;
   }
 
   const int best_score_index =
@@ -1601,13 +1805,13 @@ bool Annotator::ModelClassifyText(
         digit_count >
             model_->classification_options()->phone_max_num_digits()) {
       *classification_results = {{Collections::Other(), 1.0}};
-      return true;
+      return;
     }
   } else if (top_collection == Collections::Address()) {
     if (selection_num_tokens <
         model_->classification_options()->address_min_num_tokens()) {
       *classification_results = {{Collections::Other(), 1.0}};
-      return true;
+      return;
     }
   } else if (top_collection == Collections::Dictionary()) {
     if ((options.use_vocab_annotator && vocab_annotator_) ||
@@ -1615,7 +1819,7 @@ bool Annotator::ModelClassifyText(
                                       dictionary_locales_,
                                       /*default_value=*/false)) {
       *classification_results = {{Collections::Other(), 1.0}};
-      return true;
+      return;
     }
   }
   *classification_results = {{top_collection, /*arg_score=*/1.0,
@@ -1631,7 +1835,6 @@ bool Annotator::ModelClassifyText(
       (*classification_results)[0].priority_score *= entry->value();
     }
   }
-  return true;
 }
 
 bool Annotator::RegexClassifyText(
@@ -1836,8 +2039,11 @@ std::vector<ClassificationResult> Annotator::ClassifyText(
 
   // Try the regular expression models.
   std::vector<ClassificationResult> regex_results;
-  if (!RegexClassifyText(context, selection_indices, &regex_results)) {
-    return {};
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "RegexClassifyText", &regex_results);
+    if (!RegexClassifyText(context, selection_indices, &regex_results)) {
+      return {};
+    }
   }
   for (const ClassificationResult& result : regex_results) {
     candidates.push_back({selection_indices, {result}});
@@ -1850,9 +2056,13 @@ std::vector<ClassificationResult> Annotator::ClassifyText(
   // AnnotatedSpan, so that they get treated together by the conflict resolution
   // algorithm.
   std::vector<ClassificationResult> datetime_results;
-  if (!DatetimeClassifyText(context, selection_indices, options,
-                            &datetime_results)) {
-    return {};
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "DatetimeClassifyText",
+                    &datetime_results);
+    if (!DatetimeClassifyText(context, selection_indices, options,
+                              &datetime_results)) {
+      return {};
+    }
   }
   if (!datetime_results.empty()) {
     candidates.push_back({selection_indices, std::move(datetime_results)});
@@ -1925,26 +2135,34 @@ std::vector<ClassificationResult> Annotator::ClassifyText(
   // The output of the model is considered as an exclusive 1-of-N choice. That's
   // why it's inserted as only 1 AnnotatedSpan into candidates, as opposed to 1
   // span for each candidate, like e.g. the regex model.
-  InterpreterManager interpreter_manager(selection_executor_.get(),
-                                         classification_executor_.get());
+  InterpreterManager interpreter_manager(
+      selection_interpreter_pool_.get(),
+      classification_interpreter_pool_.get());
   std::vector<ClassificationResult> model_results;
   std::vector<Token> tokens;
-  if (!ModelClassifyText(
-          context, /*cached_tokens=*/{}, detected_text_language_tags,
-          selection_indices, options, &interpreter_manager,
-          /*embedding_cache=*/nullptr, &model_results, &tokens)) {
-    return {};
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "ModelClassifyText", &model_results);
+    if (!ModelClassifyText(
+            context, /*cached_tokens=*/{}, detected_text_language_tags,
+            selection_indices, options, &interpreter_manager,
+            /*embedding_cache=*/nullptr, &model_results, &tokens)) {
+      return {};
+    }
   }
   if (!model_results.empty()) {
     candidates.push_back({selection_indices, std::move(model_results)});
   }
 
   std::vector<int> candidate_indices;
-  if (!ResolveConflicts(candidates, context, tokens,
-                        detected_text_language_tags, options,
-                        &interpreter_manager, &candidate_indices)) {
-    TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
-    return {};
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "ResolveConflicts",
+                    &candidate_indices);
+    if (!ResolveConflicts(candidates, context, tokens,
+                          detected_text_language_tags, options,
+                          &interpreter_manager, &candidate_indices)) {
+      TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
+      return {};
+    }
   }
 
   std::vector<ClassificationResult> results;
@@ -2006,13 +2224,17 @@ bool Annotator::ModelAnnotate(
         UnicodeText::UTF8Substring(line.first, line.second);
 
     std::vector<Token> line_tokens;
-    line_tokens = selection_feature_processor_->Tokenize(line_str);
+    {
+      TC3_TRACE_STAGE(options.stage_trace, "Tokenize", &line_tokens);
+      line_tokens = selection_feature_processor_->Tokenize(line_str);
 
-    selection_feature_processor_->RetokenizeAndFindClick(
-        line_str, {0, std::distance(line.first, line.second)},
-        selection_feature_processor_->GetOptions()->only_use_line_with_click(),
-        &line_tokens,
-        /*click_pos=*/nullptr);
+      selection_feature_processor_->RetokenizeAndFindClick(
+          line_str, {0, std::distance(line.first, line.second)},
+          selection_feature_processor_->GetOptions()
+              ->only_use_line_with_click(),
+          &line_tokens,
+          /*click_pos=*/nullptr);
+    }
     const TokenSpan full_line_span = {
         0, static_cast<TokenIndex>(line_tokens.size())};
 
@@ -2023,24 +2245,31 @@ bool Annotator::ModelAnnotate(
     }
 
     std::unique_ptr<CachedFeatures> cached_features;
-    if (!selection_feature_processor_->ExtractFeatures(
-            line_tokens, full_line_span,
-            /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
-            embedding_executor_.get(),
-            /*embedding_cache=*/nullptr,
-            selection_feature_processor_->EmbeddingSize() +
-                selection_feature_processor_->DenseFeaturesCount(),
-            &cached_features)) {
-      TC3_LOG(ERROR) << "Could not extract features.";
-      return false;
+    {
+      TC3_TRACE_STAGE(options.stage_trace, "ExtractFeatures", nullptr);
+      if (!selection_feature_processor_->ExtractFeatures(
+              line_tokens, full_line_span,
+              /*selection_span_for_feature=*/{kInvalidIndex, kInvalidIndex},
+              embedding_executor_.get(),
+              /*embedding_cache=*/nullptr,
+              selection_token_embedding_cache_.get(),
+              selection_feature_processor_->EmbeddingSize() +
+                  selection_feature_processor_->DenseFeaturesCount(),
+              &cached_features)) {
+        TC3_LOG(ERROR) << "Could not extract features.";
+        return false;
+      }
     }
 
     std::vector<TokenSpan> local_chunks;
-    if (!ModelChunk(line_tokens.size(), /*span_of_interest=*/full_line_span,
-                    interpreter_manager->SelectionInterpreter(),
-                    *cached_features, &local_chunks)) {
-      TC3_LOG(ERROR) << "Could not chunk.";
-      return false;
+    {
+      TC3_TRACE_STAGE(options.stage_trace, "ModelChunk", &local_chunks);
+      if (!ModelChunk(line_tokens.size(), /*span_of_interest=*/full_line_span,
+                      interpreter_manager->SelectionInterpreter(),
+                      *cached_features, &local_chunks)) {
+        TC3_LOG(ERROR) << "Could not chunk.";
+        return false;
+      }
     }
 
     const int offset = std::distance(context_unicode.begin(), line.first);
@@ -2052,6 +2281,8 @@ bool Annotator::ModelAnnotate(
     std::vector<UnicodeText::const_iterator> line_codepoints =
         line_unicode.Codepoints();
     line_codepoints.push_back(line_unicode.end());
+    std::vector<CodepointSpan> codepoint_spans;
+    codepoint_spans.reserve(local_chunks.size());
     for (const TokenSpan& chunk : local_chunks) {
       CodepointSpan codepoint_span =
           TokenSpanToCodepointSpan(line_tokens, chunk);
@@ -2067,26 +2298,35 @@ bool Annotator::ModelAnnotate(
 
       // Skip empty spans.
       if (codepoint_span.first != codepoint_span.second) {
-        std::vector<ClassificationResult> classification;
-        if (!ModelClassifyText(line_str, line_tokens,
-                               detected_text_language_tags, codepoint_span,
-                               options, interpreter_manager, &embedding_cache,
-                               &classification)) {
-          TC3_LOG(ERROR) << "Could not classify text: "
-                         << (codepoint_span.first + offset) << " "
-                         << (codepoint_span.second + offset);
-          return false;
-        }
+        codepoint_spans.push_back(codepoint_span);
+      }
+    }
 
-        // Do not include the span if it's classified as "other".
-        if (!classification.empty() && !ClassifiedAsOther(classification) &&
-            classification[0].score >= min_annotate_confidence) {
-          AnnotatedSpan result_span;
-          result_span.span = {codepoint_span.first + offset,
-                              codepoint_span.second + offset};
-          result_span.classification = std::move(classification);
-          result->push_back(std::move(result_span));
-        }
+    // Classify all the chunks of the line with a single batched inference.
+    std::vector<std::vector<ClassificationResult>> classifications;
+    {
+      TC3_TRACE_STAGE(options.stage_trace, "ModelClassifyText",
+                      &classifications);
+      if (!ModelClassifyTextBatch(line_str, line_tokens,
+                                  detected_text_language_tags, codepoint_spans,
+                                  options, interpreter_manager,
+                                  &embedding_cache, &classifications)) {
+        TC3_LOG(ERROR) << "Could not classify text in line at: " << offset;
+        return false;
+      }
+    }
+
+    for (int i = 0; i < codepoint_spans.size(); i++) {
+      std::vector<ClassificationResult>& classification = classifications[i];
+
+      // Do not include the span if it's classified as "other".
+      if (!classification.empty() && !ClassifiedAsOther(classification) &&
+          classification[0].score >= min_annotate_confidence) {
+        AnnotatedSpan result_span;
+        result_span.span = {codepoint_spans[i].first + offset,
+                            codepoint_spans[i].second + offset};
+        result_span.classification = std::move(classification);
+        result->push_back(std::move(result_span));
       }
     }
 
@@ -2116,6 +2356,68 @@ const DatetimeParser* Annotator::DatetimeParserForTests() const {
   return datetime_parser_.get();
 }
 
+Annotator::RegexPrefilterStats Annotator::GetRegexPrefilterStats() const {
+  RegexPrefilterStats stats;
+  stats.num_patterns_checked = num_regex_patterns_checked_.load();
+  stats.num_patterns_skipped = num_regex_patterns_skipped_.load();
+  return stats;
+}
+
+TfLiteInterpreterPool::Stats Annotator::SelectionInterpreterPoolStats() const {
+  if (selection_interpreter_pool_ == nullptr) {
+    return TfLiteInterpreterPool::Stats();
+  }
+  return selection_interpreter_pool_->GetStats();
+}
+
+TfLiteInterpreterPool::Stats Annotator::ClassificationInterpreterPoolStats()
+    const {
+  if (classification_interpreter_pool_ == nullptr) {
+    return TfLiteInterpreterPool::Stats();
+  }
+  return classification_interpreter_pool_->GetStats();
+}
+
+void Annotator::SetTokenEmbeddingCacheSize(int64 max_size_bytes) {
+  selection_token_embedding_cache_.reset();
+  classification_token_embedding_cache_.reset();
+  if (max_size_bytes <= 0) {
+    return;
+  }
+
+  const int num_caches = (selection_feature_processor_ != nullptr) +
+                         (classification_feature_processor_ != nullptr);
+  if (num_caches == 0) {
+    return;
+  }
+  if (selection_feature_processor_ != nullptr) {
+    selection_token_embedding_cache_.reset(
+        new TokenEmbeddingCache(max_size_bytes / num_caches));
+  }
+  if (classification_feature_processor_ != nullptr) {
+    classification_token_embedding_cache_.reset(
+        new TokenEmbeddingCache(max_size_bytes / num_caches));
+  }
+}
+
+TokenEmbeddingCache::Stats Annotator::TokenEmbeddingCacheStats() const {
+  TokenEmbeddingCache::Stats stats;
+  for (const TokenEmbeddingCache* cache :
+       {selection_token_embedding_cache_.get(),
+        classification_token_embedding_cache_.get()}) {
+    if (cache == nullptr) {
+      continue;
+    }
+    const TokenEmbeddingCache::Stats cache_stats = cache->GetStats();
+    stats.num_hits += cache_stats.num_hits;
+    stats.num_misses += cache_stats.num_misses;
+    stats.num_evictions += cache_stats.num_evictions;
+    stats.num_entries += cache_stats.num_entries;
+    stats.size_bytes += cache_stats.size_bytes;
+  }
+  return stats;
+}
+
 void Annotator::RemoveNotEnabledEntityTypes(
     const EnabledEntityTypes& is_entity_type_enabled,
     std::vector<AnnotatedSpan>* annotated_spans) const {
@@ -2152,6 +2454,63 @@ void Annotator::AddContactMetadataToKnowledgeClassificationResults(
   }
 }
 
+namespace {
+// An annotator run by AnnotateSingleInput. It only reads the input and appends
+// its candidates to the given vector.
+struct AnnotatorStage {
+  std::function<Status(std::vector<AnnotatedSpan>*)> run;
+
+  // Whether the stage reads the tokens produced by the first stage.
+  bool uses_tokens;
+};
+
+// Runs the stages and appends their candidates to 'candidates' in the order of
+// the stages. Without a thread pool, the stages run one after another directly
+// on 'candidates'. With a thread pool, the first stage and the stages that
+// don't use the tokens run concurrently, followed by the stages that do. Each
+// of them writes to its own vector, and the vectors are concatenated in the
+// order of the stages, so the result is the same as the sequential one.
+// Returns the error of the first failing stage.
+Status RunAnnotatorStages(const std::vector<AnnotatorStage>& stages,
+                          ThreadPool* thread_pool,
+                          std::vector<AnnotatedSpan>* candidates) {
+  if (thread_pool == nullptr) {
+    for (const AnnotatorStage& stage : stages) {
+      const Status stage_status = stage.run(candidates);
+      if (!stage_status.ok()) {
+        return stage_status;
+      }
+    }
+    return Status::OK;
+  }
+
+  std::vector<std::vector<AnnotatedSpan>> stage_candidates(stages.size());
+  std::vector<Status> stage_statuses(stages.size());
+  for (const bool run_token_stages : {false, true}) {
+    std::vector<int> wave;
+    for (int i = 0; i < stages.size(); ++i) {
+      if ((i > 0 && stages[i].uses_tokens) == run_token_stages) {
+        wave.push_back(i);
+      }
+    }
+    thread_pool->ParallelFor(wave.size(), [&](int wave_index) {
+      const int i = wave[wave_index];
+      stage_statuses[i] = stages[i].run(&stage_candidates[i]);
+    });
+  }
+
+  for (int i = 0; i < stages.size(); ++i) {
+    if (!stage_statuses[i].ok()) {
+      return stage_statuses[i];
+    }
+    candidates->insert(candidates->end(),
+                       std::make_move_iterator(stage_candidates[i].begin()),
+                       std::make_move_iterator(stage_candidates[i].end()));
+  }
+  return Status::OK;
+}
+}  // namespace
+
 Status Annotator::AnnotateSingleInput(
     const std::string& context, const AnnotationOptions& options,
     std::vector<AnnotatedSpan>* candidates) const {
@@ -2181,8 +2540,9 @@ Status Annotator::AnnotateSingleInput(
         "The detected language tags are not in the supported locales.");
   }
 
-  InterpreterManager interpreter_manager(selection_executor_.get(),
-                                         classification_executor_.get());
+  InterpreterManager interpreter_manager(
+      selection_interpreter_pool_.get(),
+      classification_interpreter_pool_.get());
 
   const EnabledEntityTypes is_entity_type_enabled(options.entity_types);
   const bool is_raw_usecase =
@@ -2192,123 +2552,206 @@ Status Annotator::AnnotateSingleInput(
   const bool model_annotations_enabled =
       !is_raw_usecase || IsAnyModelEntityTypeEnabled(is_entity_type_enabled);
   std::vector<Token> tokens;
-  if (model_annotations_enabled &&
-      !ModelAnnotate(context, detected_text_language_tags, options,
-                     &interpreter_manager, &tokens, candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run ModelAnnotate.");
-  } else if (!model_annotations_enabled) {
-    // If the ML model didn't run, we need to tokenize to support the other
-    // annotators that depend on the tokens.
-    // Optimization could be made to only do this when an annotator that uses
-    // the tokens is enabled, but it's unclear if the added complexity is worth
-    // it.
-    if (selection_feature_processor_ != nullptr) {
-      tokens = selection_feature_processor_->Tokenize(context_unicode);
+  auto model_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "ModelAnnotate", stage_candidates);
+    if (model_annotations_enabled &&
+        !ModelAnnotate(context, detected_text_language_tags, options,
+                       &interpreter_manager, &tokens, stage_candidates)) {
+      return Status(StatusCode::INTERNAL, "Couldn't run ModelAnnotate.");
+    } else if (!model_annotations_enabled) {
+      // If the ML model didn't run, we need to tokenize to support the other
+      // annotators that depend on the tokens.
+      // Optimization could be made to only do this when an annotator that uses
+      // the tokens is enabled, but it's unclear if the added complexity is
+      // worth it.
+      if (selection_feature_processor_ != nullptr) {
+        tokens = selection_feature_processor_->Tokenize(context_unicode);
+      }
     }
-  }
+    return Status::OK;
+  };
 
   // Annotate with the regular expression models.
-  const bool regex_annotations_enabled =
-      !is_raw_usecase || IsAnyRegexEntityTypeEnabled(is_entity_type_enabled);
-  if (regex_annotations_enabled &&
-      !RegexChunk(
-          UTF8ToUnicodeText(context, /*do_copy=*/false),
-          annotation_regex_patterns_, options.is_serialized_entity_data_enabled,
-          is_entity_type_enabled, options.annotation_usecase, candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run RegexChunk.");
-  }
+  auto regex_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "RegexChunk", stage_candidates);
+    const bool regex_annotations_enabled =
+        !is_raw_usecase || IsAnyRegexEntityTypeEnabled(is_entity_type_enabled);
+    if (regex_annotations_enabled &&
+        !RegexChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
+                    annotation_regex_patterns_,
+                    options.is_serialized_entity_data_enabled,
+                    is_entity_type_enabled, options.annotation_usecase,
+                    options.use_regex_literal_prefilter, stage_candidates)) {
+      return Status(StatusCode::INTERNAL, "Couldn't run RegexChunk.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the datetime model.
   // NOTE: Datetime can be disabled even in the SMART usecase, because it's been
   // relatively slow for some clients.
-  if ((is_entity_type_enabled(Collections::Date()) ||
-       is_entity_type_enabled(Collections::DateTime())) &&
-      !DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
-                     options.reference_time_ms_utc, options.reference_timezone,
-                     options.locales, ModeFlag_ANNOTATION,
-                     options.annotation_usecase,
-                     options.is_serialized_entity_data_enabled, candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run DatetimeChunk.");
-  }
+  auto datetime_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "DatetimeChunk", stage_candidates);
+    if ((is_entity_type_enabled(Collections::Date()) ||
+         is_entity_type_enabled(Collections::DateTime())) &&
+        !DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
+                       options.reference_time_ms_utc,
+                       options.reference_timezone, options.locales,
+                       ModeFlag_ANNOTATION, options.annotation_usecase,
+                       options.is_serialized_entity_data_enabled,
+                       stage_candidates)) {
+      return Status(StatusCode::INTERNAL, "Couldn't run DatetimeChunk.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the contact engine.
-  const bool contact_annotations_enabled =
-      !is_raw_usecase || is_entity_type_enabled(Collections::Contact());
-  if (contact_annotations_enabled && contact_engine_ &&
-      !contact_engine_->Chunk(context_unicode, tokens, candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run contact engine Chunk.");
-  }
+  auto contact_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "ContactEngineChunk",
+                    stage_candidates);
+    const bool contact_annotations_enabled =
+        !is_raw_usecase || is_entity_type_enabled(Collections::Contact());
+    if (contact_annotations_enabled && contact_engine_ &&
+        !contact_engine_->Chunk(context_unicode, tokens, stage_candidates)) {
+      return Status(StatusCode::INTERNAL, "Couldn't run contact engine Chunk.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the installed app engine.
-  const bool app_annotations_enabled =
-      !is_raw_usecase || is_entity_type_enabled(Collections::App());
-  if (app_annotations_enabled && installed_app_engine_ &&
-      !installed_app_engine_->Chunk(context_unicode, tokens, candidates)) {
-    return Status(StatusCode::INTERNAL,
-                  "Couldn't run installed app engine Chunk.");
-  }
+  auto app_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "InstalledAppEngineChunk",
+                    stage_candidates);
+    const bool app_annotations_enabled =
+        !is_raw_usecase || is_entity_type_enabled(Collections::App());
+    if (app_annotations_enabled && installed_app_engine_ &&
+        !installed_app_engine_->Chunk(context_unicode, tokens,
+                                      stage_candidates)) {
+      return Status(StatusCode::INTERNAL,
+                    "Couldn't run installed app engine Chunk.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the number annotator.
-  const bool number_annotations_enabled =
-      !is_raw_usecase || (is_entity_type_enabled(Collections::Number()) ||
-                          is_entity_type_enabled(Collections::Percentage()));
-  if (number_annotations_enabled && number_annotator_ != nullptr &&
-      !number_annotator_->FindAll(context_unicode, options.annotation_usecase,
-                                  candidates)) {
-    return Status(StatusCode::INTERNAL,
-                  "Couldn't run number annotator FindAll.");
-  }
+  auto number_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "NumberAnnotator", stage_candidates);
+    const bool number_annotations_enabled =
+        !is_raw_usecase || (is_entity_type_enabled(Collections::Number()) ||
+                            is_entity_type_enabled(Collections::Percentage()));
+    if (number_annotations_enabled && number_annotator_ != nullptr &&
+        !number_annotator_->FindAll(context_unicode, options.annotation_usecase,
+                                    stage_candidates)) {
+      return Status(StatusCode::INTERNAL,
+                    "Couldn't run number annotator FindAll.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the duration annotator.
-  const bool duration_annotations_enabled =
-      !is_raw_usecase || is_entity_type_enabled(Collections::Duration());
-  if (duration_annotations_enabled && duration_annotator_ != nullptr &&
-      !duration_annotator_->FindAll(context_unicode, tokens,
-                                    options.annotation_usecase, candidates)) {
-    return Status(StatusCode::INTERNAL,
-                  "Couldn't run duration annotator FindAll.");
-  }
+  auto duration_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "DurationAnnotator", stage_candidates);
+    const bool duration_annotations_enabled =
+        !is_raw_usecase || is_entity_type_enabled(Collections::Duration());
+    if (duration_annotations_enabled && duration_annotator_ != nullptr &&
+        !duration_annotator_->FindAll(context_unicode, tokens,
+                                      options.annotation_usecase,
+                                      stage_candidates)) {
+      return Status(StatusCode::INTERNAL,
+                    "Couldn't run duration annotator FindAll.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the person name engine.
-  const bool person_annotations_enabled =
-      !is_raw_usecase || is_entity_type_enabled(Collections::PersonName());
-  if (person_annotations_enabled && person_name_engine_ &&
-      !person_name_engine_->Chunk(context_unicode, tokens, candidates)) {
-    return Status(StatusCode::INTERNAL,
-                  "Couldn't run person name engine Chunk.");
-  }
+  auto person_name_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "PersonNameEngineChunk",
+                    stage_candidates);
+    const bool person_annotations_enabled =
+        !is_raw_usecase || is_entity_type_enabled(Collections::PersonName());
+    if (person_annotations_enabled && person_name_engine_ &&
+        !person_name_engine_->Chunk(context_unicode, tokens,
+                                    stage_candidates)) {
+      return Status(StatusCode::INTERNAL,
+                    "Couldn't run person name engine Chunk.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the grammar annotators.
-  if (grammar_annotator_ != nullptr &&
-      !grammar_annotator_->Annotate(detected_text_language_tags,
-                                    context_unicode, candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run grammar annotators.");
-  }
+  auto grammar_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "GrammarAnnotator", stage_candidates);
+    if (grammar_annotator_ != nullptr &&
+        !grammar_annotator_->Annotate(detected_text_language_tags,
+                                      context_unicode, stage_candidates)) {
+      return Status(StatusCode::INTERNAL, "Couldn't run grammar annotators.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the POD NER annotator.
-  const bool pod_ner_annotations_enabled =
-      !is_raw_usecase || IsAnyPodNerEntityTypeEnabled(is_entity_type_enabled);
-  if (pod_ner_annotations_enabled && pod_ner_annotator_ != nullptr &&
-      options.use_pod_ner &&
-      !pod_ner_annotator_->Annotate(context_unicode, candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run POD NER annotator.");
-  }
+  auto pod_ner_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "PodNerAnnotator", stage_candidates);
+    const bool pod_ner_annotations_enabled =
+        !is_raw_usecase || IsAnyPodNerEntityTypeEnabled(is_entity_type_enabled);
+    if (pod_ner_annotations_enabled && pod_ner_annotator_ != nullptr &&
+        options.use_pod_ner &&
+        !pod_ner_annotator_->Annotate(context_unicode, stage_candidates)) {
+      return Status(StatusCode::INTERNAL, "Couldn't run POD NER annotator.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the vocab annotator.
-  const bool vocab_annotations_enabled =
-      !is_raw_usecase || is_entity_type_enabled(Collections::Dictionary());
-  if (vocab_annotations_enabled && vocab_annotator_ != nullptr &&
-      options.use_vocab_annotator &&
-      !vocab_annotator_->Annotate(context_unicode, detected_text_language_tags,
-                                  options.trigger_dictionary_on_beginner_words,
-                                  candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run vocab annotator.");
-  }
+  auto vocab_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "VocabAnnotator", stage_candidates);
+    const bool vocab_annotations_enabled =
+        !is_raw_usecase || is_entity_type_enabled(Collections::Dictionary());
+    if (vocab_annotations_enabled && vocab_annotator_ != nullptr &&
+        options.use_vocab_annotator &&
+        !vocab_annotator_->Annotate(
+            context_unicode, detected_text_language_tags,
+            options.trigger_dictionary_on_beginner_words, stage_candidates)) {
+      return Status(StatusCode::INTERNAL, "Couldn't run vocab annotator.");
+    }
+    return Status::OK;
+  };
 
   // Annotate with the experimental annotator.
-  if (experimental_annotator_ != nullptr &&
-      !experimental_annotator_->Annotate(context_unicode, candidates)) {
-    return Status(StatusCode::INTERNAL, "Couldn't run experimental annotator.");
+  auto experimental_stage = [&](std::vector<AnnotatedSpan>* stage_candidates) {
+    TC3_TRACE_STAGE(options.stage_trace, "ExperimentalAnnotator",
+                    stage_candidates);
+    if (experimental_annotator_ != nullptr &&
+        !experimental_annotator_->Annotate(context_unicode, stage_candidates)) {
+      return Status(StatusCode::INTERNAL,
+                    "Couldn't run experimental annotator.");
+    }
+    return Status::OK;
+  };
+
+  // NOTE: The stages using the tokens must come after the model stage, which
+  // produces them.
+  const std::vector<AnnotatorStage> stages = {
+      {model_stage, /*uses_tokens=*/false},
+      {regex_stage, /*uses_tokens=*/false},
+      {datetime_stage, /*uses_tokens=*/false},
+      {contact_stage, /*uses_tokens=*/true},
+      {app_stage, /*uses_tokens=*/true},
+      {number_stage, /*uses_tokens=*/false},
+      {duration_stage, /*uses_tokens=*/true},
+      {person_name_stage, /*uses_tokens=*/true},
+      {grammar_stage, /*uses_tokens=*/false},
+      {pod_ner_stage, /*uses_tokens=*/false},
+      {vocab_stage, /*uses_tokens=*/false},
+      {experimental_stage, /*uses_tokens=*/false},
+  };
+
+  const Status stages_status = RunAnnotatorStages(
+      stages,
+      options.annotate_stages_concurrently ? options.thread_pool : nullptr,
+      candidates);
+  if (!stages_status.ok()) {
+    return stages_status;
   }
 
   // Sort candidates according to their position in the input, so that the next
@@ -2332,10 +2775,14 @@ Status Annotator::AnnotateSingleInput(
             });
 
   std::vector<int> candidate_indices;
-  if (!ResolveConflicts(*candidates, context, tokens,
-                        detected_text_language_tags, options,
-                        &interpreter_manager, &candidate_indices)) {
-    return Status(StatusCode::INTERNAL, "Couldn't resolve conflicts.");
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "ResolveConflicts",
+                    &candidate_indices);
+    if (!ResolveConflicts(*candidates, context, tokens,
+                          detected_text_language_tags, options,
+                          &interpreter_manager, &candidate_indices)) {
+      return Status(StatusCode::INTERNAL, "Couldn't resolve conflicts.");
+    }
   }
 
   // Remove candidates that overlap exactly and have the same collection.
@@ -2390,13 +2837,18 @@ StatusOr<Annotations> Annotator::AnnotateStructuredInput(
 
   // KnowledgeEngine is special, because it supports annotation of multiple
   // fragments at once.
-  if (knowledge_engine_ &&
-      !knowledge_engine_
-           ->ChunkMultipleSpans(text_to_annotate, options.annotation_usecase,
-                                options.location_context, options.permissions,
-                                options.annotate_mode, &annotation_candidates)
-           .ok()) {
-    return Status(StatusCode::INTERNAL, "Couldn't run knowledge engine Chunk.");
+  {
+    TC3_TRACE_STAGE(options.stage_trace, "KnowledgeEngineChunk", nullptr);
+    if (knowledge_engine_ &&
+        !knowledge_engine_
+             ->ChunkMultipleSpans(text_to_annotate, options.annotation_usecase,
+                                  options.location_context,
+                                  options.permissions, options.annotate_mode,
+                                  &annotation_candidates)
+             .ok()) {
+      return Status(StatusCode::INTERNAL,
+                    "Couldn't run knowledge engine Chunk.");
+    }
   }
   // The annotator engines shouldn't change the number of annotation vectors.
   if (annotation_candidates.annotated_spans.size() != text_to_annotate.size()) {
@@ -2418,8 +2870,11 @@ StatusOr<Annotations> Annotator::AnnotateStructuredInput(
     return annotation_candidates;
   }
 
-  // Other annotators run on each fragment independently.
-  for (int i = 0; i < text_to_annotate.size(); ++i) {
+  // Other annotators run on each fragment independently. Each fragment only
+  // writes to its own slot, so the fragments can be annotated in any order and
+  // on any thread without affecting the results.
+  std::vector<Status> fragment_statuses(text_to_annotate.size());
+  auto annotate_fragment = [&](int i) {
     AnnotationOptions annotation_options = options;
     if (string_fragments[i].datetime_options.has_value()) {
       DatetimeOptions reference_datetime =
@@ -2433,11 +2888,27 @@ StatusOr<Annotations> Annotator::AnnotateStructuredInput(
     AddContactMetadataToKnowledgeClassificationResults(
         &annotation_candidates.annotated_spans[i]);
 
-    Status annotation_status =
+    fragment_statuses[i] =
         AnnotateSingleInput(text_to_annotate[i], annotation_options,
                             &annotation_candidates.annotated_spans[i]);
-    if (!annotation_status.ok()) {
-      return annotation_status;
+  };
+  if (options.thread_pool != nullptr) {
+    options.thread_pool->ParallelFor(text_to_annotate.size(),
+                                     annotate_fragment);
+  } else {
+    for (int i = 0; i < text_to_annotate.size(); ++i) {
+      annotate_fragment(i);
+      if (!fragment_statuses[i].ok()) {
+        return fragment_statuses[i];
+      }
+    }
+  }
+
+  // Report the error of the first failing fragment, independently of the order
+  // in which the fragments finished.
+  for (const Status& fragment_status : fragment_statuses) {
+    if (!fragment_status.ok()) {
+      return fragment_status;
     }
   }
   return annotation_candidates;
@@ -2799,7 +3270,10 @@ bool Annotator::RegexChunk(const UnicodeText& context_unicode,
                            bool is_serialized_entity_data_enabled,
                            const EnabledEntityTypes& enabled_entity_types,
                            const AnnotationUsecase& annotation_usecase,
+                           bool use_literal_prefilter,
                            std::vector<AnnotatedSpan>* result) const {
+  const StringPiece context_utf8(context_unicode.data(),
+                                 context_unicode.size_bytes());
   for (int pattern_id : rules) {
     const CompiledRegexPattern& regex_pattern = regex_patterns_[pattern_id];
     if (!enabled_entity_types(regex_pattern.config->collection_name()->str()) &&
@@ -2807,6 +3281,14 @@ bool Annotator::RegexChunk(const UnicodeText& context_unicode,
       // No regex annotation type has been requested, skip regex annotation.
       continue;
     }
+    if (use_literal_prefilter) {
+      ++num_regex_patterns_checked_;
+      if (!MayMatchRequiredLiteral(regex_pattern.required_literal,
+                                   context_utf8)) {
+        ++num_regex_patterns_skipped_;
+        continue;
+      }
+    }
     const auto matcher = regex_pattern.pattern->Matcher(context_unicode);
     if (!matcher) {
       TC3_LOG(ERROR) << "Could not get regex matcher for pattern: "
@@ -2978,9 +3460,13 @@ bool Annotator::ModelClickContextScoreChunks(
     // Run batched inference.
     const int batch_size = batch_end - batch_start;
     const int features_size = cached_features.OutputFeaturesSize();
+    const int padded_batch_size =
+        pad_selection_batches_to_buckets_
+            ? ModelExecutor::BucketedBatchSize(batch_size, max_batch_size)
+            : 0;
     TensorView<float> logits = selection_executor_->ComputeLogits(
         TensorView<float>(all_features.data(), {batch_size, features_size}),
-        selection_interpreter);
+        selection_interpreter, padded_batch_size);
     if (!logits.is_valid()) {
       TC3_LOG(ERROR) << "Couldn't compute logits.";
       return false;
@@ -3087,9 +3573,13 @@ bool Annotator::ModelBoundsSensitiveScoreChunks(
     // Run batched inference.
     const int batch_size = batch_end - batch_start;
     const int features_size = cached_features.OutputFeaturesSize();
+    const int padded_batch_size =
+        pad_selection_batches_to_buckets_
+            ? ModelExecutor::BucketedBatchSize(batch_size, max_batch_size)
+            : 0;
     TensorView<float> logits = selection_executor_->ComputeLogits(
         TensorView<float>(all_features.data(), {batch_size, features_size}),
-        selection_interpreter);
+        selection_interpreter, padded_batch_size);
     if (!logits.is_valid()) {
       TC3_LOG(ERROR) << "Couldn't compute logits.";
       return false;
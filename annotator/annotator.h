@@ -18,6 +18,7 @@
 #ifndef LIBTEXTCLASSIFIER_ANNOTATOR_ANNOTATOR_H_
 #define LIBTEXTCLASSIFIER_ANNOTATOR_ANNOTATOR_H_
 
+#include <atomic>
 #include <memory>
 #include <set>
 #include <string>
@@ -39,6 +40,7 @@
 #include "annotator/person_name/person-name-engine.h"
 #include "annotator/pod_ner/pod-ner.h"
 #include "annotator/strip-unpaired-brackets.h"
+#include "annotator/token-embedding-cache.h"
 #include "annotator/translate/translate.h"
 #include "annotator/types.h"
 #include "annotator/vocab/vocab-annotator.h"
@@ -68,6 +70,19 @@ class InterpreterManager {
       : selection_executor_(selection_executor),
         classification_executor_(classification_executor) {}
 
+  // Like above, but borrows the interpreters from the given pools instead of
+  // creating them, and returns them to the pools on destruction. Any of the
+  // pools can be nullptr, as long as the corresponding *Interpreter() method is
+  // not called.
+  InterpreterManager(TfLiteInterpreterPool* selection_interpreter_pool,
+                     TfLiteInterpreterPool* classification_interpreter_pool)
+      : selection_executor_(nullptr),
+        classification_executor_(nullptr),
+        selection_interpreter_pool_(selection_interpreter_pool),
+        classification_interpreter_pool_(classification_interpreter_pool) {}
+
+  ~InterpreterManager();
+
   // Gets or creates and caches an interpreter for the selection model.
   tflite::Interpreter* SelectionInterpreter();
 
@@ -78,6 +93,9 @@ class InterpreterManager {
   const ModelExecutor* selection_executor_;
   const ModelExecutor* classification_executor_;
 
+  TfLiteInterpreterPool* selection_interpreter_pool_ = nullptr;
+  TfLiteInterpreterPool* classification_interpreter_pool_ = nullptr;
+
   std::unique_ptr<tflite::Interpreter> selection_interpreter_;
   std::unique_ptr<tflite::Interpreter> classification_interpreter_;
 };
@@ -172,9 +190,34 @@ class Annotator {
   // linked in.
   bool InitializeExperimentalAnnotators();
 
+  // Compiles all the lazily compiled regex patterns of the model now, so that
+  // their compilation cost is not paid by the first requests. Can be called
+  // concurrently with other calls. Returns false if any of the patterns failed
+  // to compile.
+  bool CompileLazyRegexPatterns() const;
+
   // Sets up the lang-id instance that should be used.
   void SetLangId(const libtextclassifier3::mobile::lang_id::LangId* lang_id);
 
+  // Enables caching the embeddings of token values across requests, within a
+  // memory budget of roughly 'max_size_bytes' shared by the selection and
+  // classification models. A budget of 0 disables the cache.
+  // NOTE: Must not be called concurrently with annotation calls.
+  void SetTokenEmbeddingCacheSize(int64 max_size_bytes);
+
+  // Returns the combined statistics of the token embedding caches of the
+  // selection and classification models.
+  TokenEmbeddingCache::Stats TokenEmbeddingCacheStats() const;
+
+  // If set, the batches of the selection model are padded to a few fixed
+  // sizes (powers of two up to the batch size of the model), so that the
+  // interpreters do not re-allocate their tensors for every differently sized
+  // tail batch. Trades some wasted inference on the padding for fewer
+  // allocations. Off by default.
+  void SetPadSelectionBatchesToBuckets(bool pad) {
+    pad_selection_batches_to_buckets_ = pad;
+  }
+
   // Runs inference for given a context and current selection (i.e. index
   // of the first and one past last selected characters (utf8 codepoint
   // offsets)). Returns the indices (utf8 codepoint offsets) of the selection
@@ -228,6 +271,28 @@ class Annotator {
   // Exposes the date time parser for tests and evaluations.
   const DatetimeParser* DatetimeParserForTests() const;
 
+  // Returns the usage counters of the selection and classification interpreter
+  // pools, i.e. how many interpreters were created vs. reused.
+  TfLiteInterpreterPool::Stats SelectionInterpreterPoolStats() const;
+  TfLiteInterpreterPool::Stats ClassificationInterpreterPoolStats() const;
+
+  // Counters of the regex literal prefilter (see
+  // BaseOptions::use_regex_literal_prefilter).
+  struct RegexPrefilterStats {
+    // Number of times a regex pattern was checked against the prefilter.
+    int64 num_patterns_checked = 0;
+
+    // Number of times the full regex match of a pattern was skipped, because
+    // the input did not contain the literal required by the pattern.
+    int64 num_patterns_skipped = 0;
+  };
+  RegexPrefilterStats GetRegexPrefilterStats() const;
+
+  // Maximum number of idle interpreters kept around per model. Roughly
+  // corresponds to the number of threads that can concurrently use the
+  // annotator without creating new interpreters.
+  static constexpr int kMaxPooledInterpreters = 8;
+
   static const std::string& kPhoneCollection;
   static const std::string& kAddressCollection;
   static const std::string& kDateCollection;
@@ -265,16 +330,17 @@ class Annotator {
                         std::vector<int>* result) const;
 
   // Resolves one conflict between candidates on indices 'start_index'
-  // (inclusive) and 'end_index' (exclusive). Assigns the winning candidate
-  // indices to 'chosen_indices'. Returns false if a problem arises.
-  bool ResolveConflict(const std::string& context,
-                       const std::vector<Token>& cached_tokens,
-                       const std::vector<AnnotatedSpan>& candidates,
-                       const std::vector<Locale>& detected_text_language_tags,
-                       int start_index, int end_index,
-                       const BaseOptions& options,
-                       InterpreterManager* interpreter_manager,
-                       std::vector<int>* chosen_indices) const;
+  // (inclusive) and 'end_index' (exclusive). The candidates without a
+  // classification are scored with 'model_classifications', at the index given
+  // for the candidate in 'model_classification_indices'. Assigns the winning
+  // candidate indices to 'chosen_indices'. Returns false if a problem arises.
+  bool ResolveConflict(
+      const std::vector<AnnotatedSpan>& candidates,
+      const std::vector<std::vector<ClassificationResult>>&
+          model_classifications,
+      const std::vector<int>& model_classification_indices, int start_index,
+      int end_index, const BaseOptions& options,
+      std::vector<int>* chosen_indices) const;
 
   // Gets selection candidates from the ML model.
   // Provides the tokens produced during tokenization of the context string for
@@ -315,6 +381,50 @@ class Annotator {
       FeatureProcessor::EmbeddingCache* embedding_cache,
       std::vector<ClassificationResult>* classification_results) const;
 
+  // Same as above but classifies multiple selections within the same context
+  // with a single batched inference of the classification model. The i-th
+  // vector of results corresponds to the i-th selection and is identical to
+  // the result of calling ModelClassifyText on that selection.
+  bool ModelClassifyTextBatch(
+      const std::string& context, const std::vector<Token>& cached_tokens,
+      const std::vector<Locale>& detected_text_language_tags,
+      const std::vector<CodepointSpan>& selection_indices,
+      const BaseOptions& options, InterpreterManager* interpreter_manager,
+      FeatureProcessor::EmbeddingCache* embedding_cache,
+      std::vector<std::vector<ClassificationResult>>* classification_results)
+      const;
+
+  // Input of the classification model for a single selection.
+  struct ModelClassificationInput {
+    // If true, the classification was decided without the model, and is stored
+    // in classification_results.
+    bool is_final = false;
+    std::vector<ClassificationResult> classification_results;
+
+    // Features to feed into the classification model.
+    std::vector<float> features;
+
+    // Number of tokens in the selection.
+    int selection_num_tokens = 0;
+  };
+
+  // Tokenizes the context and extracts the classification model features for
+  // the selection. Returns false if a problem arises.
+  bool PrepareModelClassification(
+      const std::string& context, const std::vector<Token>& cached_tokens,
+      const CodepointSpan& selection_indices,
+      FeatureProcessor::EmbeddingCache* embedding_cache,
+      std::vector<Token>* tokens, ModelClassificationInput* input) const;
+
+  // Turns the classification model logits for a single selection into the
+  // classification results.
+  void LogitsToModelClassification(
+      const std::string& context,
+      const std::vector<Locale>& detected_text_language_tags,
+      const CodepointSpan& selection_indices, int selection_num_tokens,
+      const BaseOptions& options, const float* logits, int num_logits,
+      std::vector<ClassificationResult>* classification_results) const;
+
   // Returns a relative token span that represents how many tokens on the left
   // from the selection and right from the selection are needed for the
   // classifier input.
@@ -379,12 +489,14 @@ class Annotator {
       std::vector<ScoredChunk>* scored_chunks) const;
 
   // Produces chunks isolated by a set of regular expressions.
+  // If 'use_literal_prefilter' is true, patterns whose required literal does
+  // not occur in the context are skipped without running the regex.
   bool RegexChunk(const UnicodeText& context_unicode,
                   const std::vector<int>& rules,
                   bool is_serialized_entity_data_enabled,
                   const EnabledEntityTypes& enabled_entity_types,
                   const AnnotationUsecase& annotation_usecase,
-
+                  bool use_literal_prefilter,
                   std::vector<AnnotatedSpan>* result) const;
 
   // Produces chunks from the datetime parser.
@@ -436,6 +548,11 @@ class Annotator {
   std::unique_ptr<const ModelExecutor> classification_executor_;
   std::unique_ptr<const EmbeddingExecutor> embedding_executor_;
 
+  // Pools of ready-to-use interpreters for the executors above, shared by all
+  // calls to the annotator.
+  std::unique_ptr<TfLiteInterpreterPool> selection_interpreter_pool_;
+  std::unique_ptr<TfLiteInterpreterPool> classification_interpreter_pool_;
+
   std::unique_ptr<const FeatureProcessor> selection_feature_processor_;
   std::unique_ptr<const FeatureProcessor> classification_feature_processor_;
 
@@ -452,6 +569,10 @@ class Annotator {
   struct CompiledRegexPattern {
     const RegexModel_::Pattern* config;
     std::unique_ptr<UniLib::RegexPattern> pattern;
+
+    // A literal that any match of the pattern has to contain, or empty if
+    // unknown. Used for prefiltering.
+    std::string required_literal;
   };
 
   // Removes annotations the entity type of which is not in the set of enabled
@@ -512,6 +633,10 @@ class Annotator {
   std::vector<int> annotation_regex_patterns_, classification_regex_patterns_,
       selection_regex_patterns_;
 
+  // Counters for the regex literal prefilter.
+  mutable std::atomic<int64> num_regex_patterns_checked_{0};
+  mutable std::atomic<int64> num_regex_patterns_skipped_{0};
+
   const UniLib* unilib_;
   const CalendarLib* calendarlib_;
 
@@ -552,6 +677,14 @@ class Annotator {
   // different sub-annotators also in the RAW mode. If false, no conflict
   // resolution will be performed in RAW mode.
   bool do_conflict_resolution_in_raw_mode_ = true;
+
+  // See SetPadSelectionBatchesToBuckets.
+  bool pad_selection_batches_to_buckets_ = false;
+
+  // See SetTokenEmbeddingCacheSize. Separate caches are needed, because the
+  // selection and classification models can use different feature options.
+  std::unique_ptr<TokenEmbeddingCache> selection_token_embedding_cache_;
+  std::unique_ptr<TokenEmbeddingCache> classification_token_embedding_cache_;
 };
 
 namespace internal {
@@ -0,0 +1,121 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks of the Annotator that need a real model. The path of the model is
+// read from the TC3_BENCHMARK_ANNOTATOR_MODEL environment variable; the
+// benchmarks are skipped if it is not set.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotator/annotator.h"
+#include "annotator/datetime/parser.h"
+#include "annotator/model_generated.h"
+#include "annotator/types.h"
+#include "utils/benchmark-data.h"
+#include "utils/calendar/calendar.h"
+#include "utils/memory/mmap.h"
+#include "utils/utf8/unilib.h"
+#include "utils/zlib/tclib_zlib.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr char kModelPathVariable[] = "TC3_BENCHMARK_ANNOTATOR_MODEL";
+
+// Runs Annotate with only the collections of the regex patterns enabled, to
+// measure RegexChunk. Other annotators covering the same collections (e.g.
+// the ML model) still run.
+void BM_AnnotateRegexCollections(benchmark::State& state) {
+  const std::string model_path = benchmark_data::GetEnv(kModelPathVariable);
+  const UniLib unilib;
+  const CalendarLib calendarlib;
+  const std::unique_ptr<Annotator> annotator =
+      Annotator::FromPath(model_path, &unilib, &calendarlib);
+  if (annotator == nullptr) {
+    state.SkipWithError("Set TC3_BENCHMARK_ANNOTATOR_MODEL to a model.");
+    return;
+  }
+
+  AnnotationOptions options;
+  options.annotation_usecase = AnnotationUsecase_ANNOTATION_USECASE_RAW;
+  options.use_regex_literal_prefilter = state.range(1);
+  const Model* model = annotator->model();
+  if (model->regex_model() != nullptr &&
+      model->regex_model()->patterns() != nullptr) {
+    for (const RegexModel_::Pattern* pattern :
+         *model->regex_model()->patterns()) {
+      if (pattern->collection_name() != nullptr) {
+        options.entity_types.insert(pattern->collection_name()->str());
+      }
+    }
+  }
+
+  const std::string text = benchmark_data::SyntheticText(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(annotator->Annotate(text, options));
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_AnnotateRegexCollections)
+    ->ArgNames({"num_words", "literal_prefilter"})
+    ->Args({100, 0})
+    ->Args({100, 1})
+    ->Args({1000, 0})
+    ->Args({1000, 1});
+
+void BM_DatetimeParserParse(benchmark::State& state) {
+  const ScopedMmap mmap(benchmark_data::GetEnv(kModelPathVariable));
+  if (!mmap.handle().ok()) {
+    state.SkipWithError("Set TC3_BENCHMARK_ANNOTATOR_MODEL to a model.");
+    return;
+  }
+  const Model* model =
+      ViewModel(mmap.handle().start(), mmap.handle().num_bytes());
+  if (model == nullptr || model->datetime_model() == nullptr) {
+    state.SkipWithError("The model has no datetime model.");
+    return;
+  }
+
+  const UniLib unilib;
+  const CalendarLib calendarlib;
+  const std::unique_ptr<ZlibDecompressor> decompressor =
+      ZlibDecompressor::Instance();
+  const std::unique_ptr<DatetimeParser> parser = DatetimeParser::Instance(
+      model->datetime_model(), &unilib, &calendarlib, decompressor.get());
+  if (parser == nullptr) {
+    state.SkipWithError("Could not create the datetime parser.");
+    return;
+  }
+
+  const std::string text = benchmark_data::SyntheticText(state.range(0));
+  std::vector<DatetimeParseResultSpan> results;
+  for (auto _ : state) {
+    results.clear();
+    parser->Parse(text, /*reference_time_ms_utc=*/1600000000000,
+                  /*reference_timezone=*/"Europe/Zurich", /*locales=*/"en",
+                  ModeFlag_ANNOTATION,
+                  AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                  /*anchor_start_end=*/false, &results);
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_DatetimeParserParse)->ArgName("num_words")->Arg(100)->Arg(1000);
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -0,0 +1,76 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <memory>
+#include <vector>
+
+#include "annotator/cached-features.h"
+#include "annotator/model_generated.h"
+#include "utils/benchmark-data.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+void BM_AppendClickContextFeaturesForClick(benchmark::State& state) {
+  const int num_tokens = 200;
+  const int feature_vector_size = state.range(0);
+
+  FeatureProcessorOptionsT options;
+  options.context_size = 5;
+  options.feature_version = 1;
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(FeatureProcessorOptions::Pack(builder, &options));
+  const FeatureProcessorOptions* options_flatbuffer =
+      flatbuffers::GetRoot<FeatureProcessorOptions>(
+          builder.GetBufferPointer());
+
+  benchmark_data::Random random(/*seed=*/42);
+  std::unique_ptr<std::vector<float>> features(
+      new std::vector<float>(num_tokens * feature_vector_size));
+  for (float& value : *features) {
+    value = random.Uniform(1000) / 1000.0f;
+  }
+  std::unique_ptr<std::vector<float>> padding_features(
+      new std::vector<float>(feature_vector_size, 0.0f));
+  const std::unique_ptr<CachedFeatures> cached_features =
+      CachedFeatures::Create({0, num_tokens}, std::move(features),
+                             std::move(padding_features), options_flatbuffer,
+                             feature_vector_size);
+  if (cached_features == nullptr) {
+    state.SkipWithError("Could not create the cached features.");
+    return;
+  }
+
+  std::vector<float> output_features;
+  output_features.reserve(cached_features->OutputFeaturesSize());
+  for (auto _ : state) {
+    for (int click_pos = 0; click_pos < num_tokens; ++click_pos) {
+      output_features.clear();
+      cached_features->AppendClickContextFeaturesForClick(click_pos,
+                                                          &output_features);
+      benchmark::DoNotOptimize(output_features.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_tokens);
+}
+BENCHMARK(BM_AppendClickContextFeaturesForClick)
+    ->ArgName("feature_vector_size")
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(256);
+
+}  // namespace
+}  // namespace libtextclassifier3
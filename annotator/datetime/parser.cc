@@ -112,6 +112,17 @@ DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib* unilib,
   initialized_ = true;
 }
 
+bool DatetimeParser::CompileLazyRegexPatterns() const {
+  bool success = true;
+  for (const CompiledRule& rule : rules_) {
+    success &= rule.compiled_regex->Compile();
+  }
+  for (const auto& extractor_rule : extractor_rules_) {
+    success &= extractor_rule->Compile();
+  }
+  return success;
+}
+
 bool DatetimeParser::Parse(
     const std::string& input, const int64 reference_time_ms_utc,
     const std::string& reference_timezone, const std::string& locales,
@@ -58,6 +58,10 @@ class DatetimeParser {
              bool anchor_start_end,
              std::vector<DatetimeParseResultSpan>* results) const;
 
+  // Compiles all the lazily compiled rule and extractor patterns now.
+  // Returns false if any of the patterns failed to compile.
+  bool CompileLazyRegexPatterns() const;
+
  protected:
   explicit DatetimeParser(const DatetimeModel* model, const UniLib* unilib,
                           const CalendarLib* calendarlib,
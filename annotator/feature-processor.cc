@@ -770,24 +770,34 @@ bool FeatureProcessor::ExtractFeatures(
     const std::vector<Token>& tokens, const TokenSpan& token_span,
     const CodepointSpan& selection_span_for_feature,
     const EmbeddingExecutor* embedding_executor,
-    EmbeddingCache* embedding_cache, int feature_vector_size,
+    EmbeddingCache* embedding_cache,
+    TokenEmbeddingCache* token_embedding_cache, int feature_vector_size,
     std::unique_ptr<CachedFeatures>* cached_features) const {
   std::unique_ptr<std::vector<float>> features(new std::vector<float>());
   features->reserve(feature_vector_size * token_span.Size());
+  PendingEmbeddings pending_embeddings;
   for (int i = token_span.first; i < token_span.second; ++i) {
-    if (!AppendTokenFeaturesWithCache(tokens[i], selection_span_for_feature,
-                                      embedding_executor, embedding_cache,
-                                      features.get())) {
+    if (!AppendTokenFeatures(tokens[i], selection_span_for_feature,
+                             embedding_executor, embedding_cache,
+                             token_embedding_cache, &pending_embeddings,
+                             features.get())) {
       TC3_LOG(ERROR) << "Could not get token features.";
       return false;
     }
   }
+  if (!EmbedPendingTokens(pending_embeddings, embedding_executor,
+                          embedding_cache, token_embedding_cache,
+                          features.get())) {
+    TC3_LOG(ERROR) << "Could not embed token features.";
+    return false;
+  }
 
   std::unique_ptr<std::vector<float>> padding_features(
       new std::vector<float>());
   padding_features->reserve(feature_vector_size);
   if (!AppendTokenFeaturesWithCache(Token(), selection_span_for_feature,
                                     embedding_executor, embedding_cache,
+                                    token_embedding_cache,
                                     padding_features.get())) {
     TC3_LOG(ERROR) << "Count not get padding token features.";
     return false;
@@ -808,64 +818,147 @@ bool FeatureProcessor::AppendTokenFeaturesWithCache(
     const Token& token, const CodepointSpan& selection_span_for_feature,
     const EmbeddingExecutor* embedding_executor,
     EmbeddingCache* embedding_cache,
+    TokenEmbeddingCache* token_embedding_cache,
+    std::vector<float>* output_features) const {
+  return AppendTokenFeatures(token, selection_span_for_feature,
+                             embedding_executor, embedding_cache,
+                             token_embedding_cache,
+                             /*pending_embeddings=*/nullptr, output_features);
+}
+
+bool FeatureProcessor::EmbedPendingTokens(
+    const PendingEmbeddings& pending_embeddings,
+    const EmbeddingExecutor* embedding_executor,
+    EmbeddingCache* embedding_cache,
+    TokenEmbeddingCache* token_embedding_cache,
+    std::vector<float>* output_features) const {
+  const int num_tokens = pending_embeddings.tokens.size();
+  if (num_tokens == 0) {
+    return true;
+  }
+  const int embedding_size = GetOptions()->embedding_size();
+  if (!embedding_executor->AddEmbeddings(
+          pending_embeddings.sparse_features.data(),
+          pending_embeddings.token_offsets.data(),
+          pending_embeddings.output_offsets.data(), num_tokens,
+          output_features->data(), embedding_size)) {
+    TC3_LOG(ERROR) << "Cound not embed tokens' sparse features.";
+    return false;
+  }
+
+  for (int i = 0; i < num_tokens; ++i) {
+    const Token& token = *pending_embeddings.tokens[i];
+    const float* embedding =
+        output_features->data() + pending_embeddings.output_offsets[i];
+    if (token_embedding_cache != nullptr) {
+      token_embedding_cache->Insert(token.value, embedding, embedding_size);
+    }
+    if (embedding_cache) {
+      (*embedding_cache)[{token.start, token.end}] =
+          std::vector<float>(embedding, embedding + embedding_size);
+    }
+  }
+  return true;
+}
+
+bool FeatureProcessor::AppendTokenFeatures(
+    const Token& token, const CodepointSpan& selection_span_for_feature,
+    const EmbeddingExecutor* embedding_executor,
+    EmbeddingCache* embedding_cache,
+    TokenEmbeddingCache* token_embedding_cache,
+    PendingEmbeddings* pending_embeddings,
     std::vector<float>* output_features) const {
+  // Buffers reused across the tokens processed by this thread, so that the
+  // feature extraction does not allocate per token.
+  struct ExtractionScratch {
+    TokenFeatureExtractor::Scratch extractor;
+    std::vector<int> sparse_features;
+  };
+  static thread_local ExtractionScratch scratch;
+
+  const bool is_in_span = token.IsContainedInSpan(selection_span_for_feature);
+  const int embedding_size = GetOptions()->embedding_size();
+  const int dense_features_count = feature_extractor_.DenseFeaturesCount();
+
   // Look for the embedded features for the token in the cache, if there is one.
   if (embedding_cache) {
     const auto it = embedding_cache->find({token.start, token.end});
     if (it != embedding_cache->end()) {
-      // The embedded features were found in the cache, extract only the dense
-      // features.
-      std::vector<float> dense_features;
+      // The embedded features were found in the cache, append them and
+      // extract only the dense features directly into the output.
+      output_features->insert(output_features->end(), it->second.begin(),
+                              it->second.end());
+      output_features->resize(output_features->size() + dense_features_count);
       if (!feature_extractor_.Extract(
-              token, token.IsContainedInSpan(selection_span_for_feature),
-              /*sparse_features=*/nullptr, &dense_features)) {
+              token, is_in_span, &scratch.extractor,
+              /*sparse_features=*/nullptr,
+              /*dense_features=*/output_features->data() +
+                  output_features->size() - dense_features_count)) {
         TC3_LOG(ERROR) << "Could not extract token's dense features.";
         return false;
       }
-
-      // Append both embedded and dense features to the output and return.
-      output_features->insert(output_features->end(), it->second.begin(),
-                              it->second.end());
-      output_features->insert(output_features->end(), dense_features.begin(),
-                              dense_features.end());
       return true;
     }
   }
 
-  // Extract the sparse and dense features.
-  std::vector<int> sparse_features;
-  std::vector<float> dense_features;
-  if (!feature_extractor_.Extract(
-          token, token.IsContainedInSpan(selection_span_for_feature),
-          &sparse_features, &dense_features)) {
-    TC3_LOG(ERROR) << "Could not extract token's features.";
-    return false;
-  }
+  // Make room for the embedded and the dense features of the token.
+  const int embedding_offset = output_features->size();
+  output_features->resize(embedding_offset + embedding_size +
+                          dense_features_count);
+  float* embedding = output_features->data() + embedding_offset;
+  float* dense_features = embedding + embedding_size;
+
+  // Look for the embedded features in the cache shared between requests. The
+  // sparse features only depend on the token value, so it is used as the key.
+  if (token_embedding_cache != nullptr &&
+      token_embedding_cache->Lookup(token.value, embedding_size, embedding)) {
+    if (!feature_extractor_.Extract(token, is_in_span, &scratch.extractor,
+                                    /*sparse_features=*/nullptr,
+                                    dense_features)) {
+      TC3_LOG(ERROR) << "Could not extract token's dense features.";
+      return false;
+    }
+  } else {
+    // Extract the sparse and dense features.
+    if (!feature_extractor_.Extract(token, is_in_span, &scratch.extractor,
+                                    &scratch.sparse_features, dense_features)) {
+      TC3_LOG(ERROR) << "Could not extract token's features.";
+      return false;
+    }
 
-  // Embed the sparse features, appending them directly to the output.
-  const int embedding_size = GetOptions()->embedding_size();
-  output_features->resize(output_features->size() + embedding_size);
-  float* output_features_end =
-      output_features->data() + output_features->size();
-  if (!embedding_executor->AddEmbedding(
-          TensorView<int>(sparse_features.data(),
-                          {static_cast<int>(sparse_features.size())}),
-          /*dest=*/output_features_end - embedding_size,
-          /*dest_size=*/embedding_size)) {
-    TC3_LOG(ERROR) << "Cound not embed token's sparse features.";
-    return false;
+    // Leave the embedding to be computed together with the other tokens.
+    if (pending_embeddings != nullptr) {
+      pending_embeddings->sparse_features.insert(
+          pending_embeddings->sparse_features.end(),
+          scratch.sparse_features.begin(), scratch.sparse_features.end());
+      pending_embeddings->token_offsets.push_back(
+          pending_embeddings->sparse_features.size());
+      pending_embeddings->output_offsets.push_back(embedding_offset);
+      pending_embeddings->tokens.push_back(&token);
+      return true;
+    }
+
+    // Embed the sparse features directly into the output.
+    if (!embedding_executor->AddEmbedding(
+            TensorView<int>(scratch.sparse_features.data(),
+                            {static_cast<int>(scratch.sparse_features.size())}),
+            /*dest=*/embedding,
+            /*dest_size=*/embedding_size)) {
+      TC3_LOG(ERROR) << "Cound not embed token's sparse features.";
+      return false;
+    }
+
+    if (token_embedding_cache != nullptr) {
+      token_embedding_cache->Insert(token.value, embedding, embedding_size);
+    }
   }
 
   // If there is a cache, the embedded features for the token were not in it,
   // so insert them.
   if (embedding_cache) {
-    (*embedding_cache)[{token.start, token.end}] = std::vector<float>(
-        output_features_end - embedding_size, output_features_end);
+    (*embedding_cache)[{token.start, token.end}] =
+        std::vector<float>(embedding, embedding + embedding_size);
   }
-
-  // Append the dense features to the output.
-  output_features->insert(output_features->end(), dense_features.begin(),
-                          dense_features.end());
   return true;
 }
 
@@ -26,6 +26,7 @@
 
 #include "annotator/cached-features.h"
 #include "annotator/model_generated.h"
+#include "annotator/token-embedding-cache.h"
 #include "annotator/types.h"
 #include "utils/base/integral_types.h"
 #include "utils/base/logging.h"
@@ -150,11 +151,15 @@ class FeatureProcessor {
 
   // Extracts features as a CachedFeatures object that can be used for repeated
   // inference over token spans in the given context.
+  // 'token_embedding_cache' is an optional cache shared between requests, see
+  // TokenEmbeddingCache.
   bool ExtractFeatures(const std::vector<Token>& tokens,
                        const TokenSpan& token_span,
                        const CodepointSpan& selection_span_for_feature,
                        const EmbeddingExecutor* embedding_executor,
-                       EmbeddingCache* embedding_cache, int feature_vector_size,
+                       EmbeddingCache* embedding_cache,
+                       TokenEmbeddingCache* token_embedding_cache,
+                       int feature_vector_size,
                        std::unique_ptr<CachedFeatures>* cached_features) const;
 
   // Fills selection_label_spans with CodepointSpans that correspond to the
@@ -259,15 +264,50 @@ class FeatureProcessor {
                                  std::vector<Token>* tokens) const;
 
   // Extracts the features of a token and appends them to the output vector.
-  // Uses the embedding cache to to avoid re-extracting the re-embedding the
+  // Uses the embedding caches to to avoid re-extracting the re-embedding the
   // sparse features for the same token.
   bool AppendTokenFeaturesWithCache(
       const Token& token, const CodepointSpan& selection_span_for_feature,
       const EmbeddingExecutor* embedding_executor,
       EmbeddingCache* embedding_cache,
+      TokenEmbeddingCache* token_embedding_cache,
       std::vector<float>* output_features) const;
 
  protected:
+  // Sparse features of the tokens whose embeddings are still to be computed.
+  struct PendingEmbeddings {
+    std::vector<int> sparse_features;
+
+    // Offsets of the features of each token in 'sparse_features', followed by
+    // the end offset of the last token.
+    std::vector<int> token_offsets = {0};
+
+    // Offsets of the embedding of each token in the output features.
+    std::vector<int> output_offsets;
+
+    std::vector<const Token*> tokens;
+  };
+
+  // Same as AppendTokenFeaturesWithCache, but if 'pending_embeddings' is not
+  // null, the tokens that are not in the caches are only added to it and
+  // their embedded features are left zero. They must then be computed with
+  // EmbedPendingTokens.
+  bool AppendTokenFeatures(const Token& token,
+                           const CodepointSpan& selection_span_for_feature,
+                           const EmbeddingExecutor* embedding_executor,
+                           EmbeddingCache* embedding_cache,
+                           TokenEmbeddingCache* token_embedding_cache,
+                           PendingEmbeddings* pending_embeddings,
+                           std::vector<float>* output_features) const;
+
+  // Computes the embeddings of all the pending tokens at once into the output
+  // features, and adds them to the caches.
+  bool EmbedPendingTokens(const PendingEmbeddings& pending_embeddings,
+                          const EmbeddingExecutor* embedding_executor,
+                          EmbeddingCache* embedding_cache,
+                          TokenEmbeddingCache* token_embedding_cache,
+                          std::vector<float>* output_features) const;
+
   const TokenFeatureExtractor feature_extractor_;
 
   // Codepoint ranges that define what codepoints are supported by the model.
@@ -42,6 +42,24 @@ std::vector<UnicodeText::const_iterator> UnicodeCodepointOffsets(
   return offsets;
 }
 
+// Tokenizes the text and feeds the tokens to the matcher. Uses token views to
+// avoid copying the token values, unless the tokenizer discarded codepoints
+// inside of a token.
+void TokenizeAndProcess(const Tokenizer& tokenizer,
+                        const grammar::Lexer& lexer, const UnicodeText& text,
+                        grammar::Matcher* matcher) {
+  std::vector<TokenView> tokens;
+  tokenizer.TokenizeInto(text, &tokens);
+  for (const TokenView& token : tokens) {
+    if (token.has_discarded_codepoints) {
+      lexer.Process(text, tokenizer.Tokenize(text), /*annotations=*/nullptr,
+                    matcher);
+      return;
+    }
+  }
+  lexer.Process(text, tokens, /*annotations=*/nullptr, matcher);
+}
+
 }  // namespace
 
 class GrammarAnnotatorCallbackDelegate : public grammar::CallbackDelegate {
@@ -380,8 +398,7 @@ bool GrammarAnnotator::Annotate(const std::vector<Locale>& locales,
       /*mode=*/ModeFlag_ANNOTATION);
   grammar::Matcher matcher(&unilib_, model_->rules(), locale_rules,
                            &callback_handler);
-  lexer_.Process(text, tokenizer_.Tokenize(text), /*annotations=*/nullptr,
-                 &matcher);
+  TokenizeAndProcess(tokenizer_, lexer_, text, &matcher);
 
   // Populate results.
   return callback_handler.GetAnnotations(UnicodeCodepointOffsets(text), result);
@@ -411,8 +428,7 @@ bool GrammarAnnotator::SuggestSelection(const std::vector<Locale>& locales,
       /*mode=*/ModeFlag_SELECTION);
   grammar::Matcher matcher(&unilib_, model_->rules(), locale_rules,
                            &callback_handler);
-  lexer_.Process(text, tokenizer_.Tokenize(text), /*annotations=*/nullptr,
-                 &matcher);
+  TokenizeAndProcess(tokenizer_, lexer_, text, &matcher);
 
   // Populate the result.
   return callback_handler.GetTextSelection(UnicodeCodepointOffsets(text),
@@ -16,17 +16,341 @@
 #include "annotator/lookup/lookup-engine.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
+#include <map>
+#include <utility>
 
+#include "utils/base/logging.h"
+#include "utils/flatbuffers/flatbuffers.h"
 #include "utils/utf8/unicodetext.h"
 #include "third_party/absl/container/flat_hash_set.h"
 
 namespace libtextclassifier3 {
+namespace {
 
-void LookupEngine::AddEntry(const std::vector<std::string>& ngrams,
-                            ClassificationResult entry) {
-  const int entry_index = entries_.size();
-  entries_.push_back(std::move(entry));
+std::string StringOrEmpty(const flatbuffers::String* value) {
+  return value != nullptr ? value->str() : "";
+}
+
+std::unique_ptr<LookupDatabase_::DatetimeParseResultT>
+CreateDatabaseDatetimeParseResult(const DatetimeParseResult& result) {
+  if (result == DatetimeParseResult()) {
+    return nullptr;
+  }
+  auto database_result =
+      std::make_unique<LookupDatabase_::DatetimeParseResultT>();
+  database_result->time_ms_utc = result.time_ms_utc;
+  database_result->granularity = result.granularity;
+  for (const DatetimeComponent& component : result.datetime_components) {
+    auto database_component =
+        std::make_unique<LookupDatabase_::DatetimeComponentT>();
+    database_component->component_type =
+        static_cast<int>(component.component_type);
+    database_component->relative_qualifier =
+        static_cast<int>(component.relative_qualifier);
+    database_component->value = component.value;
+    database_component->relative_count = component.relative_count;
+    database_result->datetime_components.push_back(
+        std::move(database_component));
+  }
+  return database_result;
+}
+
+DatetimeParseResult DatetimeParseResultFromDatabase(
+    const LookupDatabase_::DatetimeParseResult* database_result) {
+  DatetimeParseResult result;
+  if (database_result == nullptr) {
+    return result;
+  }
+  result.time_ms_utc = database_result->time_ms_utc();
+  result.granularity =
+      static_cast<DatetimeGranularity>(database_result->granularity());
+  if (database_result->datetime_components() != nullptr) {
+    for (const LookupDatabase_::DatetimeComponent* database_component :
+         *database_result->datetime_components()) {
+      result.datetime_components.emplace_back(
+          static_cast<DatetimeComponent::ComponentType>(
+              database_component->component_type()),
+          static_cast<DatetimeComponent::RelativeQualifier>(
+              database_component->relative_qualifier()),
+          database_component->value(), database_component->relative_count());
+    }
+  }
+  return result;
+}
+
+std::unique_ptr<LookupDatabase_::ContactPointerT> CreateDatabaseContactPointer(
+    const ContactPointer& contact_pointer) {
+  if (contact_pointer == ContactPointer()) {
+    return nullptr;
+  }
+  auto database_contact_pointer =
+      std::make_unique<LookupDatabase_::ContactPointerT>();
+  database_contact_pointer->focus_contact_id = contact_pointer.focus_contact_id;
+  database_contact_pointer->device_id = contact_pointer.device_id;
+  database_contact_pointer->device_contact_id =
+      contact_pointer.device_contact_id;
+  database_contact_pointer->contact_name = contact_pointer.contact_name;
+  database_contact_pointer->contact_name_hash =
+      contact_pointer.contact_name_hash;
+  return database_contact_pointer;
+}
+
+ContactPointer ContactPointerFromDatabase(
+    const LookupDatabase_::ContactPointer* database_contact_pointer) {
+  ContactPointer contact_pointer;
+  if (database_contact_pointer == nullptr) {
+    return contact_pointer;
+  }
+  contact_pointer.focus_contact_id =
+      StringOrEmpty(database_contact_pointer->focus_contact_id());
+  contact_pointer.device_id =
+      StringOrEmpty(database_contact_pointer->device_id());
+  contact_pointer.device_contact_id =
+      StringOrEmpty(database_contact_pointer->device_contact_id());
+  contact_pointer.contact_name =
+      StringOrEmpty(database_contact_pointer->contact_name());
+  contact_pointer.contact_name_hash =
+      StringOrEmpty(database_contact_pointer->contact_name_hash());
+  return contact_pointer;
+}
+
+// Converts all the fields of the result, except the collection.
+std::unique_ptr<LookupDatabase_::EntryT> CreateDatabaseEntry(
+    const ClassificationResult& result) {
+  auto entry = std::make_unique<LookupDatabase_::EntryT>();
+  entry->score = result.score;
+  entry->priority_score = result.priority_score;
+  entry->contact_name = result.contact_name;
+  entry->contact_given_name = result.contact_given_name;
+  entry->contact_family_name = result.contact_family_name;
+  entry->contact_nickname = result.contact_nickname;
+  entry->contact_email_address = result.contact_email_address;
+  entry->contact_phone_number = result.contact_phone_number;
+  entry->contact_id = result.contact_id;
+  entry->app_name = result.app_name;
+  entry->app_package_name = result.app_package_name;
+  entry->serialized_entity_data = result.serialized_entity_data;
+  entry->datetime_parse_result =
+      CreateDatabaseDatetimeParseResult(result.datetime_parse_result);
+  entry->serialized_knowledge_result = result.serialized_knowledge_result;
+  entry->contact_pointer = CreateDatabaseContactPointer(result.contact_pointer);
+  entry->numeric_value = result.numeric_value;
+  entry->numeric_double_value = result.numeric_double_value;
+  entry->duration_ms = result.duration_ms;
+  return entry;
+}
+
+ClassificationResult ClassificationResultFromDatabase(
+    const LookupDatabase_::Entry* entry) {
+  ClassificationResult result;
+  result.score = entry->score();
+  result.priority_score = entry->priority_score();
+  result.contact_name = StringOrEmpty(entry->contact_name());
+  result.contact_given_name = StringOrEmpty(entry->contact_given_name());
+  result.contact_family_name = StringOrEmpty(entry->contact_family_name());
+  result.contact_nickname = StringOrEmpty(entry->contact_nickname());
+  result.contact_email_address = StringOrEmpty(entry->contact_email_address());
+  result.contact_phone_number = StringOrEmpty(entry->contact_phone_number());
+  result.contact_id = StringOrEmpty(entry->contact_id());
+  result.app_name = StringOrEmpty(entry->app_name());
+  result.app_package_name = StringOrEmpty(entry->app_package_name());
+  result.serialized_entity_data =
+      StringOrEmpty(entry->serialized_entity_data());
+  result.datetime_parse_result =
+      DatetimeParseResultFromDatabase(entry->datetime_parse_result());
+  result.serialized_knowledge_result =
+      StringOrEmpty(entry->serialized_knowledge_result());
+  result.contact_pointer = ContactPointerFromDatabase(entry->contact_pointer());
+  result.numeric_value = entry->numeric_value();
+  result.numeric_double_value = entry->numeric_double_value();
+  result.duration_ms = entry->duration_ms();
+  return result;
+}
+
+// Returns whether the n-grams start inside |ngram_pieces| and are in strictly
+// increasing byte order, as the binary search of the SortedStringsTable needs.
+// The pieces must end with a zero byte. Reads all the n-gram bytes once, which
+// is the same order of work as verifying the flatbuffer.
+bool HasValidNgrams(const LookupDatabase& database) {
+  const flatbuffers::Vector<uint8_t>& pieces = *database.ngram_pieces();
+  const flatbuffers::Vector<uint32_t>& offsets = *database.ngram_offsets();
+  const char* const data = reinterpret_cast<const char*>(pieces.data());
+  for (int i = 0; i < offsets.size(); ++i) {
+    if (offsets.Get(i) >= pieces.size()) {
+      return false;
+    }
+    if (i > 0 &&
+        strcmp(data + offsets.Get(i - 1), data + offsets.Get(i)) >= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+LookupEngine::LookupEngine(const std::string& collection,
+                           const FeatureProcessor* feature_processor,
+                           const UniLib* unilib)
+    : collection_(collection),
+      feature_processor_(feature_processor),
+      normalizer_(unilib),
+      snapshot_(std::make_shared<Snapshot>()) {}
+
+bool LookupEngine::InitializeDatabase(const void* buffer, int size) {
+  const LookupDatabase* database =
+      LoadAndVerifyFlatbuffer<LookupDatabase>(buffer, size);
+  if (database == nullptr) {
+    TC3_LOG(ERROR) << "Could not load the lookup database.";
+    return false;
+  }
+  std::shared_ptr<const SortedStringsTable> database_ngrams;
+  // Empty vectors are not serialized.
+  if (database->ngram_offsets() == nullptr ||
+      database->ngram_offsets()->size() == 0) {
+    database = nullptr;
+  } else {
+    const int num_ngrams = database->ngram_offsets()->size();
+    if (database->ngram_pieces() == nullptr ||
+        database->ngram_pieces()->size() == 0 ||
+        database->ngram_pieces()->Get(database->ngram_pieces()->size() - 1) !=
+            0 ||
+        database->entry_indices_offsets() == nullptr ||
+        database->entry_indices_offsets()->size() != num_ngrams + 1 ||
+        database->entry_indices() == nullptr ||
+        database->entry_indices_offsets()->Get(num_ngrams) !=
+            database->entry_indices()->size() ||
+        database->entries() == nullptr || !HasValidNgrams(*database)) {
+      TC3_LOG(ERROR) << "Inconsistent lookup database.";
+      return false;
+    }
+    database_ngrams = std::make_shared<SortedStringsTable>(
+        num_ngrams, database->ngram_offsets()->data(),
+        StringPiece(
+            reinterpret_cast<const char*>(database->ngram_pieces()->data()),
+            database->ngram_pieces()->size()));
+  }
+
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  auto snapshot = std::make_shared<Snapshot>(*GetSnapshot());
+  snapshot->database = database;
+  snapshot->database_ngrams = std::move(database_ngrams);
+  std::atomic_store(&snapshot_,
+                    std::shared_ptr<const Snapshot>(std::move(snapshot)));
+  return true;
+}
+
+std::unique_ptr<LookupDatabaseT> LookupEngine::CreateDatabase() const {
+  const std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  std::vector<std::pair<int, const Entry*>> entries;
+  for (int i = 0; i < snapshot->layers.size(); ++i) {
+    for (const auto& entry : snapshot->layers[i]->entries) {
+      if (!IsRemoved(*snapshot, i, entry.first)) {
+        entries.push_back({entry.first, entry.second.get()});
+      }
+    }
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<int, const Entry*>& a,
+               const std::pair<int, const Entry*>& b) {
+              return a.first < b.first;
+            });
+
+  // The n-grams need to be in byte order for the SortedStringsTable.
+  auto database = std::make_unique<LookupDatabaseT>();
+  std::map<std::string, std::vector<int>> ngram_to_entry_index;
+  for (int i = 0; i < entries.size(); ++i) {
+    for (const std::string& ngram : entries[i].second->ngrams) {
+      if (ngram.find('\0') != std::string::npos) {
+        TC3_LOG(WARNING) << "Skipping an n-gram with a zero byte.";
+        continue;
+      }
+      ngram_to_entry_index[ngram].push_back(i);
+    }
+    database->entries.push_back(CreateDatabaseEntry(entries[i].second->result));
+  }
+  for (const auto& ngram : ngram_to_entry_index) {
+    database->ngram_offsets.push_back(database->ngram_pieces.size());
+    database->ngram_pieces.insert(database->ngram_pieces.end(),
+                                  ngram.first.begin(), ngram.first.end());
+    database->ngram_pieces.push_back(0);
+    database->entry_indices_offsets.push_back(database->entry_indices.size());
+    database->entry_indices.insert(database->entry_indices.end(),
+                                   ngram.second.begin(), ngram.second.end());
+  }
+  database->entry_indices_offsets.push_back(database->entry_indices.size());
+  return database;
+}
+
+int LookupEngine::AddEntry(const std::vector<std::string>& ngrams,
+                           ClassificationResult entry) {
+  std::vector<int> entry_ids;
+  ReplaceEntries(/*removed_entry_ids=*/{}, {{ngrams, std::move(entry)}},
+                 &entry_ids);
+  return entry_ids[0];
+}
+
+bool LookupEngine::RemoveEntry(int entry_id) {
+  return ReplaceEntries({entry_id}, /*added_entries=*/{},
+                        /*added_entry_ids=*/nullptr);
+}
+
+bool LookupEngine::ReplaceEntries(
+    const std::vector<int>& removed_entry_ids,
+    std::vector<std::pair<std::vector<std::string>, ClassificationResult>>
+        added_entries,
+    std::vector<int>* added_entry_ids) {
+  // Normalize before taking the lock, to keep the critical section short.
+  std::vector<std::shared_ptr<const Entry>> entries;
+  for (auto& added_entry : added_entries) {
+    entries.push_back(
+        CreateEntry(added_entry.first, std::move(added_entry.second)));
+  }
+
+  std::lock_guard<std::mutex> lock(update_mutex_);
+  auto snapshot = std::make_shared<Snapshot>(*GetSnapshot());
+  for (const int entry_id : removed_entry_ids) {
+    if (!ContainsEntry(*snapshot, entry_id)) {
+      TC3_LOG(ERROR) << "No lookup entry with id " << entry_id;
+      return false;
+    }
+  }
+
+  auto layer = std::make_shared<EntryLayer>();
+  layer->removed_entry_ids.insert(removed_entry_ids.begin(),
+                                  removed_entry_ids.end());
+  for (std::shared_ptr<const Entry>& entry : entries) {
+    const int entry_id = next_entry_id_++;
+    layer->AddEntry(entry_id, std::move(entry));
+    if (added_entry_ids != nullptr) {
+      added_entry_ids->push_back(entry_id);
+    }
+  }
+  std::vector<std::shared_ptr<const EntryLayer>>& layers = snapshot->layers;
+  layers.push_back(std::move(layer));
+
+  // Merge the newest layers while they are not much smaller than the ones
+  // before them, so that the layer sizes decrease geometrically.
+  while (layers.size() >= 2 &&
+         2 * layers.back()->size() >= layers[layers.size() - 2]->size()) {
+    std::shared_ptr<const EntryLayer> merged =
+        MergeLayers(*layers[layers.size() - 2], *layers.back(),
+                    /*is_oldest=*/layers.size() == 2);
+    layers.pop_back();
+    layers.back() = std::move(merged);
+  }
+
+  std::atomic_store(&snapshot_,
+                    std::shared_ptr<const Snapshot>(std::move(snapshot)));
+  return true;
+}
+
+std::shared_ptr<const LookupEngine::Entry> LookupEngine::CreateEntry(
+    const std::vector<std::string>& ngrams, ClassificationResult result) const {
+  auto entry = std::make_shared<Entry>();
+  entry->result = std::move(result);
   for (const std::string& ngram : ngrams) {
     if (ngram.empty()) {
       continue;
@@ -42,14 +366,144 @@ void LookupEngine::AddEntry(const std::vector<std::string>& ngrams,
     CodepointSpan ngram_span = {0, ngram_unicode.size_codepoints()};
     auto stripped_ngram =
         StripBoundaryCodepointsAndNormalize(&start_it, &end_it, &ngram_span);
-    if (!stripped_ngram.empty()) {
-      // TODO(b/120870643): Add transcription and lemmatization.
-      std::vector<int>* entry_indices = &ngram_to_entry_index_[stripped_ngram];
-      if (entry_indices->empty() || entry_indices->back() != entry_index) {
-        entry_indices->push_back(entry_index);
+    // TODO(b/120870643): Add transcription and lemmatization.
+    if (!stripped_ngram.empty() &&
+        std::find(entry->ngrams.begin(), entry->ngrams.end(),
+                  stripped_ngram) == entry->ngrams.end()) {
+      entry->ngrams.push_back(std::move(stripped_ngram));
+    }
+  }
+  return entry;
+}
+
+void LookupEngine::EntryLayer::AddEntry(int entry_id,
+                                        std::shared_ptr<const Entry> entry) {
+  for (const std::string& ngram : entry->ngrams) {
+    std::vector<int>* entry_ids = &ngram_to_entry_ids[ngram];
+    if (entry_ids->empty()) {
+      AddToTrie(ngram);
+    }
+    entry_ids->push_back(entry_id);
+  }
+  entries[entry_id] = std::move(entry);
+}
+
+void LookupEngine::EntryLayer::AddToTrie(const std::string& ngram) {
+  int node = kNgramTrieRoot;
+  for (const char byte : ngram) {
+    const int child = TrieChild(node, byte);
+    if (child != kNoNgramTrieNode) {
+      node = child;
+      continue;
+    }
+    const int new_node = trie_is_ngram.size();
+    trie_is_ngram.push_back(false);
+    trie_children[(static_cast<int64>(node) << 8) | static_cast<uint8>(byte)] =
+        new_node;
+    node = new_node;
+  }
+  trie_is_ngram[node] = true;
+}
+
+int LookupEngine::EntryLayer::TrieChild(int node, char byte) const {
+  const auto it = trie_children.find((static_cast<int64>(node) << 8) |
+                                     static_cast<uint8>(byte));
+  return it != trie_children.end() ? it->second : kNoNgramTrieNode;
+}
+
+bool LookupEngine::IsRemoved(const Snapshot& snapshot, int layer_index,
+                             int entry_id) {
+  for (int i = layer_index + 1; i < snapshot.layers.size(); ++i) {
+    if (snapshot.layers[i]->removed_entry_ids.count(entry_id) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LookupEngine::ContainsEntry(const Snapshot& snapshot, int entry_id) {
+  for (int i = 0; i < snapshot.layers.size(); ++i) {
+    if (snapshot.layers[i]->entries.count(entry_id) > 0) {
+      return !IsRemoved(snapshot, i, entry_id);
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<const LookupEngine::EntryLayer> LookupEngine::MergeLayers(
+    const EntryLayer& older, const EntryLayer& newer, bool is_oldest) {
+  auto merged = std::make_shared<EntryLayer>();
+  for (const auto& entry : older.entries) {
+    if (newer.removed_entry_ids.count(entry.first) == 0) {
+      merged->entries.insert(entry);
+    }
+  }
+  merged->entries.insert(newer.entries.begin(), newer.entries.end());
+  if (!is_oldest) {
+    merged->removed_entry_ids = older.removed_entry_ids;
+    for (const int entry_id : newer.removed_entry_ids) {
+      if (older.entries.count(entry_id) == 0) {
+        merged->removed_entry_ids.insert(entry_id);
       }
     }
   }
+
+  // The ids of the newer layer are all greater, so appending them keeps the
+  // lists sorted.
+  for (const auto& ngram : older.ngram_to_entry_ids) {
+    std::vector<int> entry_ids;
+    for (const int entry_id : ngram.second) {
+      if (newer.removed_entry_ids.count(entry_id) == 0) {
+        entry_ids.push_back(entry_id);
+      }
+    }
+    if (!entry_ids.empty()) {
+      merged->ngram_to_entry_ids[ngram.first] = std::move(entry_ids);
+    }
+  }
+  for (const auto& ngram : newer.ngram_to_entry_ids) {
+    std::vector<int>* entry_ids = &merged->ngram_to_entry_ids[ngram.first];
+    entry_ids->insert(entry_ids->end(), ngram.second.begin(),
+                      ngram.second.end());
+  }
+  for (const auto& ngram : merged->ngram_to_entry_ids) {
+    merged->AddToTrie(ngram.first);
+  }
+  return merged;
+}
+
+void LookupEngine::FindNgramPrefixes(const Snapshot& snapshot,
+                                     StringPiece text,
+                                     std::vector<bool>* is_ngram_prefix) {
+  is_ngram_prefix->assign(text.size() + 1, false);
+  for (const std::shared_ptr<const EntryLayer>& layer : snapshot.layers) {
+    int node = kNgramTrieRoot;
+    for (int i = 0; i < text.size(); ++i) {
+      node = layer->TrieChild(node, text[i]);
+      if (node == kNoNgramTrieNode) {
+        break;
+      }
+      if (layer->trie_is_ngram[node]) {
+        (*is_ngram_prefix)[i + 1] = true;
+      }
+    }
+  }
+  if (snapshot.database != nullptr) {
+    snapshot.database_ngrams->GatherPrefixMatches(
+        text, [is_ngram_prefix](const StringSet::Match& match) {
+          (*is_ngram_prefix)[match.match_length] = true;
+        });
+  }
+}
+
+bool LookupEngine::IsIgnoredSpanBoundaryCodepoint(
+    const UnicodeText::const_iterator& it, CodepointIndex index) const {
+  if (feature_processor_ == nullptr) {
+    return false;
+  }
+  return feature_processor_
+      ->StripBoundaryCodepoints(it, std::next(it), {index, index + 1})
+      .IsEmpty();
 }
 
 bool LookupEngine::ClassifyTextInternal(
@@ -63,8 +517,10 @@ bool LookupEngine::ClassifyTextInternal(
   auto end_it = start_it;
   std::advance(end_it, selection_indices.second - selection_indices.first);
 
-  std::vector<ClassificationResult> classification_results = FindMatches(
-      /*max_num_matches=*/1, start_it, end_it, &selection_indices);
+  const std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
+  std::vector<ClassificationResult> classification_results =
+      FindMatches(*snapshot, /*max_num_matches=*/1, start_it, end_it,
+                  &selection_indices);
 
   if (!classification_results.empty()) {
     *classification_result = std::move(classification_results[0]);
@@ -78,9 +534,71 @@ bool LookupEngine::ChunkInternal(const UnicodeText& context_unicode,
                                  const std::vector<Token>& tokens,
                                  int max_num_tokens, int max_num_matches,
                                  std::vector<AnnotatedSpan>* result) const {
+  if (tokens.empty()) {
+    return true;
+  }
+
+  const bool prefilter_by_ngrams = CanPrefilterByNgrams();
+
+  // To pre-filter, normalize the text covered by the tokens once. The
+  // normalization works codepoint by codepoint, so the normalized text of any
+  // span in it is the substring between the normalized offsets of the span
+  // ends. Indices below are relative to the start of the first token.
+  const CodepointIndex text_start = tokens.front().start;
+  std::string normalized_text;
+  std::vector<int> normalized_offsets;
+  // Number of boundary codepoints that would be stripped from a span starting
+  // (ending) at the given index.
+  std::vector<int> leading_ignored;
+  std::vector<int> trailing_ignored;
+  if (prefilter_by_ngrams) {
+    CodepointIndex text_end = text_start;
+    for (const Token& token : tokens) {
+      text_end = std::max(text_end, token.end);
+    }
+    const int num_codepoints = text_end - text_start;
+    auto text_start_it = context_unicode.begin();
+    std::advance(text_start_it, text_start);
+    auto text_end_it = text_start_it;
+    std::vector<std::string::size_type> utf8_offsets(num_codepoints + 1);
+    std::vector<bool> ignored(num_codepoints);
+    for (int i = 0; i < num_codepoints; ++i, ++text_end_it) {
+      utf8_offsets[i] = text_end_it.utf8_data() - text_start_it.utf8_data();
+      ignored[i] = IsIgnoredSpanBoundaryCodepoint(text_end_it, text_start + i);
+    }
+    utf8_offsets[num_codepoints] =
+        text_end_it.utf8_data() - text_start_it.utf8_data();
+
+    std::vector<std::string::size_type> original_indices;
+    normalized_text = normalizer_.Normalize(
+        UnicodeText::UTF8Substring(text_start_it, text_end_it),
+        /*fold_case=*/true, &original_indices);
+    normalized_offsets.resize(num_codepoints + 1);
+    for (int i = 0, offset = 0; i <= num_codepoints; ++i) {
+      while (offset < normalized_text.size() &&
+             original_indices[offset] < utf8_offsets[i]) {
+        ++offset;
+      }
+      normalized_offsets[i] = offset;
+    }
+
+    leading_ignored.assign(num_codepoints + 1, 0);
+    trailing_ignored.assign(num_codepoints + 1, 0);
+    for (int i = num_codepoints - 1; i >= 0; --i) {
+      leading_ignored[i] = ignored[i] ? leading_ignored[i + 1] + 1 : 0;
+    }
+    for (int i = 0; i < num_codepoints; ++i) {
+      trailing_ignored[i + 1] = ignored[i] ? trailing_ignored[i] + 1 : 0;
+    }
+  }
+
+  const std::shared_ptr<const Snapshot> snapshot = GetSnapshot();
   CodepointIndex start_codepoint_idx = 0;
   auto start_it = context_unicode.begin();
   TokenIndex minimum_start = 0;
+  // Whether the normalized text from the stripped start of the current match,
+  // up to the given number of bytes, is an n-gram.
+  std::vector<bool> is_ngram_prefix;
 
   // Iterate over all the possible starts (token indices) of a match.
   for (TokenIndex start = 0; start < tokens.size(); ++start) {
@@ -95,21 +613,55 @@ bool LookupEngine::ChunkInternal(const UnicodeText& context_unicode,
       ++start_it;
     }
 
+    const TokenIndex last_end =
+        std::min<TokenIndex>(start + max_num_tokens, tokens.size());
+    if (last_end <= start) {
+      continue;
+    }
+
+    // Look up the n-grams in the normalized text, up to the end of the longest
+    // possible match.
+    int match_start = 0;
+    int match_start_offset = 0;
+    if (prefilter_by_ngrams) {
+      match_start = start_codepoint_idx - text_start +
+                    leading_ignored[start_codepoint_idx - text_start];
+      match_start_offset = normalized_offsets[match_start];
+      const int window_end = tokens[last_end - 1].end - text_start;
+      const int window_size =
+          std::max(normalized_offsets[window_end] - match_start_offset, 0);
+      FindNgramPrefixes(
+          *snapshot,
+          StringPiece(normalized_text.data() + match_start_offset, window_size),
+          &is_ngram_prefix);
+    }
+
     CodepointIndex end_codepoint_idx = start_codepoint_idx;
     auto end_it = start_it;
     std::vector<TokenIndex> end_candidates;
     std::vector<CodepointIndex> end_codepoint_idx_candidates;
     std::vector<UnicodeText::const_iterator> end_it_candidates;
     // Iterate over all the possible ends (token indices) of a match.
-    for (TokenIndex end = start + 1;
-         end <= start + max_num_tokens && end <= tokens.size(); ++end) {
+    for (TokenIndex end = start + 1; end <= last_end; ++end) {
       // Update the codepoint index and the iterator.
       while (end_codepoint_idx < tokens[end - 1].end) {
         ++end_codepoint_idx;
         ++end_it;
       }
 
-      // Store the possible ends in the vectors.
+      // Store the ends at which the stripped span is a known n-gram, or all
+      // the ends if they cannot be pre-filtered.
+      if (prefilter_by_ngrams) {
+        const int match_end = end_codepoint_idx - text_start -
+                              trailing_ignored[end_codepoint_idx - text_start];
+        if (match_end <= match_start ||
+            normalized_offsets[match_end] - match_start_offset >=
+                is_ngram_prefix.size() ||
+            !is_ngram_prefix[normalized_offsets[match_end] -
+                             match_start_offset]) {
+          continue;
+        }
+      }
       end_candidates.push_back(end);
       end_codepoint_idx_candidates.push_back(end_codepoint_idx);
       end_it_candidates.push_back(end_it);
@@ -122,8 +674,8 @@ bool LookupEngine::ChunkInternal(const UnicodeText& context_unicode,
                                                end_codepoint_idx_candidates[i]};
       AnnotatedSpan annotated_span;
       annotated_span.classification =
-          FindMatches(max_num_matches, start_it, end_it_candidates[i],
-                      &stripped_codepoint_span);
+          FindMatches(*snapshot, max_num_matches, start_it,
+                      end_it_candidates[i], &stripped_codepoint_span);
 
       if (!annotated_span.classification.empty()) {
         // At least one match was found, add all the matches to the result.
@@ -162,37 +714,75 @@ std::string LookupEngine::StripBoundaryCodepointsAndNormalize(
 }
 
 std::vector<ClassificationResult> LookupEngine::FindMatches(
-    int max_num_matches, const UnicodeText::const_iterator& start_it,
+    const Snapshot& snapshot, int max_num_matches,
+    const UnicodeText::const_iterator& start_it,
     const UnicodeText::const_iterator& end_it, CodepointSpan* span) const {
   UnicodeText::const_iterator after_strip_start_it = start_it;
   UnicodeText::const_iterator after_strip_end_it = end_it;
   absl::flat_hash_set<int> index;
   std::vector<ClassificationResult> results;
-  FindTokenMatches(StripBoundaryCodepointsAndNormalize(
+  FindTokenMatches(snapshot,
+                   StripBoundaryCodepointsAndNormalize(
                        &after_strip_start_it, &after_strip_end_it, span),
                    max_num_matches, &index, &results);
   return results;
 }
 
+std::vector<ClassificationResult> LookupEngine::FindMatches(
+    int max_num_matches, const UnicodeText::const_iterator& start_it,
+    const UnicodeText::const_iterator& end_it, CodepointSpan* span) const {
+  return FindMatches(*GetSnapshot(), max_num_matches, start_it, end_it, span);
+}
+
 void LookupEngine::FindTokenMatches(
-    const std::string& token, int max_num_matches,
+    const Snapshot& snapshot, const std::string& token, int max_num_matches,
     absl::flat_hash_set<int>* result_index,
     std::vector<ClassificationResult>* results) const {
-  const auto it = ngram_to_entry_index_.find(token);
-  if (it == ngram_to_entry_index_.end()) {
-    return;
-  }
-  for (const int entry_idx : it->second) {
-    if (results->size() == max_num_matches) {
-      break;
+  // The entries of the database come first. They are indexed in
+  // |result_index| with negative numbers, to not collide with the entry ids.
+  int ngram_idx;
+  if (snapshot.database != nullptr &&
+      snapshot.database_ngrams->Find(token, &ngram_idx)) {
+    const LookupDatabase* database = snapshot.database;
+    const uint32 begin = database->entry_indices_offsets()->Get(ngram_idx);
+    const uint32 end = database->entry_indices_offsets()->Get(ngram_idx + 1);
+    for (uint32 i = begin; i < end && i < database->entry_indices()->size();
+         ++i) {
+      if (results->size() == max_num_matches) {
+        return;
+      }
+      const uint32 entry_idx = database->entry_indices()->Get(i);
+      const int result_idx = -1 - static_cast<int>(entry_idx);
+      if (entry_idx >= database->entries()->size() ||
+          result_index->contains(result_idx)) {
+        continue;
+      }
+      results->push_back(ClassificationResultFromDatabase(
+          database->entries()->Get(entry_idx)));
+      results->back().collection = collection_;
+      result_index->emplace(result_idx);
     }
-    // Avoid selecting the same result more than once.
-    if (result_index->contains(entry_idx)) {
+  }
+
+  for (int i = 0; i < snapshot.layers.size(); ++i) {
+    const EntryLayer& layer = *snapshot.layers[i];
+    const auto it = layer.ngram_to_entry_ids.find(token);
+    if (it == layer.ngram_to_entry_ids.end()) {
       continue;
     }
-    results->emplace_back(entries_[entry_idx]);
-    results->back().collection = collection_;
-    result_index->emplace(entry_idx);
+    for (const int entry_id : it->second) {
+      if (results->size() == max_num_matches) {
+        return;
+      }
+      // Avoid selecting the same result more than once.
+      if (result_index->contains(entry_id) ||
+          IsRemoved(snapshot, i, entry_id)) {
+        continue;
+      }
+      results->emplace_back(layer.entries.at(entry_id)->result);
+      results->back().collection = collection_;
+      result_index->emplace(entry_id);
+    }
   }
 }
 
@@ -16,13 +16,21 @@
 #ifndef LIBTEXTCLASSIFIER_ANNOTATOR_LOOKUP_LOOKUP_ENGINE_H_
 #define LIBTEXTCLASSIFIER_ANNOTATOR_LOOKUP_LOOKUP_ENGINE_H_
 
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "annotator/feature-processor.h"
+#include "annotator/lookup/lookup-database_generated.h"
 #include "annotator/lookup/normalizer.h"
 #include "annotator/types.h"
+#include "utils/base/integral_types.h"
+#include "utils/container/sorted-strings-table.h"
+#include "utils/strings/stringpiece.h"
 #include "utils/utf8/unicodetext.h"
 #include "utils/utf8/unilib.h"
 #include "third_party/absl/container/flat_hash_set.h"
@@ -30,25 +38,70 @@
 namespace libtextclassifier3 {
 
 // A common implementation of annotation engines that annotate by looking up
-// n-grams in an in-memory database.
+// n-grams in an in-memory database, and optionally in a serialized one.
+//
+// The entries can be updated while lookups run on other threads. Every update
+// publishes a new immutable snapshot of the entries, and lookups use the
+// snapshot that was current when they started, without waiting for updates.
+// Updates only copy the entries they change: the entries are kept in layers
+// that are merged as they grow, as in a log-structured merge tree, so an entry
+// is copied O(log(number of entries)) times over its lifetime. That cost is
+// amortized: a single update can merge all the layers, and copy all the
+// entries. Adding n entries one by one takes O(n log n) in total, adding them
+// with one |ReplaceEntries| takes O(n).
+// NOTE: Lookups are thread-safe, updates are serialized.
 class LookupEngine {
  public:
   // The collection specified here is set on all the returned classification
   // results.
   LookupEngine(const std::string& collection,
-               const FeatureProcessor* feature_processor, const UniLib* unilib)
-      : collection_(collection),
-        feature_processor_(feature_processor),
-        normalizer_(unilib) {}
+               const FeatureProcessor* feature_processor, const UniLib* unilib);
 
   virtual ~LookupEngine() = default;
 
  protected:
+  // The entries at some point in time. Each public lookup takes one snapshot
+  // and passes it down, so that it sees the entries consistently and only pays
+  // for the atomic load once. Opaque to subclasses, which only pass it on.
+  struct Snapshot;
+
+  // Loads a database created with |CreateDatabase| and serialized with
+  // PackFlatbuffer<LookupDatabase>. Its entries are looked up before the ones
+  // added with |AddEntry|. The buffer is used in place, without copying (so it
+  // can be memory mapped), and needs to outlive the engine. Returns false if
+  // the buffer is not a valid database, including when its n-grams are not
+  // distinct and sorted. Takes time linear in the size of the buffer, for the
+  // flatbuffer verification and the check of the n-gram order, but allocates
+  // nothing proportional to it.
+  bool InitializeDatabase(const void* buffer, int size);
+
+  // Creates a database of the entries added with |AddEntry| and not removed.
+  // All the fields of their classification results are kept, except the
+  // collection, which is set by the engine that loads the database.
+  std::unique_ptr<LookupDatabaseT> CreateDatabase() const;
+
   // Adds an entry (in the form of a classification result) to the database.
   // This result will be returned for n-grams in text matching those in the
   // given list. Duplicates and empty strings in the list are ignored.
-  void AddEntry(const std::vector<std::string>& ngrams,
-                ClassificationResult entry);
+  // Returns the id of the entry, to remove it with |RemoveEntry|.
+  int AddEntry(const std::vector<std::string>& ngrams,
+               ClassificationResult entry);
+
+  // Removes an entry added with |AddEntry|. Returns false if there is no such
+  // entry.
+  bool RemoveEntry(int entry_id);
+
+  // Removes the entries and adds the new ones (n-grams and classification
+  // result, as in |AddEntry|), in a single update that lookups see at once.
+  // Also the way to bulk load entries, as they are indexed together.
+  // The ids of the added entries are appended to |added_entry_ids|, if not
+  // null. Returns false, without updating anything, if one of the entries to
+  // remove does not exist.
+  bool ReplaceEntries(
+      const std::vector<int>& removed_entry_ids,
+      std::vector<std::pair<std::vector<std::string>, ClassificationResult>>
+          added_entries,
+      std::vector<int>* added_entry_ids);
 
   // Classifies the span and returns at most one result, the one added earlies
   // to the database.
@@ -65,23 +118,46 @@ class LookupEngine {
   // the natural order, and for each of them, all the end positions in reversed
   // order (starting with the given maximum number of tokens), to prefer longer
   // matches. Once a match is found, moves on beyond it.
+  // If |CanPrefilterByNgrams|, the text is normalized once, and the ends are
+  // pre-filtered by looking up the n-grams that are prefixes of the normalized
+  // text from each start, so |FindMatches| is only called on spans whose
+  // normalized text is a known n-gram. Otherwise |FindMatches| is called on
+  // all the spans, without any setup.
   bool ChunkInternal(const UnicodeText& context_unicode,
                      const std::vector<Token>& tokens, int max_num_tokens,
                      int max_num_matches,
                      std::vector<AnnotatedSpan>* result) const;
 
-  // Looks for matching n-grams for the given string (expressed both as an
-  // iterator span and a codepoint span, for efficiency). Modifies |span| to
-  // represent the found match. |results| preserves matching order.
+  // Looks for matching n-grams in |snapshot| for the given string (expressed
+  // both as an iterator span and a codepoint span, for efficiency). Modifies
+  // |span| to represent the found match. |results| preserves matching order.
   // This method needs to be virtual for customization in classes such as
   // |ContactEngine|.
   // result_index: collects the indexes associated with the list of |results|.
   virtual std::vector<ClassificationResult> FindMatches(
-      int max_num_matches, const UnicodeText::const_iterator& start_it,
+      const Snapshot& snapshot, int max_num_matches,
+      const UnicodeText::const_iterator& start_it,
       const UnicodeText::const_iterator& end_it, CodepointSpan* span) const;
 
-  // Looks for matching n-grams for the given |token|.
-  void FindTokenMatches(const std::string& token, int max_num_matches,
+  // Looks for matches in the current snapshot. The lookups only call the
+  // overload above, so this one is final: overrides written against it fail to
+  // compile instead of silently never being called.
+  virtual std::vector<ClassificationResult> FindMatches(
+      int max_num_matches, const UnicodeText::const_iterator& start_it,
+      const UnicodeText::const_iterator& end_it, CodepointSpan* span) const
+      final;
+
+  // Returns whether |FindMatches| only matches spans whose stripped and
+  // normalized text is one of the n-grams of the entries, which lets
+  // |ChunkInternal| skip the other spans. False by default, so that overrides
+  // of |FindMatches| that match other spans (e.g. by looking up variants of the
+  // text) keep all of their matches. Subclasses that keep the base
+  // |FindMatches| can return true to opt in.
+  virtual bool CanPrefilterByNgrams() const { return false; }
+
+  // Looks for matching n-grams in |snapshot| for the given |token|.
+  void FindTokenMatches(const Snapshot& snapshot, const std::string& token,
+                        int max_num_matches,
                         absl::flat_hash_set<int>* result_index,
                         std::vector<ClassificationResult>* results) const;
 
@@ -96,12 +172,94 @@ class LookupEngine {
 
  private:
   friend class LookupEngineTest;
+
+  static constexpr int kNgramTrieRoot = 0;
+  static constexpr int kNoNgramTrieNode = -1;
+
+  struct Entry {
+    ClassificationResult result;
+
+    // The stripped and normalized n-grams of the entry, without duplicates.
+    std::vector<std::string> ngrams;
+  };
+
+  // An immutable (once published) set of entries, with its n-gram index.
+  struct EntryLayer {
+    // The entries, by id.
+    std::unordered_map<int, std::shared_ptr<const Entry>> entries;
+
+    // The ids of the entries matching each n-gram, in increasing order.
+    std::unordered_map<std::string, std::vector<int>> ngram_to_entry_ids;
+
+    // The ids of the entries of older layers that were removed.
+    std::unordered_set<int> removed_entry_ids;
+
+    // Byte-wise trie over the keys of |ngram_to_entry_ids|. The edges are
+    // keyed by the parent node and the byte, |trie_is_ngram| marks the nodes
+    // that end a key.
+    std::unordered_map<int64, int> trie_children;
+    std::vector<bool> trie_is_ngram = {false};
+
+    void AddEntry(int entry_id, std::shared_ptr<const Entry> entry);
+    void AddToTrie(const std::string& ngram);
+
+    // Returns the child of the trie node for the byte, or kNoNgramTrieNode.
+    int TrieChild(int node, char byte) const;
+
+    int size() const { return entries.size() + removed_entry_ids.size(); }
+  };
+
+  std::shared_ptr<const Snapshot> GetSnapshot() const {
+    return std::atomic_load(&snapshot_);
+  }
+
+  // Strips and normalizes the n-grams of a new entry.
+  std::shared_ptr<const Entry> CreateEntry(
+      const std::vector<std::string>& ngrams,
+      ClassificationResult result) const;
+
+  // Returns whether the entry of the given layer was removed in a newer one.
+  static bool IsRemoved(const Snapshot& snapshot, int layer_index,
+                        int entry_id);
+
+  // Returns whether the entry exists and was not removed.
+  static bool ContainsEntry(const Snapshot& snapshot, int entry_id);
+
+  // Merges two consecutive layers. The removed entries are dropped if
+  // |older| is the oldest layer, as there is nothing left to remove them from.
+  static std::shared_ptr<const EntryLayer> MergeLayers(
+      const EntryLayer& older, const EntryLayer& newer, bool is_oldest);
+
+  // Sets |is_ngram_prefix| to whether the prefix of |text| with the given
+  // length in bytes is an n-gram, for all the lengths up to the text size.
+  static void FindNgramPrefixes(const Snapshot& snapshot, StringPiece text,
+                                std::vector<bool>* is_ngram_prefix);
+
+  // Returns whether the codepoint at |it| (with index |index|) is stripped from
+  // span boundaries.
+  bool IsIgnoredSpanBoundaryCodepoint(const UnicodeText::const_iterator& it,
+                                      CodepointIndex index) const;
+
   const std::string collection_;
   const FeatureProcessor* feature_processor_;
   const Normalizer normalizer_;
 
-  std::vector<ClassificationResult> entries_;
-  std::unordered_map<std::string, std::vector<int>> ngram_to_entry_index_;
+  // Accessed with std::atomic_load and std::atomic_store.
+  std::shared_ptr<const Snapshot> snapshot_;
+
+  // Serializes the updates of |snapshot_|.
+  std::mutex update_mutex_;
+  int next_entry_id_ = 0;
+};
+
+struct LookupEngine::Snapshot {
+  // Not owned, nullptr if no database was loaded or it is empty.
+  const LookupDatabase* database = nullptr;
+  std::shared_ptr<const SortedStringsTable> database_ngrams;
+
+  // From the oldest to the newest, the ids of the entries increase with the
+  // layers.
+  std::vector<std::shared_ptr<const EntryLayer>> layers;
 };
 
 }  // namespace libtextclassifier3
@@ -0,0 +1,286 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "annotator/lookup/lookup-engine.h"
+
+#include <atomic>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "annotator/types.h"
+#include "utils/flatbuffers/flatbuffers.h"
+#include "utils/utf8/unilib.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+class TestLookupEngine : public LookupEngine {
+ public:
+  explicit TestLookupEngine(const UniLib* unilib)
+      : LookupEngine("test", /*feature_processor=*/nullptr, unilib) {}
+
+  using LookupEngine::AddEntry;
+  using LookupEngine::ChunkInternal;
+  using LookupEngine::ClassifyTextInternal;
+  using LookupEngine::CreateDatabase;
+  using LookupEngine::InitializeDatabase;
+  using LookupEngine::RemoveEntry;
+  using LookupEngine::ReplaceEntries;
+};
+
+ClassificationResult ContactResult(const std::string& contact_name) {
+  ClassificationResult result("ignored", /*arg_score=*/1.0);
+  result.contact_name = contact_name;
+  return result;
+}
+
+// Returns the contact name of the first result for the whole text, or "" if
+// there is none.
+std::string Classify(const TestLookupEngine& engine, const std::string& text) {
+  const int num_codepoints =
+      UTF8ToUnicodeText(text, /*do_copy=*/false).size_codepoints();
+  ClassificationResult result;
+  if (!engine.ClassifyTextInternal(text, {0, num_codepoints}, &result)) {
+    return "";
+  }
+  return result.contact_name;
+}
+
+TEST(LookupEngineTest, AddsAndRemovesEntries) {
+  const UniLib unilib;
+  TestLookupEngine engine(&unilib);
+  const int first_id = engine.AddEntry({"Obama"}, ContactResult("first"));
+  const int second_id =
+      engine.AddEntry({"obama", "Barack Obama"}, ContactResult("second"));
+  EXPECT_NE(first_id, second_id);
+
+  // The results come in the order the entries were added.
+  EXPECT_EQ(Classify(engine, "obama"), "first");
+  EXPECT_EQ(Classify(engine, "barack obama"), "second");
+  EXPECT_EQ(Classify(engine, "michelle"), "");
+
+  EXPECT_TRUE(engine.RemoveEntry(first_id));
+  EXPECT_EQ(Classify(engine, "obama"), "second");
+  EXPECT_FALSE(engine.RemoveEntry(first_id));
+  EXPECT_FALSE(engine.RemoveEntry(second_id + 1));
+
+  EXPECT_TRUE(engine.RemoveEntry(second_id));
+  EXPECT_EQ(Classify(engine, "obama"), "");
+  EXPECT_EQ(Classify(engine, "barack obama"), "");
+}
+
+TEST(LookupEngineTest, ReplacesEntriesInOneUpdate) {
+  const UniLib unilib;
+  TestLookupEngine engine(&unilib);
+  const int old_id = engine.AddEntry({"obama"}, ContactResult("old"));
+
+  std::vector<int> added_ids;
+  EXPECT_TRUE(engine.ReplaceEntries({old_id},
+                                    {{{"obama"}, ContactResult("new")},
+                                     {{"michelle"}, ContactResult("wife")}},
+                                    &added_ids));
+  ASSERT_EQ(added_ids.size(), 2);
+  EXPECT_EQ(Classify(engine, "obama"), "new");
+  EXPECT_EQ(Classify(engine, "michelle"), "wife");
+
+  // Nothing is updated if one of the entries to remove does not exist.
+  EXPECT_FALSE(engine.ReplaceEntries({added_ids[0], old_id},
+                                     {{{"sasha"}, ContactResult("daughter")}},
+                                     /*added_entry_ids=*/nullptr));
+  EXPECT_EQ(Classify(engine, "obama"), "new");
+  EXPECT_EQ(Classify(engine, "sasha"), "");
+}
+
+TEST(LookupEngineTest, KeepsEntriesAcrossManyUpdates) {
+  const UniLib unilib;
+  TestLookupEngine engine(&unilib);
+  std::vector<int> ids;
+  for (int i = 0; i < 100; ++i) {
+    const std::string name = "name" + std::to_string(i);
+    ids.push_back(engine.AddEntry({name}, ContactResult(name)));
+  }
+  for (int i = 0; i < 100; i += 2) {
+    EXPECT_TRUE(engine.RemoveEntry(ids[i]));
+  }
+  for (int i = 0; i < 100; ++i) {
+    const std::string name = "name" + std::to_string(i);
+    EXPECT_EQ(Classify(engine, name), i % 2 == 0 ? "" : name);
+  }
+  EXPECT_EQ(engine.CreateDatabase()->entries.size(), 50);
+}
+
+TEST(LookupEngineTest, ChunksTheLongestMatches) {
+  const UniLib unilib;
+  TestLookupEngine engine(&unilib);
+  engine.AddEntry({"obama"}, ContactResult("short"));
+  engine.AddEntry({"barack obama"}, ContactResult("long"));
+
+  const std::string text = "barack obama and obama";
+  const std::vector<Token> tokens = {{"barack", 0, 6},
+                                     {"obama", 7, 12},
+                                     {"and", 13, 16},
+                                     {"obama", 17, 22}};
+  std::vector<AnnotatedSpan> result;
+  ASSERT_TRUE(engine.ChunkInternal(UTF8ToUnicodeText(text), tokens,
+                                   /*max_num_tokens=*/3,
+                                   /*max_num_matches=*/2, &result));
+  ASSERT_EQ(result.size(), 2);
+  EXPECT_EQ(result[0].span, CodepointSpan(0, 12));
+  ASSERT_EQ(result[0].classification.size(), 1);
+  EXPECT_EQ(result[0].classification[0].contact_name, "long");
+  EXPECT_EQ(result[1].span, CodepointSpan(17, 22));
+  ASSERT_EQ(result[1].classification.size(), 1);
+  EXPECT_EQ(result[1].classification[0].contact_name, "short");
+}
+
+TEST(LookupEngineTest, ReadersSeeEachReplacementAtOnce) {
+  const UniLib unilib;
+  TestLookupEngine engine(&unilib);
+  int id = engine.AddEntry({"obama"}, ContactResult("0"));
+
+  // The writer replaces the only entry over and over, the readers must always
+  // see exactly one of the versions.
+  std::atomic<bool> done(false);
+  std::atomic<int> num_failures(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; ++i) {
+    readers.emplace_back([&engine, &done, &num_failures]() {
+      while (!done) {
+        if (Classify(engine, "obama").empty()) {
+          ++num_failures;
+        }
+      }
+    });
+  }
+  for (int i = 1; i <= 1000; ++i) {
+    std::vector<int> added_ids;
+    ASSERT_TRUE(engine.ReplaceEntries(
+        {id}, {{{"obama"}, ContactResult(std::to_string(i))}}, &added_ids));
+    id = added_ids[0];
+  }
+  done = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(num_failures, 0);
+  EXPECT_EQ(Classify(engine, "obama"), "1000");
+}
+
+TEST(LookupEngineTest, DatabaseKeepsAllTheFieldsOfTheResults) {
+  const UniLib unilib;
+  ClassificationResult result("ignored", /*arg_score=*/0.5,
+                              /*arg_priority_score=*/0.25);
+  result.datetime_parse_result = DatetimeParseResult(
+      /*arg_time_ms_utc=*/1234567, GRANULARITY_DAY,
+      {DatetimeComponent(DatetimeComponent::ComponentType::DAY_OF_MONTH,
+                         DatetimeComponent::RelativeQualifier::UNSPECIFIED,
+                         /*arg_value=*/12, /*arg_relative_count=*/0),
+       DatetimeComponent(DatetimeComponent::ComponentType::WEEK,
+                         DatetimeComponent::RelativeQualifier::NEXT,
+                         /*arg_value=*/0, /*arg_relative_count=*/1)});
+  result.serialized_knowledge_result = "knowledge";
+  result.contact_pointer.focus_contact_id = "focus id";
+  result.contact_pointer.device_id = "device id";
+  result.contact_pointer.device_contact_id = "device contact id";
+  result.contact_pointer.contact_name = "pointer name";
+  result.contact_pointer.contact_name_hash = "pointer hash";
+  result.contact_name = "Barack Obama";
+  result.contact_given_name = "Barack";
+  result.contact_family_name = "Obama";
+  result.contact_nickname = "Barry";
+  result.contact_email_address = "barack@example.com";
+  result.contact_phone_number = "+1 555 0100";
+  result.contact_id = "contact id";
+  result.app_name = "App";
+  result.app_package_name = "com.example.app";
+  result.numeric_value = -42;
+  result.numeric_double_value = -42.5;
+  result.duration_ms = 3600000;
+  result.serialized_entity_data = std::string("entity\0data", 11);
+
+  TestLookupEngine engine(&unilib);
+  engine.AddEntry({"barack obama"}, result);
+  const std::string buffer =
+      PackFlatbuffer<LookupDatabase>(engine.CreateDatabase().get());
+
+  TestLookupEngine loaded_engine(&unilib);
+  ASSERT_TRUE(loaded_engine.InitializeDatabase(buffer.data(), buffer.size()));
+  ClassificationResult loaded;
+  ASSERT_TRUE(loaded_engine.ClassifyTextInternal("barack obama", {0, 12},
+                                                 &loaded));
+
+  EXPECT_EQ(loaded.collection, "test");
+  EXPECT_EQ(loaded.score, result.score);
+  EXPECT_EQ(loaded.priority_score, result.priority_score);
+  EXPECT_EQ(loaded.datetime_parse_result.time_ms_utc,
+            result.datetime_parse_result.time_ms_utc);
+  EXPECT_EQ(loaded.datetime_parse_result.granularity,
+            result.datetime_parse_result.granularity);
+  EXPECT_TRUE(loaded.datetime_parse_result.datetime_components ==
+              result.datetime_parse_result.datetime_components);
+  EXPECT_EQ(loaded.serialized_knowledge_result,
+            result.serialized_knowledge_result);
+  EXPECT_EQ(loaded.contact_pointer.focus_contact_id,
+            result.contact_pointer.focus_contact_id);
+  EXPECT_EQ(loaded.contact_pointer.device_id, result.contact_pointer.device_id);
+  EXPECT_EQ(loaded.contact_pointer.device_contact_id,
+            result.contact_pointer.device_contact_id);
+  EXPECT_EQ(loaded.contact_pointer.contact_name,
+            result.contact_pointer.contact_name);
+  EXPECT_EQ(loaded.contact_pointer.contact_name_hash,
+            result.contact_pointer.contact_name_hash);
+  EXPECT_EQ(loaded.contact_name, result.contact_name);
+  EXPECT_EQ(loaded.contact_given_name, result.contact_given_name);
+  EXPECT_EQ(loaded.contact_family_name, result.contact_family_name);
+  EXPECT_EQ(loaded.contact_nickname, result.contact_nickname);
+  EXPECT_EQ(loaded.contact_email_address, result.contact_email_address);
+  EXPECT_EQ(loaded.contact_phone_number, result.contact_phone_number);
+  EXPECT_EQ(loaded.contact_id, result.contact_id);
+  EXPECT_EQ(loaded.app_name, result.app_name);
+  EXPECT_EQ(loaded.app_package_name, result.app_package_name);
+  EXPECT_EQ(loaded.numeric_value, result.numeric_value);
+  EXPECT_EQ(loaded.numeric_double_value, result.numeric_double_value);
+  EXPECT_EQ(loaded.duration_ms, result.duration_ms);
+  EXPECT_EQ(loaded.serialized_entity_data, result.serialized_entity_data);
+}
+
+TEST(LookupEngineTest, DatabaseKeepsDefaultFieldsUnset) {
+  const UniLib unilib;
+  const ClassificationResult result("ignored", /*arg_score=*/1.0);
+
+  TestLookupEngine engine(&unilib);
+  engine.AddEntry({"obama"}, result);
+  const std::string buffer =
+      PackFlatbuffer<LookupDatabase>(engine.CreateDatabase().get());
+
+  TestLookupEngine loaded_engine(&unilib);
+  ASSERT_TRUE(loaded_engine.InitializeDatabase(buffer.data(), buffer.size()));
+  ClassificationResult loaded;
+  ASSERT_TRUE(loaded_engine.ClassifyTextInternal("obama", {0, 5}, &loaded));
+
+  EXPECT_FALSE(loaded.datetime_parse_result.IsSet());
+  EXPECT_TRUE(loaded.datetime_parse_result.datetime_components.empty());
+  EXPECT_TRUE(loaded.contact_pointer == ContactPointer());
+  EXPECT_EQ(loaded.numeric_value, 0);
+  EXPECT_EQ(loaded.duration_ms, 0);
+  EXPECT_TRUE(loaded.serialized_knowledge_result.empty());
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
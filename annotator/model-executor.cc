@@ -15,30 +15,98 @@
 
 #include "annotator/model-executor.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "annotator/quantization.h"
 #include "utils/base/logging.h"
 
 namespace libtextclassifier3 {
 
+namespace {
+// Returns whether the tensor is allocated and has the given shape.
+bool HasAllocatedShape(const TfLiteTensor* tensor,
+                       const std::vector<int>& shape) {
+  if (tensor->data.raw == nullptr || tensor->dims == nullptr ||
+      tensor->dims->size != shape.size()) {
+    return false;
+  }
+  for (int i = 0; i < shape.size(); ++i) {
+    if (tensor->dims->data[i] != shape[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
 TensorView<float> ModelExecutor::ComputeLogits(
-    const TensorView<float>& features, tflite::Interpreter* interpreter) const {
+    const TensorView<float>& features, tflite::Interpreter* interpreter,
+    int padded_batch_size) const {
   if (!interpreter) {
     return TensorView<float>::Invalid();
   }
-  interpreter->ResizeInputTensor(kInputIndexFeatures, features.shape());
-  if (interpreter->AllocateTensors() != kTfLiteOk) {
-    TC3_VLOG(1) << "Allocation failed.";
+  if (features.dims() < 1) {
+    TC3_VLOG(1) << "Invalid features shape.";
     return TensorView<float>::Invalid();
   }
 
-  SetInput<float>(kInputIndexFeatures, features, interpreter);
+  const int batch_size = features.dim(0);
+  std::vector<int> input_shape = features.shape();
+  if (padded_batch_size > batch_size) {
+    input_shape[0] = padded_batch_size;
+  }
+
+  // Re-planning the tensor allocations is expensive, so only do it when the
+  // input shape differs from the one of the previous invocation of this
+  // interpreter. The shape is tracked by the interpreter itself, so this also
+  // works for interpreters that are pooled and shared between executions.
+  const TfLiteTensor* input_tensor =
+      interpreter->tensor(interpreter->inputs()[kInputIndexFeatures]);
+  if (!HasAllocatedShape(input_tensor, input_shape)) {
+    interpreter->ResizeInputTensor(interpreter->inputs()[kInputIndexFeatures],
+                                   input_shape);
+    if (interpreter->AllocateTensors() != kTfLiteOk) {
+      TC3_VLOG(1) << "Allocation failed.";
+      return TensorView<float>::Invalid();
+    }
+  }
+
+  float* input_data =
+      interpreter->typed_input_tensor<float>(kInputIndexFeatures);
+  features.copy_to(input_data, features.size());
+  if (input_shape[0] > batch_size) {
+    const int row_size = batch_size > 0 ? features.size() / batch_size : 0;
+    std::fill(input_data + features.size(),
+              input_data + input_shape[0] * row_size, 0.0f);
+  }
 
   if (interpreter->Invoke() != kTfLiteOk) {
     TC3_VLOG(1) << "Interpreter failed.";
     return TensorView<float>::Invalid();
   }
 
-  return OutputView<float>(kOutputIndexLogits, interpreter);
+  TensorView<float> logits = OutputView<float>(kOutputIndexLogits, interpreter);
+  if (input_shape[0] == batch_size || logits.dims() < 1 ||
+      logits.dim(0) != input_shape[0]) {
+    return logits;
+  }
+
+  // Drop the logits of the padding rows.
+  std::vector<int> logits_shape = logits.shape();
+  logits_shape[0] = batch_size;
+  return TensorView<float>(logits.data(), logits_shape);
+}
+
+int ModelExecutor::BucketedBatchSize(int batch_size, int max_batch_size) {
+  if (batch_size >= max_batch_size) {
+    return batch_size;
+  }
+  int bucket = 1;
+  while (bucket < batch_size) {
+    bucket *= 2;
+  }
+  return std::min(bucket, max_batch_size);
 }
 
 std::unique_ptr<TFLiteEmbeddingExecutor> TFLiteEmbeddingExecutor::FromBuffer(
@@ -148,34 +216,70 @@ int TFLiteEmbeddingExecutor::PruneBucketId(int bucket_id) const {
          __builtin_popcountll(pruning_mask_[bucket_id_major] & minor_mask);
 }
 
+bool EmbeddingExecutor::AddEmbeddings(const int* sparse_features,
+                                      const int* token_offsets,
+                                      const int* dest_offsets, int num_tokens,
+                                      float* dest, int dest_size) const {
+  for (int i = 0; i < num_tokens; ++i) {
+    if (!AddEmbedding(
+            TensorView<int>(sparse_features + token_offsets[i],
+                            {token_offsets[i + 1] - token_offsets[i]}),
+            dest + dest_offsets[i], dest_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool TFLiteEmbeddingExecutor::AddEmbedding(
     const TensorView<int>& sparse_features, float* dest, int dest_size) const {
+  const int token_offsets[] = {0, sparse_features.size()};
+  const int dest_offset = 0;
+  return AddEmbeddings(sparse_features.data(), token_offsets, &dest_offset,
+                       /*num_tokens=*/1, dest, dest_size);
+}
+
+bool TFLiteEmbeddingExecutor::AddEmbeddings(const int* sparse_features,
+                                            const int* token_offsets,
+                                            const int* dest_offsets,
+                                            int num_tokens, float* dest,
+                                            int dest_size) const {
   if (dest_size != output_embedding_size_) {
     TC3_LOG(ERROR) << "Mismatching dest_size and output_embedding_size: "
                    << dest_size << " " << output_embedding_size_;
     return false;
   }
-  const int num_sparse_features = sparse_features.size();
-  for (int i = 0; i < num_sparse_features; ++i) {
-    const int bucket_id = sparse_features.data()[i];
-    int full_num_buckets;
-    if (!pruning_mask_.empty()) {
-      full_num_buckets = full_num_buckets_;
-    } else {
-      full_num_buckets = num_buckets_;
-    }
-    if (bucket_id >= full_num_buckets) {
-      return false;
+
+  // Resolve the rows of all the features up front, so that the dequantization
+  // below runs over plain row indices.
+  static thread_local std::vector<int> bucket_ids;
+  const int num_sparse_features = token_offsets[num_tokens] - token_offsets[0];
+  bucket_ids.resize(num_sparse_features);
+  const int* features = sparse_features + token_offsets[0];
+  if (pruning_mask_.empty()) {
+    for (int i = 0; i < num_sparse_features; ++i) {
+      if (features[i] >= num_buckets_) {
+        return false;
+      }
+      bucket_ids[i] = features[i];
     }
-    int final_bucket_id;
-    if (!pruning_mask_.empty()) {
-      final_bucket_id = PruneBucketId(bucket_id);
-    } else {
-      final_bucket_id = bucket_id;
+  } else {
+    for (int i = 0; i < num_sparse_features; ++i) {
+      if (features[i] >= full_num_buckets_) {
+        return false;
+      }
+      bucket_ids[i] = PruneBucketId(features[i]);
     }
-    if (!DequantizeAdd(scales_->data.f, embeddings_->data.uint8,
-                       bytes_per_embedding_, num_sparse_features,
-                       quantization_bits_, final_bucket_id, dest, dest_size)) {
+  }
+
+  for (int i = 0; i < num_tokens; ++i) {
+    const int begin = token_offsets[i] - token_offsets[0];
+    const int end = token_offsets[i + 1] - token_offsets[0];
+    if (!DequantizeAddBuckets(scales_->data.f, embeddings_->data.uint8,
+                              bytes_per_embedding_, bucket_ids.data() + begin,
+                              /*num_bucket_ids=*/end - begin,
+                              quantization_bits_, dest + dest_offsets[i],
+                              dest_size)) {
       return false;
     }
   }
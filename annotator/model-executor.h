@@ -48,8 +48,22 @@ class ModelExecutor : public TfLiteModelExecutor {
     return std::unique_ptr<ModelExecutor>(new ModelExecutor(std::move(model)));
   }
 
+  // Runs the model on the [batch_size, features_size] 'features'.
+  // If 'padded_batch_size' is larger than the batch size, the batch is padded
+  // with zero rows up to that size before inference, and the logits of the
+  // padding rows are dropped from the result. Padding tail batches to a few
+  // fixed sizes (see BucketedBatchSize) lets the interpreter keep its tensor
+  // allocations instead of re-planning them for every new batch size.
+  // NOTE: The returned view points into the interpreter and is only valid until
+  // its next invocation.
   TensorView<float> ComputeLogits(const TensorView<float>& features,
-                                  tflite::Interpreter* interpreter) const;
+                                  tflite::Interpreter* interpreter,
+                                  int padded_batch_size = 0) const;
+
+  // Returns the batch size to pad a batch of 'batch_size' to: the next power
+  // of two, but not more than 'max_batch_size' (unless the batch itself is
+  // larger).
+  static int BucketedBatchSize(int batch_size, int max_batch_size);
 
  protected:
   explicit ModelExecutor(std::unique_ptr<const tflite::FlatBufferModel> model)
@@ -69,6 +83,14 @@ class EmbeddingExecutor {
   virtual bool AddEmbedding(const TensorView<int>& sparse_features, float* dest,
                             int dest_size) const = 0;
 
+  // Embeds the sparse features of 'num_tokens' tokens at once. The features of
+  // the i-th token are sparse_features[token_offsets[i]] up to
+  // sparse_features[token_offsets[i + 1]] (exclusive), and their embedding is
+  // added to the 'dest_size' values starting at dest + dest_offsets[i].
+  virtual bool AddEmbeddings(const int* sparse_features,
+                             const int* token_offsets, const int* dest_offsets,
+                             int num_tokens, float* dest, int dest_size) const;
+
   // Returns true when the model is ready to be used, false otherwise.
   virtual bool IsReady() const { return true; }
 };
@@ -85,6 +107,12 @@ class TFLiteEmbeddingExecutor : public EmbeddingExecutor {
   bool AddEmbedding(const TensorView<int>& sparse_features, float* dest,
                     int dest_size) const;
 
+  // Same as above for several tokens. Maps all the bucket ids through the
+  // pruning mask first and then dequantizes the embeddings token by token.
+  bool AddEmbeddings(const int* sparse_features, const int* token_offsets,
+                     const int* dest_offsets, int num_tokens, float* dest,
+                     int dest_size) const override;
+
   // Auxiliary function for computing prefixes used in implementation of
   // efficient mask indexing data structure.
   void ComputePrefixCounts();
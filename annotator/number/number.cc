@@ -73,7 +73,7 @@ bool NumberAnnotator::IsCJTterm(UnicodeText::const_iterator token_begin_it,
   return true;
 }
 
-bool NumberAnnotator::TokensAreValidStart(const std::vector<Token>& tokens,
+bool NumberAnnotator::TokensAreValidStart(const std::vector<TokenView>& tokens,
                                           const int start_index) const {
   if (start_index < 0 || tokens[start_index].is_whitespace) {
     return true;
@@ -82,7 +82,7 @@ bool NumberAnnotator::TokensAreValidStart(const std::vector<Token>& tokens,
 }
 
 bool NumberAnnotator::TokensAreValidNumberPrefix(
-    const std::vector<Token>& tokens, const int prefix_end_index) const {
+    const std::vector<TokenView>& tokens, const int prefix_end_index) const {
   if (TokensAreValidStart(tokens, prefix_end_index)) {
     return true;
   }
@@ -116,7 +116,7 @@ bool NumberAnnotator::TokensAreValidNumberPrefix(
   return false;
 }
 
-bool NumberAnnotator::TokensAreValidEnding(const std::vector<Token>& tokens,
+bool NumberAnnotator::TokensAreValidEnding(const std::vector<TokenView>& tokens,
                                            const int ending_index) const {
   if (ending_index >= tokens.size() || tokens[ending_index].is_whitespace) {
     return true;
@@ -140,7 +140,7 @@ bool NumberAnnotator::TokensAreValidEnding(const std::vector<Token>& tokens,
 }
 
 bool NumberAnnotator::TokensAreValidNumberSuffix(
-    const std::vector<Token>& tokens, const int suffix_start_index) const {
+    const std::vector<TokenView>& tokens, const int suffix_start_index) const {
   if (TokensAreValidEnding(tokens, suffix_start_index)) {
     return true;
   }
@@ -149,7 +149,7 @@ bool NumberAnnotator::TokensAreValidNumberSuffix(
       UTF8ToUnicodeText(tokens[suffix_start_index].value, /*do_copy=*/false)
           .begin();
 
-  if (percent_suffixes_.find(tokens[suffix_start_index].value) !=
+  if (percent_suffixes_.find(tokens[suffix_start_index].value.ToString()) !=
           percent_suffixes_.end() &&
       TokensAreValidEnding(tokens, suffix_start_index + 1)) {
     return true;
@@ -175,13 +175,14 @@ bool NumberAnnotator::TokensAreValidNumberSuffix(
 }
 
 int NumberAnnotator::FindPercentSuffixEndCodepoint(
-    const std::vector<Token>& tokens,
+    const std::vector<TokenView>& tokens,
     const int suffix_token_start_index) const {
   if (suffix_token_start_index >= tokens.size()) {
     return -1;
   }
 
-  if (percent_suffixes_.find(tokens[suffix_token_start_index].value) !=
+  if (percent_suffixes_.find(
+          tokens[suffix_token_start_index].value.ToString()) !=
           percent_suffixes_.end() &&
       TokensAreValidEnding(tokens, suffix_token_start_index + 1)) {
     return tokens[suffix_token_start_index].end;
@@ -220,9 +221,32 @@ bool NumberAnnotator::FindAll(const UnicodeText& context,
     return true;
   }
 
-  const std::vector<Token> tokens = tokenizer_.Tokenize(context);
+  // The token views point into 'context', which outlives them.
+  std::vector<TokenView> tokens;
+  if (!tokenizer_.TokenizeInto(context, &tokens)) {
+    return true;
+  }
+
+  // If the tokenizer discarded codepoints inside of a token, the view values
+  // still include them. Fall back to the owning tokens in that case, and view
+  // their values instead.
+  std::vector<Token> owning_tokens;
+  for (const TokenView& token : tokens) {
+    if (token.has_discarded_codepoints) {
+      owning_tokens = tokenizer_.Tokenize(context);
+      break;
+    }
+  }
+  if (!owning_tokens.empty()) {
+    tokens.clear();
+    tokens.reserve(owning_tokens.size());
+    for (const Token& token : owning_tokens) {
+      tokens.emplace_back(token.value, token.start, token.end,
+                          token.is_whitespace);
+    }
+  }
   for (int i = 0; i < tokens.size(); ++i) {
-    const Token token = tokens[i];
+    const TokenView& token = tokens[i];
     if (tokens[i].value.empty() ||
         !unilib_->IsDigit(
             *UTF8ToUnicodeText(tokens[i].value, /*do_copy=*/false).begin())) {
@@ -74,27 +74,27 @@ class NumberAnnotator {
 
   // Checks if the tokens from in the interval [start_index-2, start_index] are
   // valid characters that can preced a number context.
-  bool TokensAreValidStart(const std::vector<Token>& tokens,
+  bool TokensAreValidStart(const std::vector<TokenView>& tokens,
                            int start_index) const;
 
   // Checks if the tokens in the interval (..., prefix_end_index] are a valid
   // number prefix.
-  bool TokensAreValidNumberPrefix(const std::vector<Token>& tokens,
+  bool TokensAreValidNumberPrefix(const std::vector<TokenView>& tokens,
                                   int prefix_end_index) const;
 
   // Checks if the tokens from in the interval [ending_index, ending_index+2]
   // are valid characters that can follow a number context.
-  bool TokensAreValidEnding(const std::vector<Token>& tokens,
+  bool TokensAreValidEnding(const std::vector<TokenView>& tokens,
                             int ending_index) const;
 
   // Checks if the tokens in the interval [suffix_start_index, ...) are a valid
   // number suffix.
-  bool TokensAreValidNumberSuffix(const std::vector<Token>& tokens,
+  bool TokensAreValidNumberSuffix(const std::vector<TokenView>& tokens,
                                   int suffix_start_index) const;
 
   // Checks if the tokens in the interval [suffix_start_index, ...) are a valid
   // percent suffix. If false, returns -1, else returns the end codepoint.
-  int FindPercentSuffixEndCodepoint(const std::vector<Token>& tokens,
+  int FindPercentSuffixEndCodepoint(const std::vector<TokenView>& tokens,
                                     int suffix_token_start_index) const;
 
   // Checks if the given text represents a number (either int or double).
@@ -0,0 +1,629 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "annotator/pod_ner/pod-ner-impl.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "utils/base/logging.h"
+#include "utils/strings/utf8.h"
+#include "utils/tensor-view.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+using PodNerModel_::Label_::BoiseType;
+using PodNerModel_::Label_::BoiseType_BEGIN;
+using PodNerModel_::Label_::BoiseType_END;
+using PodNerModel_::Label_::BoiseType_INTERMEDIATE;
+using PodNerModel_::Label_::BoiseType_O;
+using PodNerModel_::Label_::BoiseType_SINGLE;
+using PodNerModel_::Label_::MentionType;
+using PodNerModel_::Label_::MentionType_NAM;
+using PodNerModel_::Label_::MentionType_NOM;
+using PodNerModel_::Label_::MentionType_UNDEFINED;
+
+// The collections of models that don't list them.
+const char *const kDefaultCollections[] = {"location", "organization",
+                                           "person"};
+
+// The inputs of the model, told apart by their names.
+enum InputKind {
+  INPUT_WORDPIECE_IDS,
+  INPUT_MASK,
+  INPUT_SEGMENT_IDS,
+  NUM_INPUT_KINDS,
+};
+
+bool InputNameContains(const TfLiteTensor *tensor, const char *infix) {
+  return tensor->name != nullptr && strstr(tensor->name, infix) != nullptr;
+}
+
+InputKind GetInputKind(const TfLiteTensor *tensor) {
+  if (InputNameContains(tensor, "mask")) {
+    return INPUT_MASK;
+  }
+  if (InputNameContains(tensor, "segment") ||
+      InputNameContains(tensor, "type_ids")) {
+    return INPUT_SEGMENT_IDS;
+  }
+  return INPUT_WORDPIECE_IDS;
+}
+
+bool HasShape(const TfLiteTensor *tensor, int dim0, int dim1) {
+  return tensor->dims != nullptr && tensor->dims->size == 2 &&
+         tensor->dims->data[0] == dim0 && tensor->dims->data[1] == dim1;
+}
+
+}  // namespace
+
+std::unique_ptr<PodNerAnnotator> PodNerAnnotator::Create(
+    const PodNerModel *model, const UniLib &unilib) {
+  if (model == nullptr || model->tflite_model() == nullptr ||
+      model->word_piece_vocab() == nullptr) {
+    TC3_LOG(ERROR) << "Incomplete POD NER model.";
+    return nullptr;
+  }
+  if (model->max_num_wordpieces() <= 2 ||
+      model->sliding_window_num_wordpieces_overlap() < 0 ||
+      model->sliding_window_num_wordpieces_overlap() >=
+          model->max_num_wordpieces() - 2) {
+    TC3_LOG(ERROR) << "Invalid POD NER window sizes.";
+    return nullptr;
+  }
+  if (model->max_batch_size() < 1) {
+    TC3_LOG(ERROR) << "Invalid POD NER batch size.";
+    return nullptr;
+  }
+
+  std::unique_ptr<PodNerAnnotator> annotator(
+      new PodNerAnnotator(model, unilib));
+  annotator->tokenizer_ = WordpieceTokenizer::Create(StringPiece(
+      reinterpret_cast<const char *>(model->word_piece_vocab()->data()),
+      model->word_piece_vocab()->size()));
+  if (annotator->tokenizer_ == nullptr) {
+    TC3_LOG(ERROR) << "Could not load the POD NER word piece vocabulary.";
+    return nullptr;
+  }
+  annotator->period_wordpiece_id_ = annotator->tokenizer_->PieceId(".");
+
+  annotator->executor_ = TfLiteModelExecutor::FromBuffer(model->tflite_model());
+  if (annotator->executor_ == nullptr) {
+    TC3_LOG(ERROR) << "Could not load the POD NER TFLite model.";
+    return nullptr;
+  }
+  annotator->interpreter_pool_.reset(new TfLiteInterpreterPool(
+      annotator->executor_.get(), kMaxPooledInterpreters));
+
+  if (model->collections() != nullptr && model->collections()->size() > 0) {
+    for (const PodNerModel_::Collection *collection : *model->collections()) {
+      if (collection->name() == nullptr) {
+        TC3_LOG(ERROR) << "POD NER collection without a name.";
+        return nullptr;
+      }
+      annotator->collections_.push_back(
+          {collection->name()->str(), collection->single_token_priority_score(),
+           collection->multi_token_priority_score()});
+    }
+  } else {
+    for (const char *name : kDefaultCollections) {
+      annotator->collections_.push_back(
+          {name, model->priority_score(), model->priority_score()});
+    }
+  }
+
+  if (model->labels() != nullptr && model->labels()->size() > 0) {
+    for (const PodNerModel_::Label *label : *model->labels()) {
+      if (label->boise_type() != BoiseType_O &&
+          (label->collection_id() < 0 ||
+           label->collection_id() >= annotator->collections_.size())) {
+        TC3_LOG(ERROR) << "POD NER label with an invalid collection.";
+        return nullptr;
+      }
+      annotator->labels_.push_back(
+          {label->boise_type(), label->mention_type(), label->collection_id()});
+    }
+  } else {
+    // O first, then for each collection the named and the nominal mentions,
+    // each with the BEGIN, INTERMEDIATE, END and SINGLE tags.
+    annotator->labels_.push_back({BoiseType_O, MentionType_UNDEFINED, -1});
+    for (int collection_id = 0; collection_id < annotator->collections_.size();
+         ++collection_id) {
+      for (const MentionType mention_type :
+           {MentionType_NAM, MentionType_NOM}) {
+        for (const BoiseType boise_type :
+             {BoiseType_BEGIN, BoiseType_INTERMEDIATE, BoiseType_END,
+              BoiseType_SINGLE}) {
+          annotator->labels_.push_back(
+              {boise_type, mention_type, collection_id});
+        }
+      }
+    }
+  }
+
+  // Reject a model with another signature here, rather than failing every
+  // annotation. The interpreter stays in the pool for the first annotation.
+  std::unique_ptr<tflite::Interpreter> interpreter =
+      annotator->interpreter_pool_->Acquire();
+  if (interpreter == nullptr) {
+    TC3_LOG(ERROR) << "Could not create the POD NER interpreter.";
+    return nullptr;
+  }
+  if (!annotator->HasExpectedSignature(*interpreter)) {
+    TC3_LOG(ERROR) << "Unexpected POD NER model signature.";
+    return nullptr;
+  }
+  annotator->interpreter_pool_->Release(std::move(interpreter));
+
+  return annotator;
+}
+
+bool PodNerAnnotator::HasExpectedSignature(
+    const tflite::Interpreter &interpreter) const {
+  const std::vector<int> &inputs = interpreter.inputs();
+  if (inputs.empty() || inputs.size() > NUM_INPUT_KINDS) {
+    return false;
+  }
+  bool has_input[NUM_INPUT_KINDS] = {};
+  for (const int input : inputs) {
+    const TfLiteTensor *tensor = interpreter.tensor(input);
+    if (tensor->name == nullptr || tensor->type != kTfLiteInt32 ||
+        tensor->dims == nullptr || tensor->dims->size != 2) {
+      return false;
+    }
+    const InputKind kind = GetInputKind(tensor);
+    if (has_input[kind]) {
+      return false;
+    }
+    has_input[kind] = true;
+  }
+  if (!has_input[INPUT_WORDPIECE_IDS]) {
+    return false;
+  }
+
+  const int logits_index = model_->logits_index_in_output_tensor();
+  if (logits_index < 0 || logits_index >= interpreter.outputs().size()) {
+    return false;
+  }
+  const TfLiteTensor *logits =
+      interpreter.tensor(interpreter.outputs()[logits_index]);
+  return logits->type == kTfLiteFloat32 && logits->dims != nullptr &&
+         logits->dims->size == 3 && logits->dims->data[2] == labels_.size();
+}
+
+bool PodNerAnnotator::TokenizeContext(const UnicodeText &context,
+                                      std::vector<Word> *words,
+                                      std::vector<int32> *wordpiece_ids) const {
+  words->clear();
+  wordpiece_ids->clear();
+
+  std::string word;
+  CodepointIndex word_start = 0;
+  auto add_word = [this, &word, &word_start, words,
+                   wordpiece_ids](CodepointIndex word_end) {
+    if (word.empty()) {
+      return;
+    }
+    const int first_wordpiece = wordpiece_ids->size();
+    tokenizer_->Tokenize(word, wordpiece_ids);
+    words->push_back(
+        {word_start, word_end, first_wordpiece,
+         static_cast<int>(wordpiece_ids->size())});
+    word.clear();
+  };
+  auto append_codepoint = [this, &word](char32 codepoint) {
+    if (model_->lowercase_input()) {
+      codepoint = unilib_.ToLower(codepoint);
+    }
+    char buffer[4];
+    word.append(buffer, ValidRuneToChar(codepoint, buffer));
+  };
+
+  CodepointIndex index = 0;
+  bool ends_with_punctuation = false;
+  for (const char32 codepoint : context) {
+    if (unilib_.IsWhitespace(codepoint)) {
+      add_word(index);
+    } else if (unilib_.IsPunctuation(codepoint)) {
+      // Each punctuation is a word of its own.
+      add_word(index);
+      word_start = index;
+      append_codepoint(codepoint);
+      add_word(index + 1);
+      ends_with_punctuation = true;
+    } else {
+      if (word.empty()) {
+        word_start = index;
+      }
+      append_codepoint(codepoint);
+      ends_with_punctuation = false;
+    }
+    ++index;
+  }
+  add_word(index);
+
+  if (words->empty() ||
+      static_cast<int>(words->size()) < model_->min_number_of_tokens() ||
+      static_cast<int>(wordpiece_ids->size()) <
+          model_->min_number_of_wordpieces()) {
+    return false;
+  }
+  const int num_unknown_wordpieces =
+      std::count(wordpiece_ids->begin(), wordpiece_ids->end(),
+                 tokenizer_->unk_id());
+  if (num_unknown_wordpieces >
+      model_->max_ratio_unknown_wordpieces() * wordpiece_ids->size()) {
+    return false;
+  }
+
+  if (model_->append_final_period() && !ends_with_punctuation &&
+      period_wordpiece_id_ >= 0) {
+    // An empty word at the end of the context, so that it never becomes part
+    // of an annotation.
+    words->push_back({index, index, static_cast<int>(wordpiece_ids->size()),
+                      static_cast<int>(wordpiece_ids->size()) + 1});
+    wordpiece_ids->push_back(period_wordpiece_id_);
+  }
+  return true;
+}
+
+std::vector<PodNerAnnotator::Window> PodNerAnnotator::SlidingWindows(
+    const std::vector<Word> &words) const {
+  const int max_window_wordpieces = model_->max_num_wordpieces() - 2;
+  const int overlap = model_->sliding_window_num_wordpieces_overlap();
+  std::vector<Window> windows;
+  int first_word = 0;
+  while (first_word < words.size()) {
+    int end_word = first_word + 1;
+    while (end_word < words.size() &&
+           words[end_word].end_wordpiece - words[first_word].first_wordpiece <=
+               max_window_wordpieces) {
+      ++end_word;
+    }
+    windows.push_back({first_word, end_word});
+    if (end_word == words.size()) {
+      break;
+    }
+
+    // Start the next window with the words in the last 'overlap' pieces of
+    // this one, but always advance by at least one word.
+    int next_first_word = end_word;
+    while (next_first_word - 1 > first_word &&
+           words[end_word].first_wordpiece -
+                   words[next_first_word - 1].first_wordpiece <=
+               overlap) {
+      --next_first_word;
+    }
+    first_word = next_first_word;
+  }
+  return windows;
+}
+
+PodNerAnnotator::Window PodNerAnnotator::WindowAroundSpan(
+    const std::vector<Word> &words, CodepointSpan span) const {
+  // The words overlapping the span, or the first one after it if there are
+  // none, e.g. for a click on whitespace.
+  int first_word = 0;
+  while (first_word + 1 < words.size() &&
+         words[first_word].end <= span.first) {
+    ++first_word;
+  }
+  int end_word = first_word + 1;
+  while (end_word < words.size() && words[end_word].start < span.second) {
+    ++end_word;
+  }
+
+  const int max_window_wordpieces = model_->max_num_wordpieces() - 2;
+  bool extended = true;
+  while (extended) {
+    extended = false;
+    if (end_word < words.size() &&
+        words[end_word].end_wordpiece - words[first_word].first_wordpiece <=
+            max_window_wordpieces) {
+      ++end_word;
+      extended = true;
+    }
+    if (first_word > 0 &&
+        words[end_word - 1].end_wordpiece -
+                words[first_word - 1].first_wordpiece <=
+            max_window_wordpieces) {
+      --first_word;
+      extended = true;
+    }
+  }
+  return {first_word, end_word};
+}
+
+bool PodNerAnnotator::LabelWords(const std::vector<Word> &words,
+                                 const std::vector<int32> &wordpiece_ids,
+                                 const std::vector<Window> &windows,
+                                 std::vector<int> *word_labels) const {
+  word_labels->assign(words.size(), -1);
+  if (windows.empty()) {
+    return true;
+  }
+
+  std::unique_ptr<tflite::Interpreter> interpreter =
+      interpreter_pool_->Acquire();
+  if (interpreter == nullptr) {
+    TC3_LOG(ERROR) << "Could not create the POD NER interpreter.";
+    return false;
+  }
+
+  // Labels the windows [first_window, end_window) in one batch. The signature
+  // of the model was checked in Create.
+  const int max_window_wordpieces = model_->max_num_wordpieces() - 2;
+  const int num_labels = labels_.size();
+  // The context of the piece from which each word took its label.
+  std::vector<int> word_context(words.size(), -1);
+  auto run_batch = [&](int first_window, int end_window) {
+    // Lay out the windows as the rows of the batch, [CLS] pieces [SEP] padded
+    // to the longest window. A single word with more pieces than fit is cut.
+    const int batch_size = end_window - first_window;
+    std::vector<int> window_num_wordpieces(batch_size);
+    int num_wordpieces = 0;
+    for (int i = 0; i < batch_size; ++i) {
+      const Window &window = windows[first_window + i];
+      window_num_wordpieces[i] =
+          std::min(max_window_wordpieces,
+                   words[window.end_word - 1].end_wordpiece -
+                       words[window.first_word].first_wordpiece);
+      num_wordpieces = std::max(num_wordpieces, window_num_wordpieces[i] + 2);
+    }
+    std::vector<int32> input_ids(batch_size * num_wordpieces,
+                                 tokenizer_->pad_id());
+    std::vector<int32> input_mask(batch_size * num_wordpieces, 0);
+    for (int i = 0; i < batch_size; ++i) {
+      int32 *row_ids = input_ids.data() + i * num_wordpieces;
+      const int32 *window_ids =
+          wordpiece_ids.data() +
+          words[windows[first_window + i].first_word].first_wordpiece;
+      row_ids[0] = tokenizer_->cls_id();
+      std::copy(window_ids, window_ids + window_num_wordpieces[i], row_ids + 1);
+      row_ids[window_num_wordpieces[i] + 1] = tokenizer_->sep_id();
+      std::fill_n(input_mask.begin() + i * num_wordpieces,
+                  window_num_wordpieces[i] + 2, 1);
+    }
+
+    const std::vector<int> &inputs = interpreter->inputs();
+
+    // Pooled interpreters keep their allocation, which only needs to be
+    // re-planned when the batch shape changes.
+    if (!HasShape(interpreter->tensor(inputs[0]), batch_size,
+                  num_wordpieces)) {
+      bool resized = true;
+      for (const int input : inputs) {
+        resized &= interpreter->ResizeInputTensor(
+                       input, {batch_size, num_wordpieces}) == kTfLiteOk;
+      }
+      if (!resized || interpreter->AllocateTensors() != kTfLiteOk) {
+        TC3_LOG(ERROR) << "POD NER tensor allocation failed.";
+        // The tensors are left in an unknown state, don't pool the
+        // interpreter.
+        interpreter.reset();
+        return false;
+      }
+    }
+
+    for (int i = 0; i < inputs.size(); ++i) {
+      int32 *data = interpreter->typed_input_tensor<int32>(i);
+      switch (GetInputKind(interpreter->tensor(inputs[i]))) {
+        case INPUT_MASK:
+          std::copy(input_mask.begin(), input_mask.end(), data);
+          break;
+        case INPUT_SEGMENT_IDS:
+          std::fill_n(data, input_mask.size(), 0);
+          break;
+        default:
+          std::copy(input_ids.begin(), input_ids.end(), data);
+          break;
+      }
+    }
+
+    if (interpreter->Invoke() != kTfLiteOk) {
+      TC3_LOG(ERROR) << "POD NER inference failed.";
+      return false;
+    }
+
+    const TensorView<float> logits = executor_->OutputView<float>(
+        model_->logits_index_in_output_tensor(), interpreter.get());
+    if (!logits.is_valid() || logits.dims() != 3 ||
+        logits.dim(0) != batch_size || logits.dim(1) != num_wordpieces ||
+        logits.dim(2) != num_labels) {
+      TC3_LOG(ERROR) << "Unexpected POD NER logits shape.";
+      return false;
+    }
+
+    // Each word takes the label of its first piece, from the window in which
+    // the piece has the most context on both sides.
+    for (int i = 0; i < batch_size; ++i) {
+      const Window &window = windows[first_window + i];
+      const int window_first_wordpiece =
+          words[window.first_word].first_wordpiece;
+      for (int word = window.first_word; word < window.end_word; ++word) {
+        const int position = words[word].first_wordpiece -
+                             window_first_wordpiece;
+        if (position >= window_num_wordpieces[i]) {
+          break;
+        }
+        const int context = std::min(
+            position, window_num_wordpieces[i] -
+                          (words[word].end_wordpiece - window_first_wordpiece));
+        if (context <= word_context[word]) {
+          continue;
+        }
+        word_context[word] = context;
+        const float *word_logits =
+            logits.data() + (i * num_wordpieces + position + 1) * num_labels;
+        (*word_labels)[word] =
+            std::max_element(word_logits, word_logits + num_labels) -
+            word_logits;
+      }
+    }
+    return true;
+  };
+
+  // Bounds the batch, and with it the memory of the interpreter, on long
+  // texts.
+  const int max_batch_size = model_->max_batch_size();
+  bool success = true;
+  for (int first_window = 0; success && first_window < windows.size();
+       first_window += max_batch_size) {
+    success = run_batch(first_window,
+                        std::min<int>(first_window + max_batch_size,
+                                      windows.size()));
+  }
+  if (interpreter != nullptr) {
+    interpreter_pool_->Release(std::move(interpreter));
+  }
+  return success;
+}
+
+void PodNerAnnotator::LabelsToAnnotatedSpans(
+    const std::vector<Word> &words, const std::vector<int> &word_labels,
+    std::vector<AnnotatedSpan> *results) const {
+  auto add_annotation = [this, &words, results](int first_word, int end_word,
+                                                int collection_id) {
+    // Leave out the appended final period.
+    while (end_word > first_word &&
+           words[end_word - 1].start == words[end_word - 1].end) {
+      --end_word;
+    }
+    if (end_word == first_word) {
+      return;
+    }
+    const Collection &collection = collections_[collection_id];
+    results->push_back(AnnotatedSpan(
+        {words[first_word].start, words[end_word - 1].end},
+        {ClassificationResult(collection.name, /*arg_score=*/1.0,
+                              end_word - first_word == 1
+                                  ? collection.single_token_priority_score
+                                  : collection.multi_token_priority_score)}));
+  };
+
+  // Only the named mentions are annotated, nominal ones ("the city") aren't
+  // entities.
+  int entity_first_word = -1;
+  int entity_collection_id = -1;
+  for (int word = 0; word < words.size(); ++word) {
+    if (word_labels[word] < 0 ||
+        labels_[word_labels[word]].mention_type != MentionType_NAM) {
+      entity_first_word = -1;
+      continue;
+    }
+    const Label &label = labels_[word_labels[word]];
+    switch (label.boise_type) {
+      case BoiseType_SINGLE:
+        add_annotation(word, word + 1, label.collection_id);
+        entity_first_word = -1;
+        break;
+      case BoiseType_BEGIN:
+        entity_first_word = word;
+        entity_collection_id = label.collection_id;
+        break;
+      case BoiseType_INTERMEDIATE:
+        if (label.collection_id != entity_collection_id) {
+          entity_first_word = -1;
+        }
+        break;
+      case BoiseType_END:
+        if (entity_first_word >= 0 &&
+            label.collection_id == entity_collection_id) {
+          add_annotation(entity_first_word, word + 1, label.collection_id);
+        }
+        entity_first_word = -1;
+        break;
+      default:
+        entity_first_word = -1;
+        break;
+    }
+  }
+}
+
+bool PodNerAnnotator::Annotate(const UnicodeText &context,
+                               std::vector<AnnotatedSpan> *results) const {
+  std::vector<Word> words;
+  std::vector<int32> wordpiece_ids;
+  if (!TokenizeContext(context, &words, &wordpiece_ids)) {
+    return true;
+  }
+  std::vector<int> word_labels;
+  if (!LabelWords(words, wordpiece_ids, SlidingWindows(words), &word_labels)) {
+    return false;
+  }
+  LabelsToAnnotatedSpans(words, word_labels, results);
+  return true;
+}
+
+bool PodNerAnnotator::AnnotateAroundSpan(
+    const UnicodeText &context, CodepointSpan span,
+    std::vector<AnnotatedSpan> *results) const {
+  std::vector<Word> words;
+  std::vector<int32> wordpiece_ids;
+  if (!TokenizeContext(context, &words, &wordpiece_ids)) {
+    return true;
+  }
+  std::vector<int> word_labels;
+  if (!LabelWords(words, wordpiece_ids, {WindowAroundSpan(words, span)},
+                  &word_labels)) {
+    return false;
+  }
+  LabelsToAnnotatedSpans(words, word_labels, results);
+  return true;
+}
+
+AnnotatedSpan PodNerAnnotator::SuggestSelection(const UnicodeText &context,
+                                                CodepointSpan click) const {
+  std::vector<AnnotatedSpan> annotations;
+  if (!AnnotateAroundSpan(context, click, &annotations)) {
+    return {};
+  }
+  for (const AnnotatedSpan &annotation : annotations) {
+    if (annotation.span.first <= click.first &&
+        annotation.span.second >= click.second) {
+      return annotation;
+    }
+  }
+  return {};
+}
+
+bool PodNerAnnotator::ClassifyText(const UnicodeText &context,
+                                   CodepointSpan click,
+                                   ClassificationResult *result) const {
+  std::vector<AnnotatedSpan> annotations;
+  if (!AnnotateAroundSpan(context, click, &annotations)) {
+    return false;
+  }
+  for (const AnnotatedSpan &annotation : annotations) {
+    if (annotation.span == click) {
+      *result = annotation.classification[0];
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string> PodNerAnnotator::GetSupportedCollections() const {
+  std::vector<std::string> result;
+  for (const Collection &collection : collections_) {
+    result.push_back(collection.name);
+  }
+  return result;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,152 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_POD_NER_IMPL_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_POD_NER_IMPL_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotator/model_generated.h"
+#include "annotator/pod_ner/wordpiece-tokenizer.h"
+#include "annotator/types.h"
+#include "utils/tflite-model-executor.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+
+// Named entity recognition with a BERT-like TFLite model, that labels the
+// words of the text with BOISE tags.
+//
+// The model takes the word piece ids of a batch of windows of the text
+// ([CLS] pieces [SEP], padded), as int32 [batch, num_wordpieces] tensors.
+// Inputs with "mask" in their name get the input mask (1 for the pieces, 0
+// for the padding), the ones with "segment" or "type_ids" get zeros and all
+// the others get the word piece ids. The output
+// at logits_index_in_output_tensor holds the label logits, as a float
+// [batch, num_wordpieces, num_labels] tensor. A word gets the label of its
+// first word piece.
+//
+// Create rejects models with another signature: one to three int32 inputs of
+// rank 2, at most one of each kind, and a float logits output of rank 3 with
+// one entry per label.
+//
+// Texts longer than max_num_wordpieces are split into overlapping windows,
+// which are labeled in batched invocations of at most max_batch_size windows.
+// Each word is labeled from the window in which it has the most context.
+// NOTE: Thread-safe.
+class PodNerAnnotator {
+ public:
+  static std::unique_ptr<PodNerAnnotator> Create(const PodNerModel *model,
+                                                 const UniLib &unilib);
+
+  // Annotates the named entities of the whole context.
+  bool Annotate(const UnicodeText &context,
+                std::vector<AnnotatedSpan> *results) const;
+
+  // Returns the named entity containing the click, labeling only the window
+  // around it, or an invalid span if there is none.
+  AnnotatedSpan SuggestSelection(const UnicodeText &context,
+                                 CodepointSpan click) const;
+
+  // Classifies the span if it is exactly a named entity.
+  bool ClassifyText(const UnicodeText &context, CodepointSpan click,
+                    ClassificationResult *result) const;
+
+  std::vector<std::string> GetSupportedCollections() const;
+
+ private:
+  struct Label {
+    PodNerModel_::Label_::BoiseType boise_type;
+    PodNerModel_::Label_::MentionType mention_type;
+    int collection_id;
+  };
+
+  struct Collection {
+    std::string name;
+    float single_token_priority_score;
+    float multi_token_priority_score;
+  };
+
+  // A word of the context and its word pieces.
+  struct Word {
+    CodepointIndex start;
+    CodepointIndex end;
+    int first_wordpiece;
+    int end_wordpiece;
+  };
+
+  // A window of words, labeled by one batch element of the model.
+  struct Window {
+    int first_word;
+    int end_word;
+  };
+
+  static constexpr int kMaxPooledInterpreters = 4;
+
+  PodNerAnnotator(const PodNerModel *model, const UniLib &unilib)
+      : model_(model), unilib_(unilib) {}
+
+  // Returns whether the inputs and the logits output of the interpreter are
+  // the ones described above.
+  bool HasExpectedSignature(const tflite::Interpreter &interpreter) const;
+
+  // Splits the context into words (at whitespace and punctuation) and the
+  // words into word pieces. Returns false if the text shouldn't be annotated
+  // because of the limits of the model.
+  bool TokenizeContext(const UnicodeText &context, std::vector<Word> *words,
+                       std::vector<int32> *wordpiece_ids) const;
+
+  // Returns the windows covering all the words, each one with at most
+  // max_num_wordpieces - 2 pieces, overlapping by about
+  // sliding_window_num_wordpieces_overlap pieces.
+  std::vector<Window> SlidingWindows(const std::vector<Word> &words) const;
+
+  // Returns the window of max_num_wordpieces - 2 pieces centered around the
+  // words overlapping the span.
+  Window WindowAroundSpan(const std::vector<Word> &words,
+                          CodepointSpan span) const;
+
+  // Runs the model on the windows, in batches of at most max_batch_size, and
+  // sets the label of each word covered by them (-1 for the others).
+  bool LabelWords(const std::vector<Word> &words,
+                  const std::vector<int32> &wordpiece_ids,
+                  const std::vector<Window> &windows,
+                  std::vector<int> *word_labels) const;
+
+  // Converts the BOISE labels of the words to annotated spans.
+  void LabelsToAnnotatedSpans(const std::vector<Word> &words,
+                              const std::vector<int> &word_labels,
+                              std::vector<AnnotatedSpan> *results) const;
+
+  // Annotates the named entities in the window around the span.
+  bool AnnotateAroundSpan(const UnicodeText &context, CodepointSpan span,
+                          std::vector<AnnotatedSpan> *results) const;
+
+  const PodNerModel *const model_;
+  const UniLib &unilib_;
+  std::unique_ptr<WordpieceTokenizer> tokenizer_;
+  std::unique_ptr<TfLiteModelExecutor> executor_;
+  std::unique_ptr<TfLiteInterpreterPool> interpreter_pool_;
+  std::vector<Label> labels_;
+  std::vector<Collection> collections_;
+  int32 period_wordpiece_id_ = -1;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_POD_NER_IMPL_H_
@@ -16,6 +16,12 @@
 #ifndef LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_POD_NER_H_
 #define LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_POD_NER_H_
 
+#if defined TC3_POD_NER_ANNOTATOR_IMPL
+#include "annotator/pod_ner/pod-ner-impl.h"
+#elif defined TC3_POD_NER_ANNOTATOR_DUMMY
 #include "annotator/pod_ner/pod-ner-dummy.h"
+#else
+#error No POD NER annotator implementation specified.
+#endif  // TC3_POD_NER_ANNOTATOR_IMPL
 
 #endif  // LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_POD_NER_H_
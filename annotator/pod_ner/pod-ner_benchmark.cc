@@ -0,0 +1,125 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotator/annotator.h"
+#include "annotator/model_generated.h"
+#include "annotator/pod_ner/pod-ner.h"
+#include "annotator/pod_ner/wordpiece-tokenizer.h"
+#include "annotator/types.h"
+#include "utils/base/integral_types.h"
+#include "utils/benchmark-data.h"
+#include "utils/memory/mmap.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr char kModelPathVariable[] = "TC3_BENCHMARK_ANNOTATOR_MODEL";
+
+// Returns a BERT-like vocabulary: the special pieces, all the single
+// characters and 'num_pieces' synthetic word start and continuation pieces.
+std::string SyntheticVocab(int num_pieces) {
+  std::string vocab = "[PAD]\n[UNK]\n[CLS]\n[SEP]\n";
+  for (char c = '!'; c <= '~'; ++c) {
+    vocab += c;
+    vocab += "\n##";
+    vocab += c;
+    vocab += "\n";
+  }
+  for (const std::string& piece : benchmark_data::SyntheticStrings(
+           num_pieces, /*min_length=*/2, /*max_length=*/6)) {
+    vocab += piece + "\n##" + piece + "\n";
+  }
+  return vocab;
+}
+
+// Returns the whitespace separated words of the text.
+std::vector<std::string> Words(const std::string& text) {
+  std::vector<std::string> words;
+  std::string word;
+  for (const char c : text + " ") {
+    if (c == ' ') {
+      if (!word.empty()) {
+        words.push_back(word);
+      }
+      word.clear();
+    } else {
+      word += c;
+    }
+  }
+  return words;
+}
+
+void BM_WordpieceTokenize(benchmark::State& state) {
+  const std::string vocab = SyntheticVocab(/*num_pieces=*/15000);
+  const std::unique_ptr<WordpieceTokenizer> tokenizer =
+      WordpieceTokenizer::Create(vocab);
+  const std::vector<std::string> words =
+      Words(benchmark_data::SyntheticText(state.range(0)));
+
+  std::vector<int32> wordpiece_ids;
+  for (auto _ : state) {
+    wordpiece_ids.clear();
+    for (const std::string& word : words) {
+      tokenizer->Tokenize(word, &wordpiece_ids);
+    }
+    benchmark::DoNotOptimize(wordpiece_ids.data());
+  }
+  state.SetItemsProcessed(state.iterations() * words.size());
+}
+BENCHMARK(BM_WordpieceTokenize)->ArgName("num_words")->Arg(1000);
+
+// Annotates texts that need many sliding windows, all labeled in one batch.
+void BM_PodNerAnnotate(benchmark::State& state) {
+  const ScopedMmap mmap(benchmark_data::GetEnv(kModelPathVariable));
+  if (!mmap.handle().ok()) {
+    state.SkipWithError("Set TC3_BENCHMARK_ANNOTATOR_MODEL to a model.");
+    return;
+  }
+  const Model* model =
+      ViewModel(mmap.handle().start(), mmap.handle().num_bytes());
+  if (model == nullptr || model->pod_ner_model() == nullptr) {
+    state.SkipWithError("The model has no POD NER model.");
+    return;
+  }
+
+  const UniLib unilib;
+  const std::unique_ptr<PodNerAnnotator> annotator =
+      PodNerAnnotator::Create(model->pod_ner_model(), unilib);
+  if (annotator == nullptr) {
+    state.SkipWithError("Could not create the POD NER annotator.");
+    return;
+  }
+
+  const std::string text = benchmark_data::SyntheticText(state.range(0));
+  const UnicodeText context = UTF8ToUnicodeText(text, /*do_copy=*/false);
+  std::vector<AnnotatedSpan> results;
+  for (auto _ : state) {
+    results.clear();
+    annotator->Annotate(context, &results);
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_PodNerAnnotate)->ArgName("num_words")->Arg(100)->Arg(1000);
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -0,0 +1,167 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "annotator/pod_ner/wordpiece-tokenizer.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "utils/base/logging.h"
+#include "utils/strings/utf8.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr char kContinuationPrefix[] = "##";
+constexpr int kContinuationPrefixLength = 2;
+
+bool StartsWithContinuationPrefix(StringPiece piece) {
+  return piece.size() > kContinuationPrefixLength &&
+         piece.StartsWith(kContinuationPrefix);
+}
+
+StringPiece WithoutContinuationPrefix(StringPiece piece) {
+  return StringPiece(piece.data() + kContinuationPrefixLength,
+                     piece.size() - kContinuationPrefixLength);
+}
+
+// Byte order, as expected by the SortedStringsTable.
+bool PieceLess(StringPiece a, StringPiece b) {
+  const int result = memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+  return result != 0 ? result < 0 : a.size() < b.size();
+}
+
+}  // namespace
+
+std::unique_ptr<WordpieceTokenizer> WordpieceTokenizer::Create(
+    StringPiece vocab) {
+  std::vector<std::pair<StringPiece, int32>> word_start_pieces;
+  std::vector<std::pair<StringPiece, int32>> word_continuation_pieces;
+  int32 id = 0;
+  for (int start = 0; start < vocab.size(); ++id) {
+    int end = start;
+    while (end < vocab.size() && vocab[end] != '\n') {
+      ++end;
+    }
+    StringPiece piece(vocab.data() + start, end - start);
+    start = end + 1;
+    if (piece.EndsWith("\r")) {
+      piece.RemoveSuffix(1);
+    }
+    if (piece.empty() || piece.find('\0') != StringPiece::npos) {
+      continue;
+    }
+    if (StartsWithContinuationPrefix(piece)) {
+      word_continuation_pieces.push_back(
+          {WithoutContinuationPrefix(piece), id});
+    } else {
+      word_start_pieces.push_back({piece, id});
+    }
+  }
+
+  std::unique_ptr<WordpieceTokenizer> tokenizer(new WordpieceTokenizer());
+  tokenizer->word_start_pieces_.Build(std::move(word_start_pieces));
+  tokenizer->word_continuation_pieces_.Build(
+      std::move(word_continuation_pieces));
+  tokenizer->cls_id_ = tokenizer->PieceId("[CLS]");
+  tokenizer->sep_id_ = tokenizer->PieceId("[SEP]");
+  tokenizer->unk_id_ = tokenizer->PieceId("[UNK]");
+  const int32 pad_id = tokenizer->PieceId("[PAD]");
+  if (pad_id >= 0) {
+    tokenizer->pad_id_ = pad_id;
+  }
+  if (tokenizer->cls_id_ < 0 || tokenizer->sep_id_ < 0 ||
+      tokenizer->unk_id_ < 0) {
+    TC3_LOG(ERROR) << "The word piece vocabulary lacks special pieces.";
+    return nullptr;
+  }
+  return tokenizer;
+}
+
+void WordpieceTokenizer::PieceTable::Build(
+    std::vector<std::pair<StringPiece, int32>> pieces_with_ids) {
+  // Keep the first id of duplicated pieces.
+  std::stable_sort(pieces_with_ids.begin(), pieces_with_ids.end(),
+                   [](const std::pair<StringPiece, int32>& a,
+                      const std::pair<StringPiece, int32>& b) {
+                     return PieceLess(a.first, b.first);
+                   });
+  for (int i = 0; i < pieces_with_ids.size(); ++i) {
+    if (i > 0 &&
+        pieces_with_ids[i].first.Equals(pieces_with_ids[i - 1].first)) {
+      continue;
+    }
+    offsets.push_back(pieces.size());
+    pieces.append(pieces_with_ids[i].first.data(),
+                  pieces_with_ids[i].first.size());
+    pieces.push_back('\0');
+    ids.push_back(pieces_with_ids[i].second);
+  }
+  table.reset(new SortedStringsTable(offsets.size(), offsets.data(),
+                                     StringPiece(pieces)));
+}
+
+int32 WordpieceTokenizer::PieceTable::Find(StringPiece piece) const {
+  int index;
+  if (!table->Find(piece, &index)) {
+    return -1;
+  }
+  return ids[index];
+}
+
+int32 WordpieceTokenizer::PieceId(StringPiece piece) const {
+  if (StartsWithContinuationPrefix(piece)) {
+    return word_continuation_pieces_.Find(WithoutContinuationPrefix(piece));
+  }
+  return word_start_pieces_.Find(piece);
+}
+
+int WordpieceTokenizer::Tokenize(StringPiece word,
+                                 std::vector<int32>* wordpiece_ids) const {
+  int num_codepoints = 0;
+  for (int i = 0; i < word.size(); ++i) {
+    if (!IsTrailByte(word[i])) {
+      ++num_codepoints;
+    }
+  }
+  const int num_pieces_before = wordpiece_ids->size();
+  if (num_codepoints > kMaxCodepointsPerWord) {
+    wordpiece_ids->push_back(unk_id_);
+    return 1;
+  }
+
+  for (int start = 0; start < word.size();) {
+    const PieceTable& pieces =
+        start == 0 ? word_start_pieces_ : word_continuation_pieces_;
+    StringSet::Match match;
+    pieces.table->GatherPrefixMatches(
+        StringPiece(word.data() + start, word.size() - start),
+        [&match](const StringSet::Match& prefix_match) {
+          match = prefix_match;
+        });
+    if (match.id < 0 || match.match_length <= 0) {
+      wordpiece_ids->resize(num_pieces_before);
+      wordpiece_ids->push_back(unk_id_);
+      return 1;
+    }
+    wordpiece_ids->push_back(pieces.ids[match.id]);
+    start += match.match_length;
+  }
+  return wordpiece_ids->size() - num_pieces_before;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,85 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_WORDPIECE_TOKENIZER_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_WORDPIECE_TOKENIZER_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/container/sorted-strings-table.h"
+#include "utils/strings/stringpiece.h"
+
+namespace libtextclassifier3 {
+
+// Splits words into the word pieces of a BERT vocabulary, taking the longest
+// piece of the vocabulary at each position of the word. The pieces are kept
+// in two sorted string tables, one for the pieces starting a word and one for
+// the pieces continuing it, so that each step is a single longest prefix match.
+class WordpieceTokenizer {
+ public:
+  // 'vocab' is the BERT vocabulary, one word piece per line, the id of a piece
+  // is its line number. Pieces continuing a word start with "##". Returns
+  // nullptr if the vocabulary lacks the [CLS], [SEP] or [UNK] pieces.
+  static std::unique_ptr<WordpieceTokenizer> Create(StringPiece vocab);
+
+  // Appends the ids of the word pieces of 'word' to 'wordpiece_ids'. A word
+  // that can't be split into pieces of the vocabulary, or that is too long,
+  // becomes a single [UNK]. Returns the number of pieces appended.
+  int Tokenize(StringPiece word, std::vector<int32>* wordpiece_ids) const;
+
+  // Returns the id of the word piece, or -1 if it isn't in the vocabulary.
+  int32 PieceId(StringPiece piece) const;
+
+  int32 cls_id() const { return cls_id_; }
+  int32 sep_id() const { return sep_id_; }
+  int32 unk_id() const { return unk_id_; }
+
+  // The padding piece, 0 if the vocabulary has no [PAD].
+  int32 pad_id() const { return pad_id_; }
+
+ private:
+  // Words longer than this (in codepoints) are not split, as in BERT.
+  static constexpr int kMaxCodepointsPerWord = 100;
+
+  struct PieceTable {
+    // The pieces, concatenated in sorted order and zero byte separated.
+    std::string pieces;
+    std::vector<uint32> offsets;
+
+    // The vocabulary ids of the pieces, in the same order.
+    std::vector<int32> ids;
+    std::unique_ptr<SortedStringsTable> table;
+
+    void Build(std::vector<std::pair<StringPiece, int32>> pieces_with_ids);
+    int32 Find(StringPiece piece) const;
+  };
+
+  WordpieceTokenizer() {}
+
+  PieceTable word_start_pieces_;
+  PieceTable word_continuation_pieces_;
+  int32 cls_id_ = -1;
+  int32 sep_id_ = -1;
+  int32 unk_id_ = -1;
+  int32 pad_id_ = 0;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_POD_NER_WORDPIECE_TOKENIZER_H_
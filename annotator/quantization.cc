@@ -15,8 +15,19 @@
 
 #include "annotator/quantization.h"
 
+#include <algorithm>
+
 #include "utils/base/logging.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TC3_QUANTIZATION_NEON
+#endif
+
 namespace libtextclassifier3 {
 namespace {
 float DequantizeValue(int num_sparse_features, int quantization_bias,
@@ -24,15 +35,96 @@ float DequantizeValue(int num_sparse_features, int quantization_bias,
   return 1.0 / num_sparse_features * (value - quantization_bias) * multiplier;
 }
 
+// Adds (values[i] - bias) * multiplier to dest[i] for all i < size.
+void AddDequantizedValues(const uint8* values, int size, float bias,
+                          float multiplier, float* dest) {
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256 bias_v = _mm256_set1_ps(bias);
+  const __m256 multiplier_v = _mm256_set1_ps(multiplier);
+  for (; i + 8 <= size; i += 8) {
+    const __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values + i))));
+    _mm256_storeu_ps(
+        dest + i,
+        _mm256_add_ps(_mm256_loadu_ps(dest + i),
+                      _mm256_mul_ps(_mm256_sub_ps(value, bias_v),
+                                    multiplier_v)));
+  }
+#elif defined(__SSE2__)
+  const __m128 bias_v = _mm_set1_ps(bias);
+  const __m128 multiplier_v = _mm_set1_ps(multiplier);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= size; i += 8) {
+    const __m128i words = _mm_unpacklo_epi8(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(values + i)), zero);
+    const __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+    const __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero));
+    _mm_storeu_ps(dest + i,
+                  _mm_add_ps(_mm_loadu_ps(dest + i),
+                             _mm_mul_ps(_mm_sub_ps(low, bias_v),
+                                        multiplier_v)));
+    _mm_storeu_ps(dest + i + 4,
+                  _mm_add_ps(_mm_loadu_ps(dest + i + 4),
+                             _mm_mul_ps(_mm_sub_ps(high, bias_v),
+                                        multiplier_v)));
+  }
+#elif defined(TC3_QUANTIZATION_NEON)
+  const float32x4_t bias_v = vdupq_n_f32(bias);
+  const float32x4_t multiplier_v = vdupq_n_f32(multiplier);
+  for (; i + 8 <= size; i += 8) {
+    const uint16x8_t words = vmovl_u8(vld1_u8(values + i));
+    const float32x4_t low = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+    const float32x4_t high = vcvtq_f32_u32(vmovl_u16(vget_high_u16(words)));
+    vst1q_f32(dest + i, vmlaq_f32(vld1q_f32(dest + i),
+                                  vsubq_f32(low, bias_v), multiplier_v));
+    vst1q_f32(dest + i + 4, vmlaq_f32(vld1q_f32(dest + i + 4),
+                                      vsubq_f32(high, bias_v), multiplier_v));
+  }
+#endif
+  for (; i < size; ++i) {
+    dest[i] += (values[i] - bias) * multiplier;
+  }
+}
+
 void DequantizeAdd8bit(const float* scales, const uint8* embeddings,
                        int bytes_per_embedding, const int num_sparse_features,
                        const int bucket_id, float* dest, int dest_size) {
   static const int kQuantizationBias8bit = 128;
-  const float multiplier = scales[bucket_id];
-  for (int k = 0; k < dest_size; ++k) {
-    dest[k] +=
-        DequantizeValue(num_sparse_features, kQuantizationBias8bit, multiplier,
-                        embeddings[bucket_id * bytes_per_embedding + k]);
+  AddDequantizedValues(embeddings + bucket_id * bytes_per_embedding, dest_size,
+                       kQuantizationBias8bit,
+                       scales[bucket_id] / num_sparse_features, dest);
+}
+
+// Same as DequantizeAddNBit, for the bit widths that evenly divide a byte (1,
+// 2 and 4). The values are unpacked into bytes one chunk at a time and then
+// added like the 8-bit ones.
+template <int kQuantizationBits>
+void DequantizeAddPackedBits(const float* scales, const uint8* embeddings,
+                             int bytes_per_embedding, int num_sparse_features,
+                             int bucket_id, float* dest, int dest_size) {
+  static constexpr int kValuesPerByte = 8 / kQuantizationBits;
+  static constexpr int kValueMask = (1 << kQuantizationBits) - 1;
+  static constexpr int kChunkSize = 64;
+  static_assert(kChunkSize % kValuesPerByte == 0, "Chunk must be whole bytes.");
+
+  const uint8* row = embeddings + bucket_id * bytes_per_embedding;
+  const float bias = 1 << (kQuantizationBits - 1);
+  const float multiplier = scales[bucket_id] / num_sparse_features;
+  uint8 values[kChunkSize];
+  for (int chunk_start = 0; chunk_start < dest_size;
+       chunk_start += kChunkSize) {
+    const int chunk_size = std::min(kChunkSize, dest_size - chunk_start);
+    const uint8* bytes = row + chunk_start / kValuesPerByte;
+    const int num_bytes = (chunk_size + kValuesPerByte - 1) / kValuesPerByte;
+    for (int i = 0; i < num_bytes; ++i) {
+      for (int j = 0; j < kValuesPerByte; ++j) {
+        values[i * kValuesPerByte + j] =
+            (bytes[i] >> (j * kQuantizationBits)) & kValueMask;
+      }
+    }
+    AddDequantizedValues(values, chunk_size, bias, multiplier,
+                         dest + chunk_start);
   }
 }
 
@@ -73,19 +165,54 @@ bool DequantizeAdd(const float* scales, const uint8* embeddings,
                    int bytes_per_embedding, int num_sparse_features,
                    int quantization_bits, int bucket_id, float* dest,
                    int dest_size) {
-  if (quantization_bits == 8) {
-    DequantizeAdd8bit(scales, embeddings, bytes_per_embedding,
-                      num_sparse_features, bucket_id, dest, dest_size);
-  } else if (quantization_bits != 8) {
-    DequantizeAddNBit(scales, embeddings, bytes_per_embedding,
-                      num_sparse_features, quantization_bits, bucket_id, dest,
-                      dest_size);
-  } else {
-    TC3_LOG(ERROR) << "Unsupported quantization_bits: " << quantization_bits;
-    return false;
+  switch (quantization_bits) {
+    case 8:
+      DequantizeAdd8bit(scales, embeddings, bytes_per_embedding,
+                        num_sparse_features, bucket_id, dest, dest_size);
+      break;
+    case 4:
+      DequantizeAddPackedBits<4>(scales, embeddings, bytes_per_embedding,
+                                 num_sparse_features, bucket_id, dest,
+                                 dest_size);
+      break;
+    case 2:
+      DequantizeAddPackedBits<2>(scales, embeddings, bytes_per_embedding,
+                                 num_sparse_features, bucket_id, dest,
+                                 dest_size);
+      break;
+    case 1:
+      DequantizeAddPackedBits<1>(scales, embeddings, bytes_per_embedding,
+                                 num_sparse_features, bucket_id, dest,
+                                 dest_size);
+      break;
+    case 3:
+    case 5:
+    case 6:
+    case 7:
+      DequantizeAddNBit(scales, embeddings, bytes_per_embedding,
+                        num_sparse_features, quantization_bits, bucket_id,
+                        dest, dest_size);
+      break;
+    default:
+      TC3_LOG(ERROR) << "Unsupported quantization_bits: " << quantization_bits;
+      return false;
   }
 
   return true;
 }
 
+bool DequantizeAddBuckets(const float* scales, const uint8* embeddings,
+                          int bytes_per_embedding, const int* bucket_ids,
+                          int num_bucket_ids, int quantization_bits,
+                          float* dest, int dest_size) {
+  for (int i = 0; i < num_bucket_ids; ++i) {
+    if (!DequantizeAdd(scales, embeddings, bytes_per_embedding,
+                       /*num_sparse_features=*/num_bucket_ids,
+                       quantization_bits, bucket_ids[i], dest, dest_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace libtextclassifier3
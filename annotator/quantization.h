@@ -33,6 +33,15 @@ bool DequantizeAdd(const float* scales, const uint8* embeddings,
                    int quantization_bits, int bucket_id, float* dest,
                    int dest_size);
 
+// Dequantizes the embeddings of all 'bucket_ids' and adds their average to
+// dest, i.e. the same as calling DequantizeAdd for each of them with
+// num_sparse_features = num_bucket_ids. The bucket ids must be valid rows of
+// the embedding storage.
+bool DequantizeAddBuckets(const float* scales, const uint8* embeddings,
+                          int bytes_per_embedding, const int* bucket_ids,
+                          int num_bucket_ids, int quantization_bits,
+                          float* dest, int dest_size);
+
 }  // namespace libtextclassifier3
 
 #endif  // LIBTEXTCLASSIFIER_ANNOTATOR_QUANTIZATION_H_
@@ -0,0 +1,113 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "annotator/token-embedding-cache.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace libtextclassifier3 {
+namespace {
+// Rough per-entry overhead of the list node, the hash map node and the
+// allocations of the key copies and the embedding.
+constexpr int64 kEntryOverheadBytes = 128;
+}  // namespace
+
+TokenEmbeddingCache::TokenEmbeddingCache(int64 max_size_bytes, int num_shards)
+    : max_size_bytes_(max_size_bytes),
+      max_shard_size_bytes_(max_size_bytes / std::max(num_shards, 1)),
+      shards_(new Shard[std::max(num_shards, 1)]),
+      num_shards_(std::max(num_shards, 1)) {}
+
+int64 TokenEmbeddingCache::EntrySize(const std::string& token_value,
+                                     int embedding_size) {
+  // The token value is stored both in the entry and as the index key.
+  return kEntryOverheadBytes + 2 * token_value.size() +
+         embedding_size * sizeof(float);
+}
+
+TokenEmbeddingCache::Shard* TokenEmbeddingCache::ShardFor(
+    const std::string& token_value) const {
+  return &shards_[std::hash<std::string>()(token_value) % num_shards_];
+}
+
+bool TokenEmbeddingCache::Lookup(const std::string& token_value,
+                                 int embedding_size, float* dest) const {
+  Shard* shard = ShardFor(token_value);
+  {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    const auto it = shard->index.find(token_value);
+    if (it != shard->index.end() &&
+        it->second->embedding.size() == embedding_size) {
+      // Move the entry to the front of the recency list.
+      shard->entries.splice(shard->entries.begin(), shard->entries,
+                            it->second);
+      std::copy(it->second->embedding.begin(), it->second->embedding.end(),
+                dest);
+      ++num_hits_;
+      return true;
+    }
+  }
+  ++num_misses_;
+  return false;
+}
+
+void TokenEmbeddingCache::Insert(const std::string& token_value,
+                                 const float* embedding, int embedding_size) {
+  const int64 entry_size = EntrySize(token_value, embedding_size);
+  if (entry_size > max_shard_size_bytes_) {
+    return;
+  }
+
+  Shard* shard = ShardFor(token_value);
+  std::lock_guard<std::mutex> lock(shard->mutex);
+  const auto it = shard->index.find(token_value);
+  if (it != shard->index.end()) {
+    // Another thread inserted the token in the meantime.
+    shard->entries.splice(shard->entries.begin(), shard->entries, it->second);
+    return;
+  }
+
+  while (shard->size_bytes + entry_size > max_shard_size_bytes_ &&
+         !shard->entries.empty()) {
+    const Entry& evicted = shard->entries.back();
+    shard->size_bytes -=
+        EntrySize(evicted.token_value, evicted.embedding.size());
+    shard->index.erase(evicted.token_value);
+    shard->entries.pop_back();
+    ++num_evictions_;
+  }
+
+  shard->entries.push_front(
+      Entry{token_value,
+            std::vector<float>(embedding, embedding + embedding_size)});
+  shard->index[token_value] = shard->entries.begin();
+  shard->size_bytes += entry_size;
+}
+
+TokenEmbeddingCache::Stats TokenEmbeddingCache::GetStats() const {
+  Stats stats;
+  stats.num_hits = num_hits_;
+  stats.num_misses = num_misses_;
+  stats.num_evictions = num_evictions_;
+  for (int i = 0; i < num_shards_; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    stats.num_entries += shards_[i].entries.size();
+    stats.size_bytes += shards_[i].size_bytes;
+  }
+  return stats;
+}
+
+}  // namespace libtextclassifier3
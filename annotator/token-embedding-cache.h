@@ -0,0 +1,123 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_TOKEN_EMBEDDING_CACHE_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_TOKEN_EMBEDDING_CACHE_H_
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/base/macros.h"
+
+namespace libtextclassifier3 {
+
+// A bounded cache mapping token values to their embedded sparse features, that
+// is shared between requests.
+//
+// The embedding of a token only depends on its value (and the feature options
+// of the model), not on its position in the text, so the cache can be used
+// across requests and texts, unlike FeatureProcessor::EmbeddingCache.
+// An instance must only be used with a single feature processor.
+//
+// The cache is split into shards, each with its own lock and least recently
+// used eviction, to keep contention low when used from many threads.
+// NOTE: Thread-safe.
+class TokenEmbeddingCache {
+ public:
+  struct Stats {
+    // Number of lookups that found the token in the cache.
+    int64 num_hits = 0;
+
+    // Number of lookups that did not find the token in the cache.
+    int64 num_misses = 0;
+
+    // Number of entries dropped to stay within the memory budget.
+    int64 num_evictions = 0;
+
+    // Number of entries currently in the cache.
+    int64 num_entries = 0;
+
+    // Approximate memory used by the entries, in bytes.
+    int64 size_bytes = 0;
+
+    // Returns the fraction of the lookups that were hits.
+    float HitRate() const {
+      const int64 num_lookups = num_hits + num_misses;
+      return num_lookups > 0 ? static_cast<float>(num_hits) / num_lookups : 0.f;
+    }
+  };
+
+  // 'max_size_bytes' is the memory budget of the entries, split evenly between
+  // the shards.
+  explicit TokenEmbeddingCache(int64 max_size_bytes, int num_shards = 16);
+
+  // Copies the cached embedding of the token into 'dest' and returns true, or
+  // returns false if the token is not cached with an embedding of size
+  // 'embedding_size'.
+  bool Lookup(const std::string& token_value, int embedding_size,
+              float* dest) const;
+
+  // Adds the embedding of the token to the cache, possibly evicting the least
+  // recently used entries of its shard. Embeddings that would take up more
+  // than the budget of a shard are not cached.
+  void Insert(const std::string& token_value, const float* embedding,
+              int embedding_size);
+
+  Stats GetStats() const;
+
+  int64 max_size_bytes() const { return max_size_bytes_; }
+
+ private:
+  struct Entry {
+    std::string token_value;
+    std::vector<float> embedding;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+
+    // Most recently used entries first.
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    int64 size_bytes = 0;
+  };
+
+  // Approximate memory taken by an entry, including the container overhead.
+  static int64 EntrySize(const std::string& token_value, int embedding_size);
+
+  Shard* ShardFor(const std::string& token_value) const;
+
+  const int64 max_size_bytes_;
+  const int64 max_shard_size_bytes_;
+  const std::unique_ptr<Shard[]> shards_;
+  const int num_shards_;
+
+  mutable std::atomic<int64> num_hits_{0};
+  mutable std::atomic<int64> num_misses_{0};
+  std::atomic<int64> num_evictions_{0};
+
+  TC3_DISALLOW_COPY_AND_ASSIGN(TokenEmbeddingCache);
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_TOKEN_EMBEDDING_CACHE_H_
@@ -34,10 +34,14 @@
 #include "utils/base/logging.h"
 #include "utils/flatbuffers/flatbuffers.h"
 #include "utils/optional.h"
+#include "utils/strings/stringpiece.h"
 #include "utils/variant.h"
 
 namespace libtextclassifier3 {
 
+class StageTrace;
+class ThreadPool;
+
 constexpr int kInvalidIndex = -1;
 constexpr int kSunday = 1;
 constexpr int kMonday = 2;
@@ -236,6 +240,36 @@ struct Token {
 logging::LoggingStringStream& operator<<(logging::LoggingStringStream& stream,
                                          const Token& token);
 
+// A token that refers to its value in the tokenized UTF8 text instead of
+// owning a copy of it. See Tokenizer::TokenizeInto.
+// NOTE: Only valid as long as the tokenized text is.
+struct TokenView {
+  // The bytes of the token in the tokenized text.
+  StringPiece value;
+  CodepointIndex start = kInvalidIndex;
+  CodepointIndex end = kInvalidIndex;
+
+  // Whether the token contains only white characters.
+  bool is_whitespace = false;
+
+  // Whether the tokenizer discarded codepoints in the middle of the token. In
+  // that case 'value' still includes them, and Tokenizer::ToToken needs to be
+  // used to get the token value without them.
+  bool has_discarded_codepoints = false;
+
+  TokenView() = default;
+  TokenView(StringPiece arg_value, CodepointIndex arg_start,
+            CodepointIndex arg_end, bool arg_is_whitespace = false)
+      : value(arg_value),
+        start(arg_start),
+        end(arg_end),
+        is_whitespace(arg_is_whitespace) {}
+
+  bool IsContainedInSpan(const CodepointSpan& span) const {
+    return start >= span.first && end <= span.second;
+  }
+};
+
 // Returns a TokenSpan that merges all of the given token spans.
 inline TokenSpan AllOf(const std::vector<Token>& tokens) {
   return {0, static_cast<TokenIndex>(tokens.size())};
@@ -527,6 +561,18 @@ struct BaseOptions {
   // to annotate "Dictionary". Otherwise, we use the FFModel to do so.
   bool use_vocab_annotator = false;
 
+  // If true, regex patterns are prefiltered by a literal that any of their
+  // matches has to contain, and the full regex match is only run on inputs
+  // containing that literal.
+  bool use_regex_literal_prefilter = false;
+
+  // If set, and the library is built with TC3_ENABLE_STAGE_TRACE, the wall
+  // time, number of outputs and allocated bytes of the individual stages of the
+  // call (tokenization, ModelChunk, RegexChunk, ResolveConflicts, ...) are
+  // recorded to it. Not owned, must outlive the call.
+  // NOTE: Not part of operator==, as it does not affect the results.
+  StageTrace* stage_trace = nullptr;
+
   bool operator==(const BaseOptions& other) const {
     bool location_context_equality = this->location_context.has_value() ==
                                      other.location_context.has_value();
@@ -541,7 +587,9 @@ struct BaseOptions {
                other.detected_text_language_tags &&
            location_context_equality &&
            this->use_pod_ner == other.use_pod_ner &&
-           this->use_vocab_annotator == other.use_vocab_annotator;
+           this->use_vocab_annotator == other.use_vocab_annotator &&
+           this->use_regex_literal_prefilter ==
+               other.use_regex_literal_prefilter;
   }
 };
 
@@ -607,6 +655,18 @@ struct AnnotationOptions : public BaseOptions, public DatetimeOptions {
   // If true, trigger dictionary on words that are of beginner level.
   bool trigger_dictionary_on_beginner_words = false;
 
+  // If set, the fragments of a structured input are annotated concurrently on
+  // this pool. The results are the same as without it. Not owned, must outlive
+  // the annotation call.
+  // NOTE: Not part of operator==, as it does not affect the results.
+  ThreadPool* thread_pool = nullptr;
+
+  // If true and thread_pool is set, the annotators of a single input (ML,
+  // regex, datetime, ...) also run concurrently on the thread pool. The results
+  // are the same as without it.
+  // NOTE: Not part of operator==, as it does not affect the results.
+  bool annotate_stages_concurrently = false;
+
   bool operator==(const AnnotationOptions& other) const {
     return this->is_serialized_entity_data_enabled ==
                other.is_serialized_entity_data_enabled &&
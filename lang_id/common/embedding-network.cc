@@ -15,8 +15,11 @@
 
 #include "lang_id/common/embedding-network.h"
 
+#include <algorithm>
+
 #include "lang_id/common/lite_base/integral-types.h"
 #include "lang_id/common/lite_base/logging.h"
+#include "lang_id/common/math/vector-ops.h"
 
 namespace libtextclassifier3 {
 namespace mobile {
@@ -104,16 +107,11 @@ void SparseReluProductPlusBias(bool apply_relu,
         // weights (i.e., weights[i][0]).
         const float scale = x[i];
         if (!apply_relu || (scale > 0)) {
-          for (int j = 0; j < y_size; ++j, ++weight_ptr) {
-            // Invariant 2: weight_ptr points to weights[i][j].
-            y_data[j] += (*weight_ptr) * scale;
-          }
-        } else {
-          // We don't update y_data, but we still have to move weight_ptr to the
-          // next row (to satisfy Invariant 1).  We do this by adding y_size ==
-          // weights.cols() (see earlier CHECK_EQ).
-          weight_ptr += y_size;
+          ScaleAdd(weight_ptr, scale, y_size, y_data);
         }
+        // Move weight_ptr to the next row (to satisfy Invariant 1).  We do this
+        // by adding y_size == weights.cols() (see earlier CHECK_EQ).
+        weight_ptr += y_size;
       }
       break;
     }
@@ -128,11 +126,66 @@ void SparseReluProductPlusBias(bool apply_relu,
       for (int i = 0; i < x_size; ++i) {
         const float scale = x[i];
         if (!apply_relu || (scale > 0)) {
-          for (int j = 0; j < y_size; ++j, ++weight_ptr) {
-            y_data[j] += Float16To32(*weight_ptr) * scale;
+          Float16ScaleAdd(weight_ptr, scale, y_size, y_data);
+        }
+        weight_ptr += y_size;
+      }
+      break;
+    }
+    default:
+      SAFTM_LOG(FATAL) << "Unsupported weights quantization type: "
+                       << static_cast<int>(weights.quant_type);
+  }
+}
+
+// Batched version of SparseReluProductPlusBias: computes y[b] = weights *
+// Relu(x[b]) + bias for each b in [0, batch_size), where x and y are row-major
+// matrices with batch_size rows.  This is a matrix-matrix product, organized
+// such that each row of weights is read from memory only once for the whole
+// batch.  The result for each row is identical to the one computed by
+// SparseReluProductPlusBias.
+void SparseReluProductPlusBiasBatch(
+    bool apply_relu, const EmbeddingNetworkParams::Matrix &weights,
+    const EmbeddingNetworkParams::Matrix &b, int batch_size,
+    const std::vector<float> &x, std::vector<float> *y) {
+  const float *b_start = reinterpret_cast<const float *>(b.elements);
+  SAFTM_DCHECK_EQ(b.cols, 1);
+  const int y_size = b.rows;
+  SAFTM_CHECK_EQ(weights.cols, y_size);
+  const int x_size = weights.rows;
+  SAFTM_CHECK_EQ(x.size(), batch_size * x_size);
+
+  // Initialize each row of y to b.
+  y->resize(batch_size * y_size);
+  for (int k = 0; k < batch_size; ++k) {
+    std::copy(b_start, b_start + y_size, y->data() + k * y_size);
+  }
+
+  float *const y_data = y->data();
+  const float *const x_data = x.data();
+  switch (weights.quant_type) {
+    case QuantizationType::NONE: {
+      const float *weight_ptr =
+          reinterpret_cast<const float *>(weights.elements);
+      for (int i = 0; i < x_size; ++i, weight_ptr += y_size) {
+        for (int k = 0; k < batch_size; ++k) {
+          const float scale = x_data[k * x_size + i];
+          if (!apply_relu || (scale > 0)) {
+            ScaleAdd(weight_ptr, scale, y_size, y_data + k * y_size);
+          }
+        }
+      }
+      break;
+    }
+    case QuantizationType::FLOAT16: {
+      const float16 *weight_ptr =
+          reinterpret_cast<const float16 *>(weights.elements);
+      for (int i = 0; i < x_size; ++i, weight_ptr += y_size) {
+        for (int k = 0; k < batch_size; ++k) {
+          const float scale = x_data[k * x_size + i];
+          if (!apply_relu || (scale > 0)) {
+            Float16ScaleAdd(weight_ptr, scale, y_size, y_data + k * y_size);
           }
-        } else {
-          weight_ptr += y_size;
         }
       }
       break;
@@ -148,6 +201,11 @@ void EmbeddingNetwork::ConcatEmbeddings(
     const std::vector<FeatureVector> &feature_vectors,
     std::vector<float> *concat) const {
   concat->resize(concat_layer_size_);
+  ConcatEmbeddings(feature_vectors, concat->data());
+}
+
+void EmbeddingNetwork::ConcatEmbeddings(
+    const std::vector<FeatureVector> &feature_vectors, float *concat) const {
 
   // "es_index" stands for "embedding space index".
   for (int es_index = 0; es_index < feature_vectors.size(); ++es_index) {
@@ -164,10 +222,10 @@ void EmbeddingNetwork::ConcatEmbeddings(
     for (int fi = 0; fi < num_features; ++fi) {
       const FeatureType *feature_type = feature_vector.type(fi);
       int feature_offset = concat_offset + feature_type->base() * embedding_dim;
-      SAFTM_CHECK_LE(feature_offset + embedding_dim, concat->size());
+      SAFTM_CHECK_LE(feature_offset + embedding_dim, concat_layer_size_);
 
       // Weighted embeddings will be added starting from this address.
-      float *concat_ptr = concat->data() + feature_offset;
+      float *concat_ptr = concat + feature_offset;
 
       // Multiplier for each embedding weight.  Includes feature weight (for
       // continuous features) and quantization scale (for quantized embeddings).
@@ -197,21 +255,15 @@ void EmbeddingNetwork::ConcatEmbeddings(
         case QuantizationType::NONE: {
           const float *weights =
               reinterpret_cast<const float *>(embedding_data);
-          for (int i = 0; i < embedding_dim; ++i, ++weights, ++concat_ptr) {
-            *concat_ptr += *weights * multiplier;
-          }
+          ScaleAdd(weights, multiplier, embedding_dim, concat_ptr);
           break;
         }
         case QuantizationType::UINT8: {
           multiplier *= Float16To32(embedding_matrix.quant_scales[feature_id]);
           const uint8 *quant_weights =
               reinterpret_cast<const uint8 *>(embedding_data);
-          for (int i = 0; i < embedding_dim;
-               ++i, ++quant_weights, ++concat_ptr) {
-            // 128 is bias for UINT8 quantization.
-            *concat_ptr +=
-                (static_cast<int>(*quant_weights) - 128) * multiplier;
-          }
+          // 128 is bias for UINT8 quantization.
+          Uint8ScaleAdd(quant_weights, multiplier, embedding_dim, concat_ptr);
           break;
         }
         case QuantizationType::UINT4: {
@@ -284,6 +336,42 @@ void EmbeddingNetwork::ComputeFinalScores(
   }
 }
 
+void EmbeddingNetwork::ComputeFinalScoresBatch(
+    const std::vector<std::vector<FeatureVector>> &features,
+    std::vector<std::vector<float>> *scores) const {
+  const int batch_size = features.size();
+  scores->resize(batch_size);
+  if (batch_size == 0) {
+    return;
+  }
+
+  // Stack the input layers of all the examples into one row-major matrix.
+  std::vector<float> input(batch_size * concat_layer_size_, 0.0f);
+  for (int k = 0; k < batch_size; ++k) {
+    ConcatEmbeddings(features[k], input.data() + k * concat_layer_size_);
+  }
+
+  // Propagate the whole batch through all layers of our FFNN.  See
+  // ComputeFinalScores.
+  std::vector<float> storage[2];
+  const std::vector<float> *v_in = &input;
+  const int num_layers = layer_weights_.size();
+  for (int i = 0; i < num_layers; ++i) {
+    std::vector<float> *v_out = &(storage[i % 2]);
+    const bool apply_relu = i > 0;
+    SparseReluProductPlusBiasBatch(apply_relu, layer_weights_[i],
+                                   layer_bias_[i], batch_size, *v_in, v_out);
+    v_in = v_out;
+  }
+
+  // Split the output matrix into the per-example scores.
+  const int num_scores = v_in->size() / batch_size;
+  for (int k = 0; k < batch_size; ++k) {
+    (*scores)[k].assign(v_in->begin() + k * num_scores,
+                        v_in->begin() + (k + 1) * num_scores);
+  }
+}
+
 EmbeddingNetwork::EmbeddingNetwork(const EmbeddingNetworkParams *model)
     : model_(model) {
   int offset_sum = 0;
@@ -60,12 +60,25 @@ class EmbeddingNetwork {
                           const std::vector<float> &extra_inputs,
                           std::vector<float> *scores) const;
 
+  // Batched version of ComputeFinalScores: fills (*scores)[i] with the scores
+  // for features[i].  Runs each layer as a single matrix-matrix product over
+  // the whole batch, which is faster than scoring the examples one by one.
+  // The scores are the same as the ones computed by ComputeFinalScores.
+  void ComputeFinalScoresBatch(
+      const std::vector<std::vector<FeatureVector>> &features,
+      std::vector<std::vector<float>> *scores) const;
+
  private:
   // Constructs the concatenated input embedding vector in place in output
   // vector concat.
   void ConcatEmbeddings(const std::vector<FeatureVector> &features,
                         std::vector<float> *concat) const;
 
+  // Same as above, but adds the embeddings to the concat_layer_size_ floats
+  // starting at concat, which must be zero-initialized by the caller.
+  void ConcatEmbeddings(const std::vector<FeatureVector> &features,
+                        float *concat) const;
+
   // Pointer to the model object passed to the constructor.  Not owned.
   const EmbeddingNetworkParams *model_;
 
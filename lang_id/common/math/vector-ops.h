@@ -0,0 +1,165 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Vectorized "y += scale * x" kernels for the inner loops of EmbeddingNetwork.
+//
+// Each kernel has an SSE2 / AVX2 / NEON implementation (chosen at compile time,
+// based on the target architecture flags) and a scalar fallback.  All
+// implementations compute, for each element, a multiplication followed by an
+// addition (no fused multiply-add), so they produce the same results as the
+// scalar code.
+
+#ifndef NLP_SAFT_COMPONENTS_COMMON_MOBILE_MATH_VECTOR_OPS_H_
+#define NLP_SAFT_COMPONENTS_COMMON_MOBILE_MATH_VECTOR_OPS_H_
+
+#include "lang_id/common/lite_base/float16.h"
+#include "lang_id/common/lite_base/integral-types.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SAFTM_VECTOR_OPS_NEON
+#endif
+
+namespace libtextclassifier3 {
+namespace mobile {
+
+// Computes y[i] += scale * x[i], for i in [0, size).
+inline void ScaleAdd(const float *x, float scale, int size, float *y) {
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  for (; i + 8 <= size; i += 8) {
+    const __m256 prod = _mm256_mul_ps(_mm256_loadu_ps(x + i), scale8);
+    _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), prod));
+  }
+#elif defined(__SSE2__)
+  const __m128 scale4 = _mm_set1_ps(scale);
+  for (; i + 4 <= size; i += 4) {
+    const __m128 prod = _mm_mul_ps(_mm_loadu_ps(x + i), scale4);
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), prod));
+  }
+#elif defined(SAFTM_VECTOR_OPS_NEON)
+  const float32x4_t scale4 = vdupq_n_f32(scale);
+  for (; i + 4 <= size; i += 4) {
+    const float32x4_t prod = vmulq_f32(vld1q_f32(x + i), scale4);
+    vst1q_f32(y + i, vaddq_f32(vld1q_f32(y + i), prod));
+  }
+#endif
+  for (; i < size; ++i) {
+    y[i] += x[i] * scale;
+  }
+}
+
+// Same as ScaleAdd, but x is stored as float16 (see float16.h).
+inline void Float16ScaleAdd(const float16 *x, float scale, int size,
+                            float *y) {
+  int i = 0;
+#if defined(__AVX2__)
+  // A float16 is the upper half of the bits of a float: zero-extending to 32
+  // bits and shifting left by 16 gives the float.
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  for (; i + 8 <= size; i += 8) {
+    const __m128i halves =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i));
+    const __m256 values = _mm256_castsi256_ps(
+        _mm256_slli_epi32(_mm256_cvtepu16_epi32(halves), 16));
+    const __m256 prod = _mm256_mul_ps(values, scale8);
+    _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), prod));
+  }
+#elif defined(__SSE2__)
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= size; i += 8) {
+    const __m128i halves =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(x + i));
+    // Interleaving zeros below each float16 puts it in the upper 16 bits.
+    const __m128 lo = _mm_castsi128_ps(_mm_unpacklo_epi16(zero, halves));
+    const __m128 hi = _mm_castsi128_ps(_mm_unpackhi_epi16(zero, halves));
+    _mm_storeu_ps(y + i,
+                  _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(lo, scale4)));
+    _mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4),
+                                        _mm_mul_ps(hi, scale4)));
+  }
+#elif defined(SAFTM_VECTOR_OPS_NEON)
+  const float32x4_t scale4 = vdupq_n_f32(scale);
+  for (; i + 4 <= size; i += 4) {
+    const float32x4_t values =
+        vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(x + i), 16));
+    vst1q_f32(y + i, vaddq_f32(vld1q_f32(y + i), vmulq_f32(values, scale4)));
+  }
+#endif
+  for (; i < size; ++i) {
+    y[i] += Float16To32(x[i]) * scale;
+  }
+}
+
+// Computes y[i] += scale * (x[i] - 128), for i in [0, size).  This is the
+// dequantization of UINT8 quantized weights (128 is the quantization bias).
+inline void Uint8ScaleAdd(const uint8 *x, float scale, int size, float *y) {
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  const __m256i bias = _mm256_set1_epi32(128);
+  for (; i + 8 <= size; i += 8) {
+    const __m128i bytes =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(x + i));
+    const __m256 values = _mm256_cvtepi32_ps(
+        _mm256_sub_epi32(_mm256_cvtepu8_epi32(bytes), bias));
+    const __m256 prod = _mm256_mul_ps(values, scale8);
+    _mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), prod));
+  }
+#elif defined(__SSE2__)
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set1_epi32(128);
+  for (; i + 8 <= size; i += 8) {
+    const __m128i bytes =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(x + i));
+    const __m128i words = _mm_unpacklo_epi8(bytes, zero);
+    const __m128 lo = _mm_cvtepi32_ps(
+        _mm_sub_epi32(_mm_unpacklo_epi16(words, zero), bias));
+    const __m128 hi = _mm_cvtepi32_ps(
+        _mm_sub_epi32(_mm_unpackhi_epi16(words, zero), bias));
+    _mm_storeu_ps(y + i,
+                  _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(lo, scale4)));
+    _mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4),
+                                        _mm_mul_ps(hi, scale4)));
+  }
+#elif defined(SAFTM_VECTOR_OPS_NEON)
+  const float32x4_t scale4 = vdupq_n_f32(scale);
+  const int16x8_t bias = vdupq_n_s16(128);
+  for (; i + 8 <= size; i += 8) {
+    const int16x8_t words =
+        vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(x + i))), bias);
+    const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(words)));
+    const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(words)));
+    vst1q_f32(y + i, vaddq_f32(vld1q_f32(y + i), vmulq_f32(lo, scale4)));
+    vst1q_f32(y + i + 4,
+              vaddq_f32(vld1q_f32(y + i + 4), vmulq_f32(hi, scale4)));
+  }
+#endif
+  for (; i < size; ++i) {
+    y[i] += (static_cast<int>(x[i]) - 128) * scale;
+  }
+}
+
+}  // namespace mobile
+}  // namespace nlp_saft
+
+#endif  // NLP_SAFT_COMPONENTS_COMMON_MOBILE_MATH_VECTOR_OPS_H_
@@ -51,8 +51,6 @@ bool ContinuousBagOfNgramsFunction::Setup(TaskContext *context) {
 
   ngram_id_dimension_ = GetIntParameter("id_dim", 10000);
   ngram_size_ = GetIntParameter("size", 3);
-
-  counts_.assign(ngram_id_dimension_, 0);
   return true;
 }
 
@@ -61,10 +59,22 @@ bool ContinuousBagOfNgramsFunction::Init(TaskContext *context) {
   return true;
 }
 
+ContinuousBagOfNgramsFunction::NgramCountsScratch *
+ContinuousBagOfNgramsFunction::GetScratch() const {
+  // Shared by all instances of this class used on the current thread.  As
+  // counts are all zeros in between calls, growing the vector for a bigger
+  // ngram_id_dimension_ keeps that invariant.
+  static thread_local NgramCountsScratch scratch;
+  if (scratch.counts.size() < ngram_id_dimension_) {
+    scratch.counts.resize(ngram_id_dimension_, 0);
+  }
+  return &scratch;
+}
+
 int ContinuousBagOfNgramsFunction::ComputeNgramCounts(
-    const LightSentence &sentence) const {
-  SAFTM_CHECK_EQ(counts_.size(), ngram_id_dimension_);
-  SAFTM_CHECK_EQ(non_zero_count_indices_.size(), 0);
+    const LightSentence &sentence, NgramCountsScratch *scratch) const {
+  SAFTM_CHECK_GE(scratch->counts.size(), ngram_id_dimension_);
+  SAFTM_CHECK_EQ(scratch->non_zero_count_indices.size(), 0);
 
   int total_count = 0;
 
@@ -99,9 +109,9 @@ int ContinuousBagOfNgramsFunction::ComputeNgramCounts(
 
       // Use a reference to the actual count, such that we can both test whether
       // the count was 0 and increment it without perfoming two lookups.
-      int &ref_to_count_for_ngram = counts_[ngram_id];
+      int &ref_to_count_for_ngram = scratch->counts[ngram_id];
       if (ref_to_count_for_ngram == 0) {
-        non_zero_count_indices_.push_back(ngram_id);
+        scratch->non_zero_count_indices.push_back(ngram_id);
       }
       ref_to_count_for_ngram++;
       total_count++;
@@ -123,30 +133,27 @@ int ContinuousBagOfNgramsFunction::ComputeNgramCounts(
 void ContinuousBagOfNgramsFunction::Evaluate(const WorkspaceSet &workspaces,
                                              const LightSentence &sentence,
                                              FeatureVector *result) const {
-  // NOTE: we use std::* constructs (instead of absl::Mutex & co) to simplify
-  // porting to Android and to avoid pulling in absl (which increases our code
-  // size).
-  std::lock_guard<std::mutex> mlock(state_mutex_);
+  NgramCountsScratch *scratch = GetScratch();
 
   // Find the char ngram counts.
-  int total_count = ComputeNgramCounts(sentence);
+  int total_count = ComputeNgramCounts(sentence, scratch);
 
   // Populate the feature vector.
   const float norm = static_cast<float>(total_count);
 
   // TODO(salcianu): explore treating dense vectors (i.e., many non-zero
   // elements) separately.
-  for (int ngram_id : non_zero_count_indices_) {
-    const float weight = counts_[ngram_id] / norm;
+  for (int ngram_id : scratch->non_zero_count_indices) {
+    const float weight = scratch->counts[ngram_id] / norm;
     FloatFeatureValue value(ngram_id, weight);
     result->add(feature_type(), value.discrete_value);
 
-    // Clear up counts_, for the next invocation of Evaluate().
-    counts_[ngram_id] = 0;
+    // Clear up counts, for the next invocation of Evaluate().
+    scratch->counts[ngram_id] = 0;
   }
 
-  // Clear up non_zero_count_indices_, for the next invocation of Evaluate().
-  non_zero_count_indices_.clear();
+  // Clear up non_zero_count_indices, for the next invocation of Evaluate().
+  scratch->non_zero_count_indices.clear();
 }
 
 SAFTM_STATIC_REGISTRATION(ContinuousBagOfNgramsFunction);
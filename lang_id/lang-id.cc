@@ -154,23 +154,49 @@ class LangIdImpl {
     std::vector<float> scores;
     network_->ComputeFinalScores(features, &scores);
 
-    if (max_results == 1) {
-      // Optimization for the case when the user wants only the top result.
-      // Computing argmax is faster than the general top-k code.
-      int prediction_id = GetArgMax(scores);
-      const std::string language = GetLanguageForSoftmaxLabel(prediction_id);
-      float probability = ComputeSoftmaxProbability(scores, prediction_id);
-      result->predictions.emplace_back(language, probability);
-    } else {
-      // Compute and sort softmax in descending order by probability and convert
-      // IDs to language code strings.  When probabilities are equal, we sort by
-      // language code string in ascending order.
-      const std::vector<float> softmax = ComputeSoftmax(scores);
-      const std::vector<int> indices = GetTopKIndices(max_results, softmax);
-      for (const int index : indices) {
-        result->predictions.emplace_back(GetLanguageForSoftmaxLabel(index),
-                                         softmax[index]);
+    FillResultFromScores(scores, max_results, result);
+  }
+
+  void FindLanguagesBatch(const std::vector<StringPiece> &texts,
+                          std::vector<LangIdResult> *results,
+                          int max_results) const {
+    if (results == nullptr) return;
+    results->clear();
+    results->resize(texts.size());
+
+    if (max_results <= 0) {
+      max_results = languages_.size();
+    }
+    if (!is_valid() || (max_results == 0)) {
+      for (LangIdResult &result : *results) {
+        result.predictions.emplace_back(LangId::kUnknownLanguageCode, 1);
       }
+      return;
+    }
+
+    // Tokenize the texts and extract their features; texts that are too short
+    // are answered right away, the other ones are scored in one batch.
+    std::vector<std::vector<FeatureVector>> batch_features;
+    std::vector<int> batch_indices;
+    batch_features.reserve(texts.size());
+    batch_indices.reserve(texts.size());
+    for (int i = 0; i < texts.size(); ++i) {
+      LightSentence sentence;
+      tokenizer_.Tokenize(texts[i], &sentence);
+      if (IsTooShort(sentence)) {
+        (*results)[i].predictions.emplace_back(LangId::kUnknownLanguageCode, 1);
+        continue;
+      }
+      batch_features.push_back(
+          lang_id_brain_interface_.GetFeaturesNoCaching(&sentence));
+      batch_indices.push_back(i);
+    }
+
+    std::vector<std::vector<float>> batch_scores;
+    network_->ComputeFinalScoresBatch(batch_features, &batch_scores);
+    for (int k = 0; k < batch_indices.size(); ++k) {
+      FillResultFromScores(batch_scores[k], max_results,
+                           &(*results)[batch_indices[k]]);
     }
   }
 
@@ -250,6 +276,30 @@ class LangIdImpl {
     }
   }
 
+  // Converts the softmax logits computed by the network into the n-best list
+  // of |max_results| languages, stored in |result|.
+  void FillResultFromScores(const std::vector<float> &scores, int max_results,
+                            LangIdResult *result) const {
+    if (max_results == 1) {
+      // Optimization for the case when the user wants only the top result.
+      // Computing argmax is faster than the general top-k code.
+      int prediction_id = GetArgMax(scores);
+      const std::string language = GetLanguageForSoftmaxLabel(prediction_id);
+      float probability = ComputeSoftmaxProbability(scores, prediction_id);
+      result->predictions.emplace_back(language, probability);
+    } else {
+      // Compute and sort softmax in descending order by probability and convert
+      // IDs to language code strings.  When probabilities are equal, we sort by
+      // language code string in ascending order.
+      const std::vector<float> softmax = ComputeSoftmax(scores);
+      const std::vector<int> indices = GetTopKIndices(max_results, softmax);
+      for (const int index : indices) {
+        result->predictions.emplace_back(GetLanguageForSoftmaxLabel(index),
+                                         softmax[index]);
+      }
+    }
+  }
+
   bool IsTooShort(const LightSentence &sentence) const {
     int text_size = 0;
     for (const std::string &token : sentence) {
@@ -314,6 +364,13 @@ void LangId::FindLanguages(const char *data, size_t num_bytes,
   pimpl_->FindLanguages(text, result, max_results);
 }
 
+void LangId::FindLanguagesBatch(const std::vector<StringPiece> &texts,
+                                std::vector<LangIdResult> *results,
+                                int max_results) const {
+  SAFTM_DCHECK(results) << "Results vector must not be null.";
+  pimpl_->FindLanguagesBatch(texts, results, max_results);
+}
+
 bool LangId::is_valid() const { return pimpl_->is_valid(); }
 
 int LangId::GetModelVersion() const { return pimpl_->GetModelVersion(); }
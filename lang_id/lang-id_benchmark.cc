@@ -0,0 +1,96 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Benchmarks of LangId. The path of the model is read from the
+// TC3_BENCHMARK_LANGID_MODEL environment variable; the benchmarks are skipped
+// if it is not set.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lang_id/fb_model/lang-id-from-fb.h"
+#include "lang_id/lang-id.h"
+#include "utils/benchmark-data.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace mobile {
+namespace lang_id {
+namespace {
+
+std::unique_ptr<LangId> LoadLangId(benchmark::State* state) {
+  const std::string model_path =
+      benchmark_data::GetEnv("TC3_BENCHMARK_LANGID_MODEL");
+  std::unique_ptr<LangId> lang_id;
+  if (!model_path.empty()) {
+    lang_id = GetLangIdFromFlatbufferFile(model_path);
+  }
+  if (lang_id == nullptr || !lang_id->is_valid()) {
+    state->SkipWithError("Set TC3_BENCHMARK_LANGID_MODEL to a model.");
+    return nullptr;
+  }
+  return lang_id;
+}
+
+void BM_FindLanguages(benchmark::State& state) {
+  const std::unique_ptr<LangId> lang_id = LoadLangId(&state);
+  if (lang_id == nullptr) {
+    return;
+  }
+  const std::string text =
+      benchmark_data::SyntheticText(state.range(0));
+  LangIdResult result;
+  for (auto _ : state) {
+    lang_id->FindLanguages(text, &result);
+    benchmark::DoNotOptimize(result.predictions.data());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_FindLanguages)->ArgName("num_words")->Arg(5)->Arg(50)->Arg(500);
+
+// Many short texts, classified one by one or in one batch.
+void BM_FindLanguagesBatch(benchmark::State& state) {
+  const std::unique_ptr<LangId> lang_id = LoadLangId(&state);
+  if (lang_id == nullptr) {
+    return;
+  }
+  std::vector<std::string> texts;
+  for (int i = 0; i < 64; ++i) {
+    texts.push_back(benchmark_data::SyntheticText(
+        /*num_words=*/5, /*seed=*/i));
+  }
+  const std::vector<StringPiece> text_pieces(texts.begin(), texts.end());
+  const bool batched = state.range(0);
+
+  std::vector<LangIdResult> results(texts.size());
+  for (auto _ : state) {
+    if (batched) {
+      lang_id->FindLanguagesBatch(text_pieces, &results);
+    } else {
+      for (int i = 0; i < texts.size(); ++i) {
+        lang_id->FindLanguages(texts[i], &results[i]);
+      }
+    }
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetItemsProcessed(state.iterations() * texts.size());
+}
+BENCHMARK(BM_FindLanguagesBatch)->ArgName("batched")->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace lang_id
+}  // namespace mobile
+}  // namespace libtextclassifier3
@@ -0,0 +1,116 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Deterministic synthetic inputs for the benchmarks.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_BENCHMARK_DATA_H_
+#define LIBTEXTCLASSIFIER_UTILS_BENCHMARK_DATA_H_
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+
+namespace libtextclassifier3 {
+namespace benchmark_data {
+
+// Small linear congruential generator, so that the inputs are the same on all
+// platforms and standard library implementations.
+class Random {
+ public:
+  explicit Random(uint32 seed) : state_(seed) {}
+
+  uint32 Next() {
+    state_ = state_ * 1664525u + 1013904223u;
+    return state_ >> 8;
+  }
+
+  // Returns a number in [0, n).
+  int Uniform(int n) { return Next() % n; }
+
+ private:
+  uint32 state_;
+};
+
+// Returns English-like text with 'num_words' words, sprinkled with the kinds
+// of entities the annotators look for (emails, urls, phone numbers, dates,
+// numbers) and some non-ASCII words.
+inline std::string SyntheticText(int num_words, uint32 seed = 42) {
+  static const char* const kWords[] = {
+      "the",     "meeting", "is",       "scheduled", "for",    "tomorrow",
+      "please",  "call",    "me",       "at",        "office", "we",
+      "should",  "send",    "invoice",  "to",        "and",    "flight",
+      "arrives", "on",      "terminal", "address",   "street", "Zürich",
+      "café",    "naïve",   "Привет",   "東京",      "order",
+      "number"};
+  static const char* const kEntities[] = {
+      "john.doe@example.com", "http://www.example.com/path?q=1",
+      "+41 44 668 18 00",     "(650) 253-0000",
+      "March 3rd 2021",       "25.12.2020 at 14:30",
+      "next Tuesday 5pm",     "3.14",
+      "1,234,567",            "12%",
+      "45 minutes",           "1600 Amphitheatre Parkway"};
+  const int num_plain_words = sizeof(kWords) / sizeof(kWords[0]);
+  const int num_entities = sizeof(kEntities) / sizeof(kEntities[0]);
+
+  Random random(seed);
+  std::string text;
+  for (int i = 0; i < num_words; ++i) {
+    if (i > 0) {
+      text += random.Uniform(12) == 0 ? ". " : " ";
+    }
+    if (random.Uniform(8) == 0) {
+      text += kEntities[random.Uniform(num_entities)];
+    } else {
+      text += kWords[random.Uniform(num_plain_words)];
+    }
+  }
+  return text;
+}
+
+// Returns 'num_strings' distinct lowercase ASCII strings with lengths in
+// [min_length, max_length].
+inline std::vector<std::string> SyntheticStrings(int num_strings,
+                                                 int min_length,
+                                                 int max_length,
+                                                 uint32 seed = 42) {
+  Random random(seed);
+  std::vector<std::string> strings;
+  strings.reserve(num_strings);
+  for (int i = 0; i < num_strings; ++i) {
+    const int length = min_length + random.Uniform(max_length - min_length + 1);
+    std::string value;
+    for (int j = 0; j < length; ++j) {
+      value += static_cast<char>('a' + random.Uniform(26));
+    }
+    // Make the strings distinct.
+    value += std::to_string(i);
+    strings.push_back(value);
+  }
+  return strings;
+}
+
+// Returns the value of an environment variable or an empty string. Used to
+// point the benchmarks that need real models to the model files.
+inline std::string GetEnv(const char* name) {
+  const char* value = std::getenv(name);
+  return value == nullptr ? "" : value;
+}
+
+}  // namespace benchmark_data
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_BENCHMARK_DATA_H_
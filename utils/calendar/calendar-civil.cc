@@ -0,0 +1,403 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "utils/calendar/calendar-civil.h"
+
+#include "utils/calendar/civil-date.h"
+#include "utils/strings/stringpiece.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr int64 kMillisPerMinute = 60 * civil::kMillisPerSecond;
+constexpr int64 kMillisPerHour = 60 * kMillisPerMinute;
+
+// Week data of the regions that differ from the default of weeks starting on
+// Monday with at least one day in the first week of the year, from CLDR.
+const char* const kSundayRegions[] = {
+    "AG", "AS", "BD", "BR", "BS", "BT", "BW", "BZ", "CA", "CO", "DM", "DO",
+    "ET", "GT", "GU", "HK", "HN", "ID", "IL", "IN", "JM", "JP", "KE", "KH",
+    "KR", "LA", "MH", "MM", "MO", "MT", "MX", "MZ", "NI", "NP", "PA", "PE",
+    "PH", "PK", "PR", "PT", "PY", "SA", "SG", "SV", "TH", "TT", "TW", "UM",
+    "US", "VE", "VI", "WS", "YE", "ZA", "ZW"};
+const char* const kSaturdayRegions[] = {"AE", "AF", "BH", "DJ", "DZ",
+                                        "EG", "IQ", "IR", "JO", "KW",
+                                        "LY", "OM", "QA", "SD", "SY"};
+const char* const kFridayRegions[] = {"MV"};
+const char* const kFourMinimalDaysRegions[] = {
+    "AD", "AT", "AX", "BE", "BG", "CH", "CZ", "DE", "DK", "EE", "ES",
+    "FI", "FJ", "FO", "FR", "GB", "GF", "GG", "GI", "GP", "GR", "HU",
+    "IE", "IM", "IS", "IT", "JE", "LI", "LT", "LU", "MC", "MQ", "NL",
+    "NO", "PL", "PT", "RE", "RU", "SE", "SJ", "SK", "SM", "VA"};
+
+// The region of locales without one, the most likely one for the language.
+const char* const kLikelyRegions[][2] = {
+    {"ar", "EG"}, {"bg", "BG"}, {"bn", "BD"}, {"cs", "CZ"}, {"da", "DK"},
+    {"de", "DE"}, {"el", "GR"}, {"en", "US"}, {"es", "ES"}, {"et", "EE"},
+    {"fa", "IR"}, {"fi", "FI"}, {"fr", "FR"}, {"he", "IL"}, {"hi", "IN"},
+    {"hu", "HU"}, {"id", "ID"}, {"in", "ID"}, {"it", "IT"}, {"iw", "IL"},
+    {"ja", "JP"}, {"ko", "KR"}, {"lt", "LT"}, {"ms", "MY"}, {"nb", "NO"},
+    {"nl", "NL"}, {"no", "NO"}, {"pl", "PL"}, {"pt", "BR"}, {"ro", "RO"},
+    {"ru", "RU"}, {"sk", "SK"}, {"sv", "SE"}, {"th", "TH"}, {"tr", "TR"},
+    {"uk", "UA"}, {"ur", "PK"}, {"vi", "VN"}, {"zh", "CN"}};
+
+char ToAsciiLower(char c) {
+  return c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+}
+
+// Whether two ASCII strings are equal, ignoring case.
+bool EqualsIgnoringAsciiCase(StringPiece a, StringPiece b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (ToAsciiLower(a[i]) != ToAsciiLower(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <int N>
+bool Contains(const char* const (&regions)[N], StringPiece region) {
+  for (const char* candidate : regions) {
+    if (EqualsIgnoringAsciiCase(region, candidate)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the region of a locale like "en-US", "zh_Hant_TW" or "en", in the
+// case used by the locale. Points into the locale or into kLikelyRegions, so
+// that initializing a calendar doesn't allocate.
+StringPiece LocaleRegion(StringPiece locale) {
+  StringPiece language;
+  int subtag_index = 0;
+  size_t start = 0;
+  while (start <= locale.size()) {
+    size_t end = start;
+    while (end < locale.size() && locale[end] != '-' && locale[end] != '_' &&
+           locale[end] != '@') {
+      ++end;
+    }
+    const StringPiece subtag(locale.data() + start, end - start);
+    if (subtag_index == 0) {
+      language = subtag;
+    } else if (subtag.size() == 2 || (subtag.size() == 3 && subtag[0] >= '0' &&
+                                      subtag[0] <= '9')) {
+      return subtag;
+    }
+    if (end == locale.size() || locale[end] == '@') {
+      break;
+    }
+    start = end + 1;
+    ++subtag_index;
+  }
+
+  for (const auto& likely_region : kLikelyRegions) {
+    if (EqualsIgnoringAsciiCase(language, likely_region[0])) {
+      return likely_region[1];
+    }
+  }
+  return StringPiece();
+}
+
+void GetWeekData(StringPiece locale, int* first_day_of_week,
+                 int* minimal_days_in_first_week) {
+  const StringPiece region = LocaleRegion(locale);
+  if (Contains(kSundayRegions, region)) {
+    *first_day_of_week = kSunday;
+  } else if (Contains(kSaturdayRegions, region)) {
+    *first_day_of_week = kSaturday;
+  } else if (Contains(kFridayRegions, region)) {
+    *first_day_of_week = kFriday;
+  } else {
+    *first_day_of_week = kMonday;
+  }
+  *minimal_days_in_first_week =
+      Contains(kFourMinimalDaysRegions, region) ? 4 : 1;
+}
+
+}  // namespace
+
+bool CivilCalendar::Initialize(const std::string& time_zone,
+                               const std::string& locale, int64 time_ms_utc) {
+  time_zone_ = time_zones_->Get(time_zone);
+  if (time_zone_ == nullptr) {
+    return false;
+  }
+  GetWeekData(locale, &first_day_of_week_, &minimal_days_in_first_week_);
+  SetTime(time_ms_utc);
+  return true;
+}
+
+bool CivilCalendar::Set(Field field, int value) {
+  fields_[field] = value;
+  stamps_[field] = next_stamp_++;
+  return true;
+}
+
+int CivilCalendar::WeekNumber(int day_of_period, int day_of_week) const {
+  // Same as Calendar::weekNumber in ICU.
+  const int period_start_day_of_week = civil::FloorMod(
+      day_of_week - first_day_of_week_ - day_of_period + 1, 7);
+  int week = (day_of_period + period_start_day_of_week - 1) / 7;
+  if (7 - period_start_day_of_week >= minimal_days_in_first_week_) {
+    ++week;
+  }
+  return week;
+}
+
+void CivilCalendar::SetTime(int64 time_ms_utc) {
+  time_ms_utc_ = time_ms_utc;
+  const TimeZoneOffsets offsets = time_zone_->GetOffsets(time_ms_utc);
+  const int64 local_time_ms = time_ms_utc + offsets.total_offset_ms();
+  const int64 day = civil::FloorDiv(local_time_ms, civil::kMillisPerDay);
+  const int64 millis_in_day = local_time_ms - day * civil::kMillisPerDay;
+
+  int64 year;
+  int month, day_of_month;
+  civil::CivilFromDays(day, &year, &month, &day_of_month);
+  fields_[YEAR] = year;
+  fields_[MONTH] = month - 1;
+  fields_[DAY_OF_MONTH] = day_of_month;
+  fields_[DAY_OF_YEAR] = day - civil::DaysFromCivil(year, 1, 1) + 1;
+  fields_[DAY_OF_WEEK] = civil::DayOfWeek(day) + kSunday;
+  fields_[HOUR_OF_DAY] = millis_in_day / kMillisPerHour;
+  fields_[MINUTE] = (millis_in_day / kMillisPerMinute) % 60;
+  fields_[SECOND] = (millis_in_day / civil::kMillisPerSecond) % 60;
+  fields_[MILLISECOND] = millis_in_day % civil::kMillisPerSecond;
+  fields_[ZONE_OFFSET] = offsets.raw_offset_ms;
+  fields_[DST_OFFSET] = offsets.dst_offset_ms;
+
+  // Week of the year, as computed by Calendar::computeWeekFields in ICU. The
+  // first and last days of the year can be in a week of the adjacent year.
+  const int day_of_year = fields_[DAY_OF_YEAR];
+  const int day_of_week = fields_[DAY_OF_WEEK];
+  const int relative_day_of_week =
+      civil::FloorMod(day_of_week - first_day_of_week_, 7);
+  const int relative_day_of_week_january_first = civil::FloorMod(
+      day_of_week - day_of_year + 1 - first_day_of_week_, 7);
+  int week_of_year = (day_of_year - 1 + relative_day_of_week_january_first) / 7;
+  if (7 - relative_day_of_week_january_first >= minimal_days_in_first_week_) {
+    ++week_of_year;
+  }
+  int year_of_week_of_year = year;
+  if (week_of_year == 0) {
+    week_of_year =
+        WeekNumber(day_of_year + civil::DaysInYear(year - 1), day_of_week);
+    --year_of_week_of_year;
+  } else {
+    const int last_day_of_year = civil::DaysInYear(year);
+    if (day_of_year >= last_day_of_year - 5) {
+      const int last_relative_day_of_week = civil::FloorMod(
+          relative_day_of_week + last_day_of_year - day_of_year, 7);
+      if (6 - last_relative_day_of_week >= minimal_days_in_first_week_ &&
+          day_of_year + 7 - relative_day_of_week > last_day_of_year) {
+        week_of_year = 1;
+        ++year_of_week_of_year;
+      }
+    }
+  }
+  fields_[WEEK_OF_YEAR] = week_of_year;
+  fields_[YEAR_WOY] = year_of_week_of_year;
+
+  for (int& stamp : stamps_) {
+    stamp = kComputedStamp;
+  }
+  next_stamp_ = kComputedStamp + 1;
+}
+
+int64 CivilCalendar::ComputeDay() const {
+  // Pick the fields that determine the date like ICU's date precedence table:
+  // the most recently set of day of month, day of week (within the week of
+  // the year) and day of year. Setting the year after them selects the day of
+  // month again, but only if that was set too.
+  enum { BY_DAY_OF_MONTH, BY_WEEK_OF_YEAR, BY_DAY_OF_YEAR } resolution =
+      BY_DAY_OF_MONTH;
+  int newest_stamp = stamps_[DAY_OF_MONTH];
+  if (stamps_[DAY_OF_WEEK] > newest_stamp) {
+    resolution = BY_WEEK_OF_YEAR;
+    newest_stamp = stamps_[DAY_OF_WEEK];
+  }
+  if (stamps_[DAY_OF_YEAR] > newest_stamp) {
+    resolution = BY_DAY_OF_YEAR;
+    newest_stamp = stamps_[DAY_OF_YEAR];
+  }
+  if (stamps_[YEAR] > newest_stamp && stamps_[DAY_OF_MONTH] > kComputedStamp) {
+    resolution = BY_DAY_OF_MONTH;
+  }
+
+  switch (resolution) {
+    case BY_DAY_OF_MONTH: {
+      // Out of range months and days roll over into the next ones.
+      const int64 year =
+          fields_[YEAR] + civil::FloorDiv(fields_[MONTH], 12);
+      const int month = civil::FloorMod(fields_[MONTH], 12) + 1;
+      return civil::DaysFromCivil(year, month, 1) + fields_[DAY_OF_MONTH] - 1;
+    }
+    case BY_DAY_OF_YEAR:
+      return civil::DaysFromCivil(fields_[YEAR], 1, 1) +
+             fields_[DAY_OF_YEAR] - 1;
+    case BY_WEEK_OF_YEAR: {
+      // The week is kept, unless a year was set since it was computed.
+      const int64 year = stamps_[YEAR] > stamps_[YEAR_WOY] ? fields_[YEAR]
+                                                           : fields_[YEAR_WOY];
+      const int64 january_first = civil::DaysFromCivil(year, 1, 1);
+      const int first = civil::FloorMod(
+          civil::DayOfWeek(january_first) + kSunday - first_day_of_week_, 7);
+      const int local_day_of_week =
+          civil::FloorMod(fields_[DAY_OF_WEEK] - first_day_of_week_, 7);
+      int date = 1 - first + local_day_of_week;
+      if (7 - first < minimal_days_in_first_week_) {
+        date += 7;
+      }
+      date += 7 * (fields_[WEEK_OF_YEAR] - 1);
+      return january_first - 1 + date;
+    }
+  }
+  return 0;
+}
+
+int64 CivilCalendar::MillisInDay() const {
+  return fields_[HOUR_OF_DAY] * kMillisPerHour +
+         fields_[MINUTE] * kMillisPerMinute +
+         fields_[SECOND] * civil::kMillisPerSecond + fields_[MILLISECOND];
+}
+
+void CivilCalendar::Complete() {
+  if (next_stamp_ == kComputedStamp + 1) {
+    // Nothing was set since the fields were computed.
+    return;
+  }
+  const int64 local_time_ms =
+      ComputeDay() * civil::kMillisPerDay + MillisInDay();
+  if (stamps_[ZONE_OFFSET] > kComputedStamp ||
+      stamps_[DST_OFFSET] > kComputedStamp) {
+    SetTime(local_time_ms - fields_[ZONE_OFFSET] - fields_[DST_OFFSET]);
+  } else {
+    SetTime(local_time_ms -
+            time_zone_->GetOffsetsFromLocal(local_time_ms).total_offset_ms());
+  }
+}
+
+bool CivilCalendar::AddSecond(int value) {
+  if (value == 0) {
+    return true;
+  }
+  Complete();
+  SetTime(time_ms_utc_ + value * civil::kMillisPerSecond);
+  return true;
+}
+
+bool CivilCalendar::AddMinute(int value) {
+  if (value == 0) {
+    return true;
+  }
+  Complete();
+  SetTime(time_ms_utc_ + value * kMillisPerMinute);
+  return true;
+}
+
+bool CivilCalendar::AddHourOfDay(int value) {
+  if (value == 0) {
+    return true;
+  }
+  Complete();
+  SetTime(time_ms_utc_ + value * kMillisPerHour);
+  return true;
+}
+
+bool CivilCalendar::AddDayOfMonth(int value) {
+  if (value == 0) {
+    return true;
+  }
+  Complete();
+
+  // Keep the wall time across daylight saving time changes, like ICU.
+  const int previous_offset = fields_[ZONE_OFFSET] + fields_[DST_OFFSET];
+  const int64 previous_wall_time = MillisInDay();
+  SetTime(time_ms_utc_ + value * civil::kMillisPerDay);
+  int64 wall_time = MillisInDay();
+  if (wall_time == previous_wall_time) {
+    return true;
+  }
+  const int64 time_ms_utc = time_ms_utc_;
+  const int offset = fields_[ZONE_OFFSET] + fields_[DST_OFFSET];
+  if (offset == previous_offset) {
+    return true;
+  }
+  int adjustment = previous_offset - offset;
+  adjustment = adjustment >= 0 ? adjustment % civil::kMillisPerDay
+                               : -(-adjustment % civil::kMillisPerDay);
+  if (adjustment != 0) {
+    SetTime(time_ms_utc + adjustment);
+    wall_time = MillisInDay();
+  }
+  if (wall_time != previous_wall_time && adjustment < 0) {
+    // The wall time was skipped, keep the later time.
+    SetTime(time_ms_utc);
+  }
+  return true;
+}
+
+void CivilCalendar::PinDayOfMonth() {
+  const int64 year = fields_[YEAR] + civil::FloorDiv(fields_[MONTH], 12);
+  const int month = civil::FloorMod(fields_[MONTH], 12) + 1;
+  const int days_in_month = civil::DaysInMonth(year, month);
+  if (fields_[DAY_OF_MONTH] > days_in_month) {
+    Set(DAY_OF_MONTH, days_in_month);
+  }
+}
+
+bool CivilCalendar::AddYear(int value) {
+  if (value == 0) {
+    return true;
+  }
+  Complete();
+  Set(YEAR, fields_[YEAR] + value);
+  PinDayOfMonth();
+  return true;
+}
+
+bool CivilCalendar::AddMonth(int value) {
+  if (value == 0) {
+    return true;
+  }
+  Complete();
+  Set(MONTH, fields_[MONTH] + value);
+  PinDayOfMonth();
+  return true;
+}
+
+bool CivilCalendar::GetDayOfWeek(int* value) {
+  Complete();
+  *value = fields_[DAY_OF_WEEK];
+  return true;
+}
+
+bool CivilCalendar::GetFirstDayOfWeek(int* value) const {
+  *value = first_day_of_week_;
+  return true;
+}
+
+bool CivilCalendar::GetTimeInMillis(int64* value) {
+  Complete();
+  *value = time_ms_utc_;
+  return true;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,153 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Calendar implementation without ICU, on proleptic Gregorian date arithmetic
+// and the tz database files. Emulates the (lenient) field resolution of
+// icu::GregorianCalendar for the operations CalendarLibTempl uses, so that
+// both implementations interpret the dates the same way. Dates before the
+// Gregorian reform (1582) differ, ICU uses the Julian calendar for them.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_CALENDAR_CALENDAR_CIVIL_H_
+#define LIBTEXTCLASSIFIER_UTILS_CALENDAR_CALENDAR_CIVIL_H_
+
+#include <string>
+
+#include "annotator/types.h"
+#include "utils/base/integral_types.h"
+#include "utils/calendar/calendar-common.h"
+#include "utils/calendar/time-zone-table.h"
+
+namespace libtextclassifier3 {
+
+class CivilCalendar {
+ public:
+  explicit CivilCalendar(const TimeZoneDatabase* time_zones)
+      : time_zones_(time_zones) {}
+
+  bool Initialize(const std::string& time_zone, const std::string& locale,
+                  int64 time_ms_utc);
+  bool AddSecond(int value);
+  bool AddMinute(int value);
+  bool AddHourOfDay(int value);
+  bool AddDayOfMonth(int value);
+  bool AddYear(int value);
+  bool AddMonth(int value);
+  bool GetDayOfWeek(int* value);
+  bool GetFirstDayOfWeek(int* value) const;
+  bool GetTimeInMillis(int64* value);
+  bool SetZoneOffset(int value) { return Set(ZONE_OFFSET, value); }
+  bool SetDstOffset(int value) { return Set(DST_OFFSET, value); }
+  bool SetYear(int value) { return Set(YEAR, value); }
+  bool SetMonth(int value) { return Set(MONTH, value); }
+  bool SetDayOfYear(int value) { return Set(DAY_OF_YEAR, value); }
+  bool SetDayOfMonth(int value) { return Set(DAY_OF_MONTH, value); }
+  bool SetDayOfWeek(int value) { return Set(DAY_OF_WEEK, value); }
+  bool SetHourOfDay(int value) { return Set(HOUR_OF_DAY, value); }
+  bool SetMinute(int value) { return Set(MINUTE, value); }
+  bool SetSecond(int value) { return Set(SECOND, value); }
+  bool SetMillisecond(int value) { return Set(MILLISECOND, value); }
+
+ private:
+  // The fields, with the same meaning and ranges as in ICU (e.g. MONTH is
+  // 0-11, DAY_OF_WEEK is kSunday-kSaturday).
+  enum Field {
+    YEAR,
+    MONTH,
+    DAY_OF_MONTH,
+    DAY_OF_YEAR,
+    DAY_OF_WEEK,
+    HOUR_OF_DAY,
+    MINUTE,
+    SECOND,
+    MILLISECOND,
+    ZONE_OFFSET,
+    DST_OFFSET,
+    WEEK_OF_YEAR,
+    YEAR_WOY,
+    NUM_FIELDS,
+  };
+
+  // Like in ICU, fields that were computed from the time have this stamp, the
+  // ones set since have increasing stamps in the order they were set.
+  static constexpr int kComputedStamp = 1;
+
+  bool Set(Field field, int value);
+
+  // Sets the time and recomputes all fields from it.
+  void SetTime(int64 time_ms_utc);
+
+  // Computes the time from the fields set since the last time was set, if
+  // any, resolving them like ICU does.
+  void Complete();
+
+  int64 ComputeDay() const;
+  int WeekNumber(int day_of_period, int day_of_week) const;
+  int64 MillisInDay() const;
+
+  // Clamps the day of month to the length of the month, after changing the
+  // year or month.
+  void PinDayOfMonth();
+
+  const TimeZoneDatabase* const time_zones_;
+  const TimeZoneTable* time_zone_ = nullptr;
+  int first_day_of_week_ = kSunday;
+  int minimal_days_in_first_week_ = 1;
+
+  int64 time_ms_utc_ = 0;
+  int fields_[NUM_FIELDS] = {};
+  int stamps_[NUM_FIELDS] = {};
+  int next_stamp_ = kComputedStamp + 1;
+};
+
+class CivilCalendarLib {
+ public:
+  // 'time_zone_directory' holds the tz database files, named by time zone id,
+  // e.g. "/usr/share/zoneinfo" on Linux or the directory of an app-provided
+  // copy on Android. The interpretation fails for time zones without a file.
+  explicit CivilCalendarLib(const std::string& time_zone_directory)
+      : time_zones_(time_zone_directory) {}
+
+  // Interprets parse_data as milliseconds since_epoch. Relative times are
+  // resolved against the current time (reference_time_ms_utc). Returns true if
+  // the interpratation was successful, false otherwise.
+  bool InterpretParseData(const DatetimeParsedData& parse_data,
+                          int64 reference_time_ms_utc,
+                          const std::string& reference_timezone,
+                          const std::string& reference_locale,
+                          bool prefer_future_for_unspecified_date,
+                          int64* interpreted_time_ms_utc,
+                          DatetimeGranularity* granularity) const {
+    CivilCalendar calendar(&time_zones_);
+    if (!impl_.InterpretParseData(parse_data, reference_time_ms_utc,
+                                  reference_timezone, reference_locale,
+                                  prefer_future_for_unspecified_date, &calendar,
+                                  granularity)) {
+      return false;
+    }
+    return calendar.GetTimeInMillis(interpreted_time_ms_utc);
+  }
+
+  DatetimeGranularity GetGranularity(const DatetimeParsedData& data) const {
+    return impl_.GetGranularity(data);
+  }
+
+ private:
+  TimeZoneDatabase time_zones_;
+  calendar::CalendarLibTempl<CivilCalendar> impl_;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_CALENDAR_CALENDAR_CIVIL_H_
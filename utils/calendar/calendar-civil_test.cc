@@ -0,0 +1,364 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Differential test of CivilCalendarLib against the ICU CalendarLib: both must
+// interpret the same parse data and reference times identically.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "annotator/types.h"
+#include "utils/base/integral_types.h"
+#include "utils/base/macros.h"
+#include "utils/benchmark-data.h"
+#include "utils/calendar/calendar-civil.h"
+#include "utils/calendar/calendar-icu.h"
+#include "utils/calendar/time-zone-table.h"
+#include "gtest/gtest.h"
+#include "unicode/basictz.h"
+#include "unicode/timezone.h"
+#include "unicode/tztrans.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+using ComponentType = DatetimeComponent::ComponentType;
+using RelativeQualifier = DatetimeComponent::RelativeQualifier;
+
+constexpr char kZoneinfoDirectory[] = "/usr/share/zoneinfo";
+constexpr int64 kDayMs = 24 * 3600 * 1000;
+
+// Zones with DST in either hemisphere, non-hour offsets, negative DST and
+// changes of the standard offset.
+constexpr const char* kTimeZones[] = {
+    "Africa/Casablanca", "America/Los_Angeles", "America/New_York",
+    "America/Santiago",  "America/Sao_Paulo",   "America/St_Johns",
+    "Antarctica/Troll",  "Australia/Sydney",    "Europe/London",
+    "Europe/Moscow",     "Europe/Zurich",       "Pacific/Chatham",
+    "UTC",
+};
+
+// Locales with different first days of the week and minimal days in the first
+// week.
+constexpr const char* kLocales[] = {
+    "ar-EG", "de-CH", "en", "en-GB", "en-US", "fr-FR", "ja", "pt-PT", "zh-TW",
+};
+
+// Returns the times of the transitions of the time zone in (from, to)
+// according to ICU.
+std::vector<int64> TransitionTimes(const icu::TimeZone& zone, int64 from,
+                                   int64 to) {
+  std::vector<int64> times;
+  const icu::BasicTimeZone* basic_zone =
+      dynamic_cast<const icu::BasicTimeZone*>(&zone);
+  if (basic_zone == nullptr) {
+    return times;
+  }
+  icu::TimeZoneTransition transition;
+  UDate time = from;
+  while (basic_zone->getNextTransition(time, /*inclusive=*/false,
+                                       transition) &&
+         transition.getTime() < to) {
+    time = transition.getTime();
+    times.push_back(static_cast<int64>(time));
+  }
+  return times;
+}
+
+class CalendarCivilTest : public testing::Test {
+ protected:
+  CalendarCivilTest()
+      : civil_(kZoneinfoDirectory), time_zones_(kZoneinfoDirectory) {}
+
+  void TearDown() override {
+    // The skipped cases only come from differences of the tz database versions
+    // of ICU and the system, which must stay rare.
+    EXPECT_LE(num_skipped_ * 100, num_compared_)
+        << num_skipped_ << " skipped, " << num_compared_ << " compared";
+  }
+
+  // Returns whether ICU and the tz database files agree on the offsets of the
+  // time zone in [from_ms, to_ms], checked at the ends and around each
+  // transition known to ICU.
+  bool DatabasesAgree(const std::string& time_zone, int64 from_ms,
+                      int64 to_ms) const {
+    const TimeZoneTable* table = time_zones_.Get(time_zone);
+    std::unique_ptr<icu::TimeZone> zone(icu::TimeZone::createTimeZone(
+        icu::UnicodeString::fromUTF8(time_zone)));
+    std::vector<int64> times = {from_ms, to_ms};
+    for (const int64 transition : TransitionTimes(*zone, from_ms, to_ms)) {
+      times.push_back(transition - 1);
+      times.push_back(transition);
+    }
+    for (const int64 time : times) {
+      int32_t raw_offset_ms;
+      int32_t dst_offset_ms;
+      UErrorCode status = U_ZERO_ERROR;
+      zone->getOffset(time, /*local=*/false, raw_offset_ms, dst_offset_ms,
+                      status);
+      if (U_FAILURE(status) || raw_offset_ms + dst_offset_ms !=
+                                   table->GetOffsets(time).total_offset_ms()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Expects both calendars to give the same result for the parse data. Skips
+  // the comparison where the tz databases of the two differ.
+  void ExpectSameInterpretation(const DatetimeParsedData& parse_data,
+                                int64 reference_time_ms_utc,
+                                const std::string& time_zone,
+                                const std::string& locale,
+                                bool prefer_future_for_unspecified_date) {
+    int64 icu_time_ms_utc = 0;
+    int64 civil_time_ms_utc = 0;
+    DatetimeGranularity icu_granularity = GRANULARITY_UNKNOWN;
+    DatetimeGranularity civil_granularity = GRANULARITY_UNKNOWN;
+    const bool icu_ok = icu_.InterpretParseData(
+        parse_data, reference_time_ms_utc, time_zone, locale,
+        prefer_future_for_unspecified_date, &icu_time_ms_utc, &icu_granularity);
+    const bool civil_ok = civil_.InterpretParseData(
+        parse_data, reference_time_ms_utc, time_zone, locale,
+        prefer_future_for_unspecified_date, &civil_time_ms_utc,
+        &civil_granularity);
+    const int64 result_ms = icu_ok ? icu_time_ms_utc : reference_time_ms_utc;
+    const int64 from_ms = std::min(reference_time_ms_utc, result_ms) - kDayMs;
+    const int64 to_ms = std::max(reference_time_ms_utc, result_ms) + kDayMs;
+    if (!DatabasesAgree(time_zone, from_ms, to_ms)) {
+      ++num_skipped_;
+      return;
+    }
+    ++num_compared_;
+    ASSERT_EQ(civil_ok, icu_ok)
+        << time_zone << " " << locale << " " << reference_time_ms_utc;
+    EXPECT_EQ(civil_time_ms_utc, icu_time_ms_utc)
+        << time_zone << " " << locale << " " << reference_time_ms_utc;
+    EXPECT_EQ(civil_granularity, icu_granularity)
+        << time_zone << " " << locale << " " << reference_time_ms_utc;
+  }
+
+  CalendarLib icu_;
+  CivilCalendarLib civil_;
+  TimeZoneDatabase time_zones_;
+  int num_compared_ = 0;
+  int num_skipped_ = 0;
+};
+
+// Returns a reference time between 1970 and 2033, with milliseconds.
+int64 RandomReferenceTime(benchmark_data::Random* random) {
+  return static_cast<int64>(random->Uniform(2000000000)) * 1000 +
+         random->Uniform(1000);
+}
+
+// Sets a random subset of the absolute date and time fields.
+void SetRandomAbsoluteFields(benchmark_data::Random* random,
+                             DatetimeParsedData* parse_data) {
+  if (random->Uniform(2) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::YEAR,
+                                 1971 + random->Uniform(60));
+  }
+  if (random->Uniform(2) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::MONTH, 1 + random->Uniform(12));
+  }
+  if (random->Uniform(2) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::DAY_OF_MONTH,
+                                 1 + random->Uniform(31));
+  }
+  if (random->Uniform(2) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::HOUR, random->Uniform(13));
+  }
+  if (random->Uniform(2) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::MINUTE, random->Uniform(60));
+  }
+  if (random->Uniform(3) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::MERIDIEM, random->Uniform(2));
+  }
+  if (random->Uniform(4) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::SECOND, random->Uniform(60));
+  }
+  if (random->Uniform(5) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::ZONE_OFFSET,
+                                 random->Uniform(600) - 300);
+  }
+  if (random->Uniform(7) == 0) {
+    parse_data->SetAbsoluteValue(ComponentType::DST_OFFSET, random->Uniform(2));
+  }
+}
+
+// Sets one random relative field, like "next Tuesday" or "in 3 weeks".
+void SetRandomRelativeField(benchmark_data::Random* random,
+                            DatetimeParsedData* parse_data) {
+  constexpr ComponentType kTypes[] = {
+      ComponentType::DAY_OF_WEEK, ComponentType::DAY_OF_MONTH,
+      ComponentType::WEEK,        ComponentType::MONTH,
+      ComponentType::YEAR,        ComponentType::HOUR,
+      ComponentType::MINUTE,      ComponentType::SECOND,
+  };
+  constexpr RelativeQualifier kQualifiers[] = {
+      RelativeQualifier::NEXT,     RelativeQualifier::THIS,
+      RelativeQualifier::LAST,     RelativeQualifier::NOW,
+      RelativeQualifier::TOMORROW, RelativeQualifier::YESTERDAY,
+      RelativeQualifier::PAST,     RelativeQualifier::FUTURE,
+  };
+  const ComponentType type = kTypes[random->Uniform(8)];
+  const RelativeQualifier qualifier = kQualifiers[random->Uniform(8)];
+  parse_data->SetRelativeValue(type, qualifier);
+  if (qualifier == RelativeQualifier::PAST) {
+    parse_data->SetRelativeCount(type, -1 - random->Uniform(5));
+  } else if (qualifier == RelativeQualifier::FUTURE) {
+    parse_data->SetRelativeCount(type, 1 + random->Uniform(5));
+  }
+  if (type == ComponentType::DAY_OF_WEEK) {
+    parse_data->SetAbsoluteValue(type, kSunday + random->Uniform(7));
+  }
+}
+
+TEST_F(CalendarCivilTest, AbsoluteFieldsMatchIcu) {
+  benchmark_data::Random random(1);
+  for (int i = 0; i < 20000; ++i) {
+    DatetimeParsedData parse_data;
+    SetRandomAbsoluteFields(&random, &parse_data);
+    ExpectSameInterpretation(
+        parse_data, RandomReferenceTime(&random),
+        kTimeZones[random.Uniform(TC3_ARRAYSIZE(kTimeZones))],
+        kLocales[random.Uniform(TC3_ARRAYSIZE(kLocales))],
+        /*prefer_future_for_unspecified_date=*/random.Uniform(2) == 0);
+  }
+}
+
+TEST_F(CalendarCivilTest, RelativeFieldsMatchIcu) {
+  benchmark_data::Random random(2);
+  for (int i = 0; i < 20000; ++i) {
+    DatetimeParsedData parse_data;
+    if (random.Uniform(2) == 0) {
+      SetRandomAbsoluteFields(&random, &parse_data);
+    }
+    SetRandomRelativeField(&random, &parse_data);
+    ExpectSameInterpretation(
+        parse_data, RandomReferenceTime(&random),
+        kTimeZones[random.Uniform(TC3_ARRAYSIZE(kTimeZones))],
+        kLocales[random.Uniform(TC3_ARRAYSIZE(kLocales))],
+        /*prefer_future_for_unspecified_date=*/random.Uniform(2) == 0);
+  }
+}
+
+// Reference times right around the DST and standard offset changes, with
+// dates and relative fields that land in the skipped or repeated hours.
+TEST_F(CalendarCivilTest, TransitionEdgesMatchIcu) {
+  constexpr int64 kFrom = 946684800000;  // 2000-01-01
+  constexpr int64 kTo = 1893456000000;   // 2030-01-01
+  constexpr int64 kHourMs = 3600 * 1000;
+  constexpr int64 kDeltasMs[] = {-2 * kHourMs, -kHourMs, -1, 0,
+                                 1,            kHourMs,  2 * kHourMs};
+  benchmark_data::Random random(3);
+  for (const char* time_zone : kTimeZones) {
+    std::unique_ptr<icu::TimeZone> zone(
+        icu::TimeZone::createTimeZone(icu::UnicodeString(time_zone)));
+    for (const int64 transition : TransitionTimes(*zone, kFrom, kTo)) {
+      for (const int64 delta : kDeltasMs) {
+        const int64 reference_time_ms_utc = transition + delta;
+
+        DatetimeParsedData now;
+        now.SetRelativeValue(ComponentType::DAY_OF_MONTH,
+                             RelativeQualifier::NOW);
+        ExpectSameInterpretation(now, reference_time_ms_utc, time_zone, "en-US",
+                                 /*prefer_future_for_unspecified_date=*/false);
+
+        // Times of day around the local time of the transition.
+        for (int hour = 0; hour < 5; ++hour) {
+          DatetimeParsedData time_of_day;
+          time_of_day.SetAbsoluteValue(ComponentType::HOUR, hour);
+          time_of_day.SetAbsoluteValue(ComponentType::MINUTE, 30);
+          ExpectSameInterpretation(
+              time_of_day, reference_time_ms_utc, time_zone, "en-US",
+              /*prefer_future_for_unspecified_date=*/hour % 2 == 0);
+        }
+
+        DatetimeParsedData relative;
+        SetRandomRelativeField(&random, &relative);
+        ExpectSameInterpretation(
+            relative, reference_time_ms_utc, time_zone,
+            kLocales[random.Uniform(TC3_ARRAYSIZE(kLocales))],
+            /*prefer_future_for_unspecified_date=*/random.Uniform(2) == 0);
+      }
+    }
+  }
+}
+
+TEST_F(CalendarCivilTest, FailsForUnknownTimeZone) {
+  DatetimeParsedData parse_data;
+  parse_data.SetRelativeValue(ComponentType::DAY_OF_MONTH,
+                              RelativeQualifier::NOW);
+  int64 time_ms_utc;
+  DatetimeGranularity granularity;
+  EXPECT_FALSE(civil_.InterpretParseData(
+      parse_data, /*reference_time_ms_utc=*/0, "Mars/Olympus_Mons", "en-US",
+      /*prefer_future_for_unspecified_date=*/false, &time_ms_utc,
+      &granularity));
+  EXPECT_FALSE(civil_.InterpretParseData(
+      parse_data, /*reference_time_ms_utc=*/0, "../zoneinfo/UTC", "en-US",
+      /*prefer_future_for_unspecified_date=*/false, &time_ms_utc,
+      &granularity));
+}
+
+TEST_F(CalendarCivilTest, TimeZoneTablesAreSharedAcrossThreads) {
+  const TimeZoneTable* zurich = time_zones_.Get("Europe/Zurich");
+  ASSERT_NE(zurich, nullptr);
+  // More time zones than a thread caches, so that lookups also go to the
+  // shared tables.
+  const std::vector<std::string> time_zones = {
+      "Europe/Zurich", "America/New_York", "Asia/Tokyo",
+      "Australia/Sydney", "Africa/Cairo", "Europe/Zurich"};
+  std::vector<std::thread> threads;
+  std::vector<const TimeZoneTable*> tables(8 * time_zones.size());
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([this, i, &time_zones, &tables]() {
+      for (int j = 0; j < time_zones.size(); ++j) {
+        tables[i * time_zones.size() + j] = time_zones_.Get(time_zones[j]);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < tables.size(); ++i) {
+    EXPECT_EQ(tables[i], time_zones_.Get(time_zones[i % time_zones.size()]));
+  }
+  EXPECT_EQ(tables[0], zurich);
+
+  // Unknown time zones keep failing, they are not cached.
+  EXPECT_EQ(time_zones_.Get("Mars/Olympus_Mons"), nullptr);
+  EXPECT_EQ(time_zones_.Get("Mars/Olympus_Mons"), nullptr);
+}
+
+TEST(CalendarCivilLibTest, FailsForMissingDirectory) {
+  const CivilCalendarLib civil("/nonexistent/zoneinfo");
+  DatetimeParsedData parse_data;
+  parse_data.SetRelativeValue(ComponentType::DAY_OF_MONTH,
+                              RelativeQualifier::NOW);
+  int64 time_ms_utc;
+  DatetimeGranularity granularity;
+  EXPECT_FALSE(civil.InterpretParseData(
+      parse_data, /*reference_time_ms_utc=*/0, "Europe/Zurich", "en-US",
+      /*prefer_future_for_unspecified_date=*/false, &time_ms_utc,
+      &granularity));
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -16,6 +16,8 @@
 #include "utils/calendar/calendar-icu.h"
 
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include "utils/base/macros.h"
 #include "utils/calendar/calendar-common.h"
@@ -68,19 +70,55 @@ bool CalendarSet(UCalendarDateFields field, int value,
   return true;
 }
 
+// Creates a calendar for the time zone and locale, or clones the one created
+// before on this thread.
+std::unique_ptr<icu::Calendar> CreateCalendar(const std::string& time_zone,
+                                              const std::string& locale) {
+  // The number of distinct time zones and locales seen by a thread is small in
+  // practice; the cache is still bounded in case it is not.
+  static const int kMaxCachedCalendars = 16;
+  static thread_local std::unordered_map<std::string,
+                                         std::unique_ptr<icu::Calendar>>
+      calendars;
+
+  const std::string key = time_zone + '\0' + locale;
+  auto it = calendars.find(key);
+  if (it == calendars.end()) {
+    UErrorCode status = U_ZERO_ERROR;
+    std::unique_ptr<icu::Calendar> calendar(icu::Calendar::createInstance(
+        icu::Locale::createFromName(locale.c_str()), status));
+    if (U_FAILURE(status)) {
+      TC3_LOG(ERROR) << "error getting calendar instance";
+      return nullptr;
+    }
+    calendar->adoptTimeZone(icu::TimeZone::createTimeZone(
+        icu::UnicodeString::fromUTF8(time_zone)));
+    if (calendars.size() >= kMaxCachedCalendars) {
+      calendars.clear();
+    }
+    it = calendars.emplace(key, std::move(calendar)).first;
+  }
+  return std::unique_ptr<icu::Calendar>(it->second->clone());
+}
+
 }  // namespace
 
 bool Calendar::Initialize(const std::string& time_zone,
                           const std::string& locale, int64 time_ms_utc) {
-  UErrorCode status = U_ZERO_ERROR;
-  calendar_.reset(icu::Calendar::createInstance(
-      icu::Locale::createFromName(locale.c_str()), status));
-  if (U_FAILURE(status)) {
-    TC3_LOG(ERROR) << "error getting calendar instance";
-    return false;
+  if (calendar_ != nullptr && time_zone == time_zone_ && locale == locale_) {
+    // Drop the fields set by the previous use.
+    calendar_->clear();
+  } else {
+    calendar_ = CreateCalendar(time_zone, locale);
+    if (calendar_ == nullptr) {
+      time_zone_.clear();
+      locale_.clear();
+      return false;
+    }
+    time_zone_ = time_zone;
+    locale_ = locale;
   }
-  calendar_->adoptTimeZone(
-      icu::TimeZone::createTimeZone(icu::UnicodeString::fromUTF8(time_zone)));
+  UErrorCode status = U_ZERO_ERROR;
   calendar_->setTime(time_ms_utc, status);
   if (U_FAILURE(status)) {
     TC3_LOG(ERROR) << "failed to set time";
@@ -31,6 +31,10 @@ namespace libtextclassifier3 {
 
 class Calendar {
  public:
+  // Sets the calendar to the given time in the time zone and locale. Calling
+  // it again with the same time zone and locale only resets the time, the ICU
+  // objects are reused. For other time zones and locales, the ICU calendar is
+  // cloned from a per-thread cache of calendars when possible.
   bool Initialize(const std::string& time_zone, const std::string& locale,
                   int64 time_ms_utc);
   bool AddSecond(int value) const;
@@ -59,6 +63,10 @@ class Calendar {
   // destructor - meaning that we couldn't use a forward declaration and would
   // have to put the ICU includes in the header.
   std::unique_ptr<icu::Calendar> calendar_;
+
+  // Time zone and locale 'calendar_' was created for.
+  std::string time_zone_;
+  std::string locale_;
 };
 
 class CalendarLib {
@@ -73,7 +81,9 @@ class CalendarLib {
                           bool prefer_future_for_unspecified_date,
                           int64* interpreted_time_ms_utc,
                           DatetimeGranularity* granularity) const {
-    Calendar calendar;
+    // Reused by the interpretations on the same thread, as the dates of a text
+    // are mostly interpreted in the same time zone and locale.
+    static thread_local Calendar calendar;
     if (!impl_.InterpretParseData(parse_data, reference_time_ms_utc,
                                   reference_timezone, reference_locale,
                                   prefer_future_for_unspecified_date, &calendar,
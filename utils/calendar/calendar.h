@@ -16,7 +16,23 @@
 #ifndef LIBTEXTCLASSIFIER_UTILS_CALENDAR_CALENDAR_H_
 #define LIBTEXTCLASSIFIER_UTILS_CALENDAR_CALENDAR_H_
 
+#if defined(TC3_CALENDAR_CIVIL)
+// Calendar without ICU, on the tz database files in the directory given by
+// TC3_CALENDAR_CIVIL_ZONEINFO_DIR. There is no default, as the location differs
+// between platforms, e.g. Android has no /usr/share/zoneinfo.
+#if !defined(TC3_CALENDAR_CIVIL_ZONEINFO_DIR)
+#error "TC3_CALENDAR_CIVIL needs TC3_CALENDAR_CIVIL_ZONEINFO_DIR"
+#endif
+#include "utils/calendar/calendar-civil.h"
+namespace libtextclassifier3 {
+class CalendarLib : public CivilCalendarLib {
+ public:
+  CalendarLib() : CivilCalendarLib(TC3_CALENDAR_CIVIL_ZONEINFO_DIR) {}
+};
+}  // namespace libtextclassifier3
+#else
 #include "utils/calendar/calendar-icu.h"
+#endif
 #define INIT_CALENDARLIB_FOR_TESTING(VAR) VAR()
 
 #endif  // LIBTEXTCLASSIFIER_UTILS_CALENDAR_CALENDAR_H_
@@ -0,0 +1,144 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotator/types.h"
+#include "utils/base/integral_types.h"
+#include "utils/benchmark-data.h"
+#include "utils/calendar/calendar-civil.h"
+#include "utils/calendar/calendar.h"
+#include "benchmark/benchmark.h"
+#include "unicode/calendar.h"
+#include "unicode/timezone.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr int64 kReferenceTimeMsUtc = 1567296000000;  // 2019-09-01
+
+// The tz database files of desktop Linux, where the benchmarks run.
+constexpr char kZoneinfoDirectory[] = "/usr/share/zoneinfo";
+
+// Returns the kinds of dates found in date-heavy texts: absolute dates and
+// times, and relative expressions like "next Tuesday".
+std::vector<DatetimeParsedData> SyntheticParsedDates(int num_dates) {
+  benchmark_data::Random random(42);
+  std::vector<DatetimeParsedData> dates(num_dates);
+  for (DatetimeParsedData& date : dates) {
+    if (random.Uniform(2) == 0) {
+      date.SetAbsoluteValue(DatetimeComponent::ComponentType::YEAR,
+                            2000 + random.Uniform(30));
+      date.SetAbsoluteValue(DatetimeComponent::ComponentType::MONTH,
+                            1 + random.Uniform(12));
+      date.SetAbsoluteValue(DatetimeComponent::ComponentType::DAY_OF_MONTH,
+                            1 + random.Uniform(28));
+      date.SetAbsoluteValue(DatetimeComponent::ComponentType::HOUR,
+                            random.Uniform(24));
+      date.SetAbsoluteValue(DatetimeComponent::ComponentType::MINUTE,
+                            random.Uniform(60));
+    } else {
+      date.SetRelativeValue(DatetimeComponent::ComponentType::DAY_OF_WEEK,
+                            DatetimeComponent::RelativeQualifier::NEXT);
+      date.SetAbsoluteValue(DatetimeComponent::ComponentType::DAY_OF_WEEK,
+                            kSunday + random.Uniform(7));
+    }
+  }
+  return dates;
+}
+
+// Interprets the dates in a single time zone and locale, as for the dates of
+// one text.
+void BM_InterpretParseData(benchmark::State& state) {
+  const CalendarLib calendarlib;
+  const std::vector<DatetimeParsedData> dates =
+      SyntheticParsedDates(state.range(0));
+
+  for (auto _ : state) {
+    for (const DatetimeParsedData& date : dates) {
+      int64 time_ms_utc;
+      DatetimeGranularity granularity;
+      benchmark::DoNotOptimize(calendarlib.InterpretParseData(
+          date, kReferenceTimeMsUtc, "Europe/Zurich", "en-US",
+          /*prefer_future_for_unspecified_date=*/false, &time_ms_utc,
+          &granularity));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * dates.size());
+}
+BENCHMARK(BM_InterpretParseData)->Arg(64);
+
+// Interprets the dates alternating between time zones, so that the calendar
+// has to be replaced for every date.
+void BM_InterpretParseDataAlternatingTimeZones(benchmark::State& state) {
+  const CalendarLib calendarlib;
+  const std::vector<DatetimeParsedData> dates =
+      SyntheticParsedDates(state.range(0));
+  const std::vector<std::string> time_zones = {
+      "Europe/Zurich", "America/Los_Angeles", "Asia/Tokyo"};
+
+  for (auto _ : state) {
+    for (int i = 0; i < dates.size(); ++i) {
+      int64 time_ms_utc;
+      DatetimeGranularity granularity;
+      benchmark::DoNotOptimize(calendarlib.InterpretParseData(
+          dates[i], kReferenceTimeMsUtc, time_zones[i % time_zones.size()],
+          "en-US", /*prefer_future_for_unspecified_date=*/false, &time_ms_utc,
+          &granularity));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * dates.size());
+}
+BENCHMARK(BM_InterpretParseDataAlternatingTimeZones)->Arg(64);
+
+// Same as BM_InterpretParseData, on the calendar without ICU.
+void BM_InterpretParseDataCivil(benchmark::State& state) {
+  const CivilCalendarLib calendarlib(kZoneinfoDirectory);
+  const std::vector<DatetimeParsedData> dates =
+      SyntheticParsedDates(state.range(0));
+
+  for (auto _ : state) {
+    for (const DatetimeParsedData& date : dates) {
+      int64 time_ms_utc;
+      DatetimeGranularity granularity;
+      benchmark::DoNotOptimize(calendarlib.InterpretParseData(
+          date, kReferenceTimeMsUtc, "Europe/Zurich", "en-US",
+          /*prefer_future_for_unspecified_date=*/false, &time_ms_utc,
+          &granularity));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * dates.size());
+}
+BENCHMARK(BM_InterpretParseDataCivil)->Arg(64);
+
+// The cost of creating an ICU calendar from scratch, which the cached
+// calendars avoid for each date.
+void BM_CreateIcuCalendar(benchmark::State& state) {
+  for (auto _ : state) {
+    UErrorCode status = U_ZERO_ERROR;
+    std::unique_ptr<icu::Calendar> calendar(icu::Calendar::createInstance(
+        icu::Locale::createFromName("en-US"), status));
+    calendar->adoptTimeZone(icu::TimeZone::createTimeZone(
+        icu::UnicodeString::fromUTF8("Europe/Zurich")));
+    calendar->setTime(kReferenceTimeMsUtc, status);
+    benchmark::DoNotOptimize(calendar.get());
+  }
+}
+BENCHMARK(BM_CreateIcuCalendar);
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -0,0 +1,535 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "utils/calendar/time-zone-table.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include "utils/base/logging.h"
+#include "utils/calendar/civil-date.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr int kTzifHeaderSize = 44;
+constexpr int kTzifTypeSize = 6;
+constexpr int64 kSecondsPerDay = 24 * 60 * 60;
+
+// Ids of the time zone databases, see TimeZoneDatabase::Get.
+std::atomic<int64> next_database_id(0);
+
+// Largest daylight saving offset in use, as a sanity bound when deriving it.
+constexpr int kMaxSavingSeconds = 3 * 60 * 60;
+
+uint32 ReadBigEndian32(const char* data) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  return (static_cast<uint32>(bytes[0]) << 24) |
+         (static_cast<uint32>(bytes[1]) << 16) |
+         (static_cast<uint32>(bytes[2]) << 8) | static_cast<uint32>(bytes[3]);
+}
+
+int64 ReadBigEndian64(const char* data) {
+  return static_cast<int64>(
+      (static_cast<uint64>(ReadBigEndian32(data)) << 32) |
+      ReadBigEndian32(data + 4));
+}
+
+// Counts of the entries of a TZif data block, in header order.
+struct TzifCounts {
+  int64 isutcnt;
+  int64 isstdcnt;
+  int64 leapcnt;
+  int64 timecnt;
+  int64 typecnt;
+  int64 charcnt;
+
+  int64 DataSize(int time_size) const {
+    return timecnt * time_size + timecnt + typecnt * kTzifTypeSize + charcnt +
+           leapcnt * (time_size + 4) + isstdcnt + isutcnt;
+  }
+};
+
+bool ReadTzifHeader(const char* data, int64 size, TzifCounts* counts,
+                    char* version) {
+  if (size < kTzifHeaderSize || std::memcmp(data, "TZif", 4) != 0) {
+    return false;
+  }
+  *version = data[4];
+  const char* count = data + 20;
+  counts->isutcnt = ReadBigEndian32(count);
+  counts->isstdcnt = ReadBigEndian32(count + 4);
+  counts->leapcnt = ReadBigEndian32(count + 8);
+  counts->timecnt = ReadBigEndian32(count + 12);
+  counts->typecnt = ReadBigEndian32(count + 16);
+  counts->charcnt = ReadBigEndian32(count + 20);
+  return true;
+}
+
+// Reader of the parts of a POSIX TZ string.
+class PosixTzReader {
+ public:
+  explicit PosixTzReader(StringPiece spec)
+      : pos_(spec.data()), end_(spec.data() + spec.size()) {}
+
+  bool AtEnd() const { return pos_ == end_; }
+
+  bool Peek(char c) const { return pos_ < end_ && *pos_ == c; }
+
+  bool Consume(char c) {
+    if (pos_ < end_ && *pos_ == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  // Abbreviation, e.g. "CET" or "<+03>".
+  bool ReadName() {
+    if (Consume('<')) {
+      while (pos_ < end_ && *pos_ != '>') {
+        ++pos_;
+      }
+      return Consume('>');
+    }
+    const char* start = pos_;
+    while (pos_ < end_ && ((*pos_ >= 'a' && *pos_ <= 'z') ||
+                           (*pos_ >= 'A' && *pos_ <= 'Z'))) {
+      ++pos_;
+    }
+    return pos_ - start >= 3;
+  }
+
+  bool ReadNumber(int* value) {
+    if (pos_ == end_ || *pos_ < '0' || *pos_ > '9') {
+      return false;
+    }
+    *value = 0;
+    while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9' && *value < 1000) {
+      *value = *value * 10 + (*pos_ - '0');
+      ++pos_;
+    }
+    return true;
+  }
+
+  // [+-]hh[:mm[:ss]], in seconds.
+  bool ReadTime(int* seconds) {
+    int sign = 1;
+    if (Consume('-')) {
+      sign = -1;
+    } else {
+      Consume('+');
+    }
+    int hours, minutes = 0, secs = 0;
+    if (!ReadNumber(&hours)) {
+      return false;
+    }
+    if (Consume(':')) {
+      if (!ReadNumber(&minutes)) {
+        return false;
+      }
+      if (Consume(':') && !ReadNumber(&secs)) {
+        return false;
+      }
+    }
+    *seconds = sign * (hours * 3600 + minutes * 60 + secs);
+    return true;
+  }
+
+  bool ReadDate(PosixTimeZoneRule::Date* date) {
+    if (Consume('M')) {
+      date->kind = PosixTimeZoneRule::Date::MONTH_WEEK_DAY;
+      if (!ReadNumber(&date->month) || !Consume('.') ||
+          !ReadNumber(&date->week) || !Consume('.') ||
+          !ReadNumber(&date->day)) {
+        return false;
+      }
+      if (date->month < 1 || date->month > 12 || date->week < 1 ||
+          date->week > 5 || date->day > 6) {
+        return false;
+      }
+    } else if (Consume('J')) {
+      date->kind = PosixTimeZoneRule::Date::JULIAN_DAY;
+      if (!ReadNumber(&date->day) || date->day < 1 || date->day > 365) {
+        return false;
+      }
+    } else {
+      date->kind = PosixTimeZoneRule::Date::DAY_OF_YEAR;
+      if (!ReadNumber(&date->day) || date->day > 365) {
+        return false;
+      }
+    }
+    if (Consume('/')) {
+      return ReadTime(&date->time_s);
+    }
+    return true;
+  }
+
+ private:
+  const char* pos_;
+  const char* const end_;
+};
+
+// Returns the day since epoch the rule date falls on in the year.
+int64 RuleDay(int64 year, const PosixTimeZoneRule::Date& date) {
+  const int64 january_first = civil::DaysFromCivil(year, 1, 1);
+  switch (date.kind) {
+    case PosixTimeZoneRule::Date::JULIAN_DAY:
+      return january_first + date.day - 1 +
+             (civil::IsLeapYear(year) && date.day >= 60 ? 1 : 0);
+    case PosixTimeZoneRule::Date::DAY_OF_YEAR:
+      return january_first + date.day;
+    case PosixTimeZoneRule::Date::MONTH_WEEK_DAY: {
+      const int64 month_first = civil::DaysFromCivil(year, date.month, 1);
+      int day = civil::FloorMod(date.day - civil::DayOfWeek(month_first), 7) +
+                7 * (date.week - 1);
+      while (day >= civil::DaysInMonth(year, date.month)) {
+        day -= 7;
+      }
+      return month_first + day;
+    }
+  }
+  return january_first;
+}
+
+}  // namespace
+
+bool PosixTimeZoneRule::Parse(StringPiece spec, PosixTimeZoneRule* rule) {
+  PosixTzReader reader(spec);
+  int std_offset;
+  if (!reader.ReadName() || !reader.ReadTime(&std_offset)) {
+    return false;
+  }
+  // POSIX offsets are positive west of Greenwich.
+  rule->std_offset_s = -std_offset;
+  rule->has_dst = false;
+  if (reader.AtEnd()) {
+    return true;
+  }
+
+  if (!reader.ReadName()) {
+    return false;
+  }
+  rule->has_dst = true;
+  rule->dst_offset_s = rule->std_offset_s + 3600;
+  if (!reader.AtEnd() && !reader.Peek(',')) {
+    int dst_offset;
+    if (!reader.ReadTime(&dst_offset)) {
+      return false;
+    }
+    rule->dst_offset_s = -dst_offset;
+  }
+  if (reader.AtEnd()) {
+    // No rule given, POSIX implementations default to the US rules.
+    rule->dst_start = Date();
+    rule->dst_start.month = 3;
+    rule->dst_start.week = 2;
+    rule->dst_end = Date();
+    rule->dst_end.month = 11;
+    rule->dst_end.week = 1;
+    return true;
+  }
+  return reader.Consume(',') && reader.ReadDate(&rule->dst_start) &&
+         reader.Consume(',') && reader.ReadDate(&rule->dst_end) &&
+         reader.AtEnd();
+}
+
+TimeZoneOffsets PosixTimeZoneRule::GetOffsets(int64 time_s) const {
+  TimeZoneOffsets offsets;
+  offsets.raw_offset_ms = std_offset_s * civil::kMillisPerSecond;
+  if (!has_dst) {
+    return offsets;
+  }
+
+  int64 year;
+  int month, day;
+  civil::CivilFromDays(
+      civil::FloorDiv(time_s + std_offset_s, kSecondsPerDay), &year, &month,
+      &day);
+  const int64 start = RuleDay(year, dst_start) * kSecondsPerDay +
+                      dst_start.time_s - std_offset_s;
+  const int64 end = RuleDay(year, dst_end) * kSecondsPerDay + dst_end.time_s -
+                    dst_offset_s;
+  const bool is_dst = start < end ? (time_s >= start && time_s < end)
+                                  : (time_s < end || time_s >= start);
+  const int saving_s = dst_offset_s - std_offset_s;
+  if (saving_s < 0) {
+    // Like for the transitions, a negative saving is reported the other way
+    // round.
+    offsets.raw_offset_ms = dst_offset_s * civil::kMillisPerSecond;
+    if (!is_dst) {
+      offsets.dst_offset_ms = -saving_s * civil::kMillisPerSecond;
+    }
+  } else if (is_dst) {
+    offsets.dst_offset_ms = saving_s * civil::kMillisPerSecond;
+  }
+  return offsets;
+}
+
+std::unique_ptr<TimeZoneTable> TimeZoneTable::FromFile(
+    const std::string& filename) {
+  std::unique_ptr<ScopedMmap> mmap(new ScopedMmap(filename));
+  if (!mmap->handle().ok()) {
+    return nullptr;
+  }
+  const char* data = reinterpret_cast<const char*>(mmap->handle().start());
+  const int64 size = mmap->handle().num_bytes();
+
+  // Skip the version 1 block with 32-bit times, the version 2 block that
+  // follows has the same layout with 64-bit times.
+  TzifCounts counts;
+  char version;
+  if (!ReadTzifHeader(data, size, &counts, &version) || version < '2') {
+    TC3_LOG(ERROR) << "Not a TZif file of version 2 or later: " << filename;
+    return nullptr;
+  }
+  const int64 v2_offset = kTzifHeaderSize + counts.DataSize(/*time_size=*/4);
+  if (v2_offset > size ||
+      !ReadTzifHeader(data + v2_offset, size - v2_offset, &counts, &version) ||
+      v2_offset + kTzifHeaderSize + counts.DataSize(/*time_size=*/8) > size ||
+      counts.typecnt == 0) {
+    TC3_LOG(ERROR) << "Invalid TZif file: " << filename;
+    return nullptr;
+  }
+
+  std::unique_ptr<TimeZoneTable> table(new TimeZoneTable());
+  const char* block = data + v2_offset + kTzifHeaderSize;
+  table->transition_times_ = block;
+  table->num_transitions_ = counts.timecnt;
+  const uint8* transition_types =
+      reinterpret_cast<const uint8*>(block + counts.timecnt * 8);
+  const char* types = block + counts.timecnt * 9;
+  for (int i = 0; i < counts.timecnt; ++i) {
+    if (transition_types[i] >= counts.typecnt) {
+      TC3_LOG(ERROR) << "Invalid TZif file: " << filename;
+      return nullptr;
+    }
+  }
+
+  // The local time type of each period, the first one is before the first
+  // transition.
+  std::vector<int> total_offsets_s(counts.timecnt + 1);
+  std::vector<bool> is_dst(counts.timecnt + 1);
+  for (int i = 0; i <= counts.timecnt; ++i) {
+    const char* type =
+        types + (i == 0 ? 0 : transition_types[i - 1]) * kTzifTypeSize;
+    total_offsets_s[i] = static_cast<int32>(ReadBigEndian32(type));
+    is_dst[i] = type[4] != 0;
+  }
+
+  // Derive the raw offsets of the daylight saving periods from the standard
+  // time before them, or after them if that does not give a plausible saving,
+  // e.g. when a zone moves across the date line during daylight saving time.
+  std::vector<int> raw_offsets_s(total_offsets_s);
+  auto is_plausible_saving = [](int saving_s) {
+    return saving_s != 0 && std::abs(saving_s) <= kMaxSavingSeconds;
+  };
+  int last_std = -1;
+  for (int i = 0; i <= counts.timecnt; ++i) {
+    if (!is_dst[i]) {
+      last_std = i;
+      continue;
+    }
+    int next_std = i + 1;
+    while (next_std <= counts.timecnt && is_dst[next_std]) {
+      ++next_std;
+    }
+    if (next_std <= counts.timecnt &&
+        (last_std < 0 || (!is_plausible_saving(total_offsets_s[i] -
+                                               total_offsets_s[last_std]) &&
+                          is_plausible_saving(total_offsets_s[i] -
+                                              total_offsets_s[next_std])))) {
+      raw_offsets_s[i] = total_offsets_s[next_std];
+    } else if (last_std >= 0) {
+      raw_offsets_s[i] = total_offsets_s[last_std];
+    }
+  }
+
+  // A negative saving (e.g. winter time in Europe/Dublin) is reported by ICU
+  // as standard time, with the standard times around it as the saving. Unless
+  // those lasted for over a year, then they are a real standard time.
+  auto lasts_over_a_year = [&table](int period) {
+    return period > 0 && period < table->num_transitions_ &&
+           table->TransitionTime(period) - table->TransitionTime(period - 1) >
+               366 * kSecondsPerDay;
+  };
+  std::vector<int> flipped_raw_offsets_s(raw_offsets_s);
+  for (int i = 0; i <= counts.timecnt; ++i) {
+    if (!is_dst[i] || raw_offsets_s[i] <= total_offsets_s[i]) {
+      continue;
+    }
+    flipped_raw_offsets_s[i] = total_offsets_s[i];
+    for (const int neighbour : {i - 1, i + 1}) {
+      if (neighbour >= 0 && neighbour <= counts.timecnt &&
+          !is_dst[neighbour] && !lasts_over_a_year(neighbour)) {
+        flipped_raw_offsets_s[neighbour] = total_offsets_s[i];
+      }
+    }
+  }
+  raw_offsets_s.swap(flipped_raw_offsets_s);
+
+  table->offsets_.resize(counts.timecnt + 1);
+  for (int i = 0; i <= counts.timecnt; ++i) {
+    table->offsets_[i].raw_offset_ms =
+        raw_offsets_s[i] * civil::kMillisPerSecond;
+    table->offsets_[i].dst_offset_ms =
+        (total_offsets_s[i] - raw_offsets_s[i]) * civil::kMillisPerSecond;
+  }
+
+  // The footer holds the rule for the times after the last transition.
+  const char* footer = block + counts.DataSize(/*time_size=*/8);
+  const char* data_end = data + size;
+  if (footer < data_end && *footer == '\n') {
+    const char* footer_end = static_cast<const char*>(
+        std::memchr(footer + 1, '\n', data_end - footer - 1));
+    if (footer_end != nullptr && footer_end > footer + 1) {
+      table->has_rule_ = PosixTimeZoneRule::Parse(
+          StringPiece(footer + 1, footer_end - footer - 1), &table->rule_);
+    }
+  }
+
+  table->mmap_ = std::move(mmap);
+  return table;
+}
+
+int64 TimeZoneTable::TransitionTime(int index) const {
+  return ReadBigEndian64(transition_times_ + index * 8);
+}
+
+TimeZoneOffsets TimeZoneTable::GetOffsetsAtSecond(int64 time_s) const {
+  if (num_transitions_ == 0 || time_s < TransitionTime(0)) {
+    if (num_transitions_ == 0 && has_rule_) {
+      return rule_.GetOffsets(time_s);
+    }
+    return offsets_[0];
+  }
+  if (has_rule_ && time_s >= TransitionTime(num_transitions_ - 1)) {
+    return rule_.GetOffsets(time_s);
+  }
+
+  // Find the last transition at or before the time.
+  int low = 0;
+  int high = num_transitions_ - 1;
+  while (low < high) {
+    const int mid = low + (high - low + 1) / 2;
+    if (TransitionTime(mid) <= time_s) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return offsets_[low + 1];
+}
+
+TimeZoneOffsets TimeZoneTable::GetOffsets(int64 time_ms_utc) const {
+  return GetOffsetsAtSecond(
+      civil::FloorDiv(time_ms_utc, civil::kMillisPerSecond));
+}
+
+TimeZoneOffsets TimeZoneTable::GetOffsetsFromLocal(int64 local_time_ms) const {
+  // Offsets never exceed a day, so the offsets at a day before and after the
+  // local time read as UTC bracket the ones that apply. Transitions are
+  // months apart, there is at most one in between.
+  const int64 local_time_s =
+      civil::FloorDiv(local_time_ms, civil::kMillisPerSecond);
+  const TimeZoneOffsets before =
+      GetOffsetsAtSecond(local_time_s - kSecondsPerDay);
+  const TimeZoneOffsets after =
+      GetOffsetsAtSecond(local_time_s + kSecondsPerDay);
+  if (before == after) {
+    return before;
+  }
+
+  // Find the transition, the first second with the offsets after it.
+  int64 low = local_time_s - kSecondsPerDay;
+  int64 high = local_time_s + kSecondsPerDay;
+  while (high - low > 1) {
+    const int64 mid = low + (high - low) / 2;
+    if (GetOffsetsAtSecond(mid) == before) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+
+  // Wall times before the transition in the new offsets are either before
+  // the transition, or skipped by it; both use the offsets before.
+  const int64 transition_local_ms =
+      high * civil::kMillisPerSecond + after.total_offset_ms();
+  return local_time_ms < transition_local_ms ? before : after;
+}
+
+TimeZoneDatabase::TimeZoneDatabase(const std::string& directory)
+    : directory_(directory), id_(next_database_id.fetch_add(1)) {}
+
+const TimeZoneTable* TimeZoneDatabase::Get(const std::string& time_zone) const {
+  // Calendars are initialized with the same few time zones over and over,
+  // look them up in a small per-thread cache first, without locking. The
+  // tables are kept as long as the database, and the database ids are never
+  // reused, so the cached pointers can't outlive their tables.
+  struct CachedTimeZone {
+    int64 database_id = -1;
+    std::string time_zone;
+    const TimeZoneTable* table = nullptr;
+  };
+  static thread_local CachedTimeZone cache[kThreadCacheSize];
+  static thread_local int next_cache_index = 0;
+  for (const CachedTimeZone& cached : cache) {
+    if (cached.database_id == id_ && cached.time_zone == time_zone) {
+      return cached.table;
+    }
+  }
+
+  const TimeZoneTable* table = Load(time_zone);
+  if (table != nullptr) {
+    CachedTimeZone& cached = cache[next_cache_index];
+    next_cache_index = (next_cache_index + 1) % kThreadCacheSize;
+    cached.database_id = id_;
+    cached.time_zone = time_zone;
+    cached.table = table;
+  }
+  return table;
+}
+
+const TimeZoneTable* TimeZoneDatabase::Load(
+    const std::string& time_zone) const {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = time_zones_.find(time_zone);
+    if (it != time_zones_.end()) {
+      return it->second.get();
+    }
+  }
+
+  // Read the file without holding the lock. Only read files inside the
+  // directory.
+  std::unique_ptr<TimeZoneTable> table;
+  if (!time_zone.empty() && time_zone[0] != '/' &&
+      time_zone.find("..") == std::string::npos) {
+    table = TimeZoneTable::FromFile(directory_ + "/" + time_zone);
+  }
+  if (table == nullptr) {
+    // Not cached, so that arbitrary names can't grow the database.
+    TC3_LOG(ERROR) << "Unknown time zone: " << time_zone;
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Keeps the table of another thread that loaded the same time zone first.
+  return time_zones_.emplace(time_zone, std::move(table)).first->second.get();
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Time zone offsets read from the compiled tz database (TZif files, RFC 8536,
+// as found in /usr/share/zoneinfo), without ICU.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_CALENDAR_TIME_ZONE_TABLE_H_
+#define LIBTEXTCLASSIFIER_UTILS_CALENDAR_TIME_ZONE_TABLE_H_
+
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/memory/mmap.h"
+#include "utils/strings/stringpiece.h"
+
+namespace libtextclassifier3 {
+
+// Offsets of the local time from UTC, split like in ICU into the raw (standard
+// time) offset and the daylight saving offset.
+struct TimeZoneOffsets {
+  int raw_offset_ms = 0;
+  int dst_offset_ms = 0;
+
+  int total_offset_ms() const { return raw_offset_ms + dst_offset_ms; }
+
+  bool operator==(const TimeZoneOffsets& other) const {
+    return raw_offset_ms == other.raw_offset_ms &&
+           dst_offset_ms == other.dst_offset_ms;
+  }
+};
+
+// Daylight saving time rule of a POSIX TZ string, e.g.
+// "CET-1CEST,M3.5.0,M10.5.0/3". Used for the times after the last transition
+// of a table.
+struct PosixTimeZoneRule {
+  // A day of the year a rule switches on.
+  struct Date {
+    enum Kind {
+      // Day 'day' (1-365) of the year, never counting February 29.
+      JULIAN_DAY,
+      // Day 'day' (0-365) of the year, counting February 29.
+      DAY_OF_YEAR,
+      // Day of week 'day' (0 = Sunday) of week 'week' (1-5, 5 = last) of
+      // month 'month' (1-12).
+      MONTH_WEEK_DAY,
+    };
+    Kind kind = MONTH_WEEK_DAY;
+    int month = 0;
+    int week = 0;
+    int day = 0;
+
+    // Local time of day of the switch, in seconds. Can be negative or larger
+    // than a day.
+    int time_s = 2 * 60 * 60;
+  };
+
+  int std_offset_s = 0;
+  bool has_dst = false;
+  int dst_offset_s = 0;
+  Date dst_start;
+  Date dst_end;
+
+  // Parses the rule, returns false if it is not a valid POSIX TZ string.
+  static bool Parse(StringPiece spec, PosixTimeZoneRule* rule);
+
+  TimeZoneOffsets GetOffsets(int64 time_s) const;
+};
+
+// Offsets of a time zone at any instant. The transition times are read
+// directly from the memory mapped TZif file.
+// NOTE: Immutable and thus thread-safe.
+class TimeZoneTable {
+ public:
+  // Returns null if the file does not exist or is not a valid TZif file of
+  // version 2 or later.
+  static std::unique_ptr<TimeZoneTable> FromFile(const std::string& filename);
+
+  // Offsets in effect at the given instant.
+  TimeZoneOffsets GetOffsets(int64 time_ms_utc) const;
+
+  // Offsets to convert the given local (wall) time to UTC. As in ICU's
+  // defaults, wall times skipped by a transition are interpreted with the
+  // offsets before the transition, and repeated wall times with the offsets
+  // after it.
+  TimeZoneOffsets GetOffsetsFromLocal(int64 local_time_ms) const;
+
+ private:
+  TimeZoneTable() = default;
+
+  // Offsets in effect at the given second.
+  TimeZoneOffsets GetOffsetsAtSecond(int64 time_s) const;
+
+  int64 TransitionTime(int index) const;
+
+  std::unique_ptr<ScopedMmap> mmap_;
+
+  // Big endian 64-bit transition times in seconds since epoch, pointing into
+  // the mmap.
+  const char* transition_times_ = nullptr;
+  int num_transitions_ = 0;
+
+  // Offsets before the first transition and after each transition. The tz
+  // database only records the total offset and whether it is daylight saving
+  // time, the raw offset of the daylight saving periods is taken from the
+  // standard time around them.
+  std::vector<TimeZoneOffsets> offsets_;
+
+  // Rule for the times after the last transition, if the file has one.
+  bool has_rule_ = false;
+  PosixTimeZoneRule rule_;
+};
+
+// Loads the tables of the time zones from a directory in the layout of
+// /usr/share/zoneinfo on first use and keeps them. Lookups of recently used
+// time zones don't lock or allocate; unknown time zones are not cached.
+// NOTE: Thread-safe.
+class TimeZoneDatabase {
+ public:
+  explicit TimeZoneDatabase(const std::string& directory);
+
+  // Returns the table of a time zone by its id, e.g. "Europe/Zurich", or null
+  // if the directory has no valid file for it. Unknown time zones are not
+  // treated as UTC, as that would silently shift all the times.
+  const TimeZoneTable* Get(const std::string& time_zone) const;
+
+ private:
+  // Number of time zones each thread looks up without locking.
+  static constexpr int kThreadCacheSize = 4;
+
+  // Returns the table of a time zone, loading it if needed.
+  const TimeZoneTable* Load(const std::string& time_zone) const;
+
+  const std::string directory_;
+
+  // Unique id of the database, for the per-thread caches.
+  const int64 id_;
+
+  mutable std::mutex mutex_;
+  mutable std::unordered_map<std::string, std::unique_ptr<TimeZoneTable>>
+      time_zones_;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_CALENDAR_TIME_ZONE_TABLE_H_
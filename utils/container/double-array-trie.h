@@ -16,11 +16,11 @@
 #ifndef LIBTEXTCLASSIFIER_UTILS_CONTAINER_DOUBLE_ARRAY_TRIE_H_
 #define LIBTEXTCLASSIFIER_UTILS_CONTAINER_DOUBLE_ARRAY_TRIE_H_
 
-#include <functional>
 #include <vector>
 
 #include "utils/base/endian.h"
 #include "utils/base/integral_types.h"
+#include "utils/base/logging.h"
 #include "utils/container/string-set.h"
 #include "utils/strings/stringpiece.h"
 
@@ -51,6 +51,12 @@ class DoubleArrayTrie : public StringSet {
   bool LongestPrefixMatch(StringPiece input,
                           Match* longest_match) const override;
 
+  // Calls 'visitor' with each Match that is a prefix of 'input', in order of
+  // increasing length. Unlike the methods above, the visitor is inlined and
+  // nothing is allocated. Returns false if the trie is malformed.
+  template <typename Visitor>
+  bool GatherPrefixMatches(StringPiece input, Visitor&& visitor) const;
+
  private:
   // Returns whether a node as a leaf as a child.
   bool has_leaf(uint32 i) const { return nodes_[i] & 0x100; }
@@ -72,13 +78,44 @@ class DoubleArrayTrie : public StringSet {
     return (node >> 10) << ((node & 0x200) >> 6);
   }
 
-  bool GatherPrefixMatches(StringPiece input,
-                           const std::function<void(Match)>& update_fn) const;
-
   const TrieNode* nodes_;
   const int nodes_length_;
 };
 
+template <typename Visitor>
+bool DoubleArrayTrie::GatherPrefixMatches(StringPiece input,
+                                          Visitor&& visitor) const {
+  uint32 pos = 0;
+  if (nodes_length_ == 0) {
+    TC3_LOG(WARNING) << "Trie is empty. Skipping.";
+    return true;
+  }
+  pos = offset(0);
+  for (int i = 0; i < input.size(); i++) {
+    if (input[i] == 0) {
+      break;
+    }
+    pos ^= static_cast<unsigned char>(input[i]);
+    // We exhausted the trie, no more matches possible.
+    if (pos < 0 || pos >= nodes_length_) {
+      break;
+    }
+    if (label(pos) != input[i]) {
+      break;
+    }
+    const bool node_has_leaf = has_leaf(pos);
+    pos ^= offset(pos);
+    if (pos < 0 || pos > nodes_length_) {
+      TC3_LOG(ERROR) << "Out-of-bounds trie search position.";
+      return false;
+    }
+    if (node_has_leaf) {
+      visitor(Match(/*id=*/value(pos), /*match_length=*/i + 1));
+    }
+  }
+  return true;
+}
+
 }  // namespace libtextclassifier3
 
 #endif  // LIBTEXTCLASSIFIER_UTILS_CONTAINER_DOUBLE_ARRAY_TRIE_H_
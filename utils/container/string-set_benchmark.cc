@@ -0,0 +1,247 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/benchmark-data.h"
+#include "utils/container/double-array-trie.h"
+#include "utils/container/sorted-strings-table.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+// Backing storage of a SortedStringsTable.
+struct SortedStrings {
+  explicit SortedStrings(std::vector<std::string> strings) {
+    std::sort(strings.begin(), strings.end());
+    for (const std::string& value : strings) {
+      offsets.push_back(pieces.size());
+      pieces.append(value);
+      pieces.push_back('\0');
+    }
+  }
+
+  std::vector<uint32> offsets;
+  std::string pieces;
+};
+
+// Builds the nodes of a double array trie in the format read by
+// DoubleArrayTrie (compatible with Darts::DoubleArray) for little endian hosts.
+// The id of a string is its index in 'strings'.
+class DoubleArrayTrieBuilder {
+ public:
+  explicit DoubleArrayTrieBuilder(const std::vector<std::string>& strings) {
+    // The root is at index 0.
+    nodes_.push_back(0);
+    for (int i = 0; i < strings.size(); ++i) {
+      Node* node = &root_;
+      for (const char c : strings[i]) {
+        std::unique_ptr<Node>& child = node->children[static_cast<uint8>(c)];
+        if (child == nullptr) {
+          child.reset(new Node);
+        }
+        node = child.get();
+      }
+      node->id = i;
+    }
+    const uint32 root_base = Place(root_);
+    SetNode(0, root_base << 10);
+  }
+
+  const std::vector<TrieNode>& nodes() const { return nodes_; }
+
+ private:
+  struct Node {
+    std::map<uint8, std::unique_ptr<Node>> children;
+    int id = -1;
+  };
+
+  static constexpr uint32 kLeafBit = 0x80000000;
+  static constexpr uint32 kHasLeafBit = 0x100;
+
+  // Makes sure that 'index' is inside of the array.
+  void Grow(uint32 index) {
+    while (index >= nodes_.size()) {
+      free_slots_.insert(nodes_.size());
+      nodes_.push_back(0);
+    }
+  }
+
+  void SetNode(uint32 index, uint32 value) {
+    Grow(index);
+    nodes_[index] = value;
+    free_slots_.erase(index);
+  }
+
+  bool IsFree(uint32 index) const {
+    return index >= nodes_.size() || free_slots_.count(index) > 0;
+  }
+
+  bool Fits(const Node& node, uint32 base) const {
+    // A base can only be used once, otherwise the children of one node would
+    // be found when looking up a label in the other one.
+    if (base == 0 || used_bases_.count(base) > 0) {
+      return false;
+    }
+    if (node.id >= 0 && !IsFree(base)) {
+      return false;
+    }
+    for (const auto& child : node.children) {
+      if (!IsFree(base ^ child.first)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Places the children (and the leaf) of 'node' and returns their base.
+  uint32 Place(const Node& node) {
+    // Try the bases that put the first label into a free slot, first the holes
+    // in the array, then past its end.
+    const uint8 first_label = node.id >= 0 ? 0 : node.children.begin()->first;
+    uint32 base = 0;
+    for (const uint32 slot : free_slots_) {
+      if (Fits(node, slot ^ first_label)) {
+        base = slot ^ first_label;
+        break;
+      }
+    }
+    for (uint32 slot = nodes_.size(); base == 0; ++slot) {
+      if (Fits(node, slot ^ first_label)) {
+        base = slot ^ first_label;
+      }
+    }
+
+    // The lookup checks the bases against the size of the array.
+    Grow(base);
+    // Reserve the slots before placing the descendants.
+    used_bases_.insert(base);
+    if (node.id >= 0) {
+      SetNode(base, kLeafBit | node.id);
+    }
+    for (const auto& child : node.children) {
+      SetNode(base ^ child.first, 0);
+    }
+
+    for (const auto& child : node.children) {
+      const uint32 index = base ^ child.first;
+      const uint32 child_base = Place(*child.second);
+      SetNode(index, child.first |
+                         (child.second->id >= 0 ? kHasLeafBit : 0) |
+                         ((index ^ child_base) << 10));
+    }
+    return base;
+  }
+
+  Node root_;
+  std::vector<TrieNode> nodes_;
+
+  // Unused indices in 'nodes_'.
+  std::set<uint32> free_slots_;
+
+  std::unordered_set<uint32> used_bases_;
+};
+
+// Inputs to look up: half of them start with one of the strings.
+std::vector<std::string> LookupInputs(const std::vector<std::string>& strings) {
+  const std::vector<std::string> suffixes = benchmark_data::SyntheticStrings(
+      /*num_strings=*/1000, /*min_length=*/2, /*max_length=*/10, /*seed=*/7);
+  benchmark_data::Random random(/*seed=*/13);
+  std::vector<std::string> inputs;
+  for (int i = 0; i < suffixes.size(); ++i) {
+    if (i % 2 == 0) {
+      inputs.push_back(strings[random.Uniform(strings.size())] + suffixes[i]);
+    } else {
+      inputs.push_back(suffixes[i]);
+    }
+  }
+  return inputs;
+}
+
+void RunFindAllPrefixMatches(const StringSet& string_set,
+                             const std::vector<std::string>& inputs,
+                             benchmark::State* state) {
+  std::vector<StringSet::Match> matches;
+  for (auto _ : *state) {
+    for (const std::string& input : inputs) {
+      matches.clear();
+      string_set.FindAllPrefixMatches(input, &matches);
+      benchmark::DoNotOptimize(matches.data());
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * inputs.size());
+}
+
+void RunLongestPrefixMatch(const StringSet& string_set,
+                           const std::vector<std::string>& inputs,
+                           benchmark::State* state) {
+  StringSet::Match match;
+  for (auto _ : *state) {
+    for (const std::string& input : inputs) {
+      string_set.LongestPrefixMatch(input, &match);
+      benchmark::DoNotOptimize(match);
+    }
+  }
+  state->SetItemsProcessed(state->iterations() * inputs.size());
+}
+
+void BM_SortedStringsTableFindAllPrefixMatches(benchmark::State& state) {
+  const std::vector<std::string> strings = benchmark_data::SyntheticStrings(
+      state.range(0), /*min_length=*/1, /*max_length=*/8);
+  const SortedStrings storage(strings);
+  const SortedStringsTable table(storage.offsets.size(),
+                                 storage.offsets.data(), storage.pieces);
+  RunFindAllPrefixMatches(table, LookupInputs(strings), &state);
+}
+BENCHMARK(BM_SortedStringsTableFindAllPrefixMatches)->Arg(1000)->Arg(10000);
+
+void BM_SortedStringsTableLongestPrefixMatch(benchmark::State& state) {
+  const std::vector<std::string> strings = benchmark_data::SyntheticStrings(
+      state.range(0), /*min_length=*/1, /*max_length=*/8);
+  const SortedStrings storage(strings);
+  const SortedStringsTable table(storage.offsets.size(),
+                                 storage.offsets.data(), storage.pieces);
+  RunLongestPrefixMatch(table, LookupInputs(strings), &state);
+}
+BENCHMARK(BM_SortedStringsTableLongestPrefixMatch)->Arg(1000)->Arg(10000);
+
+void BM_DoubleArrayTrieFindAllPrefixMatches(benchmark::State& state) {
+  const std::vector<std::string> strings = benchmark_data::SyntheticStrings(
+      state.range(0), /*min_length=*/1, /*max_length=*/8);
+  const DoubleArrayTrieBuilder builder(strings);
+  const DoubleArrayTrie trie(builder.nodes().data(), builder.nodes().size());
+  RunFindAllPrefixMatches(trie, LookupInputs(strings), &state);
+}
+BENCHMARK(BM_DoubleArrayTrieFindAllPrefixMatches)->Arg(1000)->Arg(10000);
+
+void BM_DoubleArrayTrieLongestPrefixMatch(benchmark::State& state) {
+  const std::vector<std::string> strings = benchmark_data::SyntheticStrings(
+      state.range(0), /*min_length=*/1, /*max_length=*/8);
+  const DoubleArrayTrieBuilder builder(strings);
+  const DoubleArrayTrie trie(builder.nodes().data(), builder.nodes().size());
+  RunLongestPrefixMatch(trie, LookupInputs(strings), &state);
+}
+BENCHMARK(BM_DoubleArrayTrieLongestPrefixMatch)->Arg(1000)->Arg(10000);
+
+}  // namespace
+}  // namespace libtextclassifier3
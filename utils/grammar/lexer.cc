@@ -193,6 +193,21 @@ void Lexer::Process(const UnicodeText& text,
                     const std::vector<Token>::const_iterator& end,
                     const std::vector<AnnotatedSpan>* annotations,
                     Matcher* matcher) const {
+  ProcessTokens(text, begin, end, annotations, matcher);
+}
+
+void Lexer::Process(const UnicodeText& text,
+                    const std::vector<TokenView>& tokens,
+                    const std::vector<AnnotatedSpan>* annotations,
+                    Matcher* matcher) const {
+  ProcessTokens(text, tokens.begin(), tokens.end(), annotations, matcher);
+}
+
+template <typename TokenIterator>
+void Lexer::ProcessTokens(const UnicodeText& text, const TokenIterator& begin,
+                          const TokenIterator& end,
+                          const std::vector<AnnotatedSpan>* annotations,
+                          Matcher* matcher) const {
   if (begin == end) {
     return;
   }
@@ -230,7 +245,7 @@ void Lexer::Process(const UnicodeText& text,
   }
 
   for (auto token_it = begin; token_it != end; token_it++) {
-    const Token& token = *token_it;
+    const auto& token = *token_it;
 
     // Record match starts for token boundaries, so that we can snap pre-defined
     // matches to it.
@@ -91,7 +91,22 @@ class Lexer {
                const std::vector<AnnotatedSpan>* annotations,
                Matcher* matcher) const;
 
+  // Same as above, but for token views (see Tokenizer::TokenizeInto), which
+  // avoids copying the token values.
+  // NOTE: The token values are taken as they are, so views with codepoints
+  // discarded by the tokenizer need to be converted to tokens instead.
+  void Process(const UnicodeText& text, const std::vector<TokenView>& tokens,
+               const std::vector<AnnotatedSpan>* annotations,
+               Matcher* matcher) const;
+
  private:
+  // Implementation of Process for both tokens and token views.
+  template <typename TokenIterator>
+  void ProcessTokens(const UnicodeText& text, const TokenIterator& begin,
+                     const TokenIterator& end,
+                     const std::vector<AnnotatedSpan>* annotations,
+                     Matcher* matcher) const;
+
   // A lexical symbol with an identified meaning that represents raw tokens,
   // token categories or predefined text matches.
   // It is the unit fed to the grammar matcher.
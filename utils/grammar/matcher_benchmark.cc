@@ -0,0 +1,118 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <string>
+#include <vector>
+
+#include "annotator/types.h"
+#include "utils/benchmark-data.h"
+#include "utils/grammar/callback-delegate.h"
+#include "utils/grammar/lexer.h"
+#include "utils/grammar/matcher.h"
+#include "utils/grammar/rules_generated.h"
+#include "utils/grammar/utils/rules.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3::grammar {
+namespace {
+
+constexpr CallbackId kMatchCallback = 1;
+
+class CountingCallbackDelegate : public CallbackDelegate {
+ public:
+  void MatchFound(const Match* match, const CallbackId callback_id,
+                  const int64 callback_param, Matcher* matcher) override {
+    ++num_matches_;
+  }
+
+  int num_matches() const { return num_matches_; }
+
+ private:
+  int num_matches_ = 0;
+};
+
+// A small date and contact grammar, in the spirit of the production ones.
+std::string BuildRules() {
+  Rules rules;
+  for (const char* month :
+       {"january", "february", "march", "april", "may", "june", "july",
+        "august", "september", "october", "november", "december"}) {
+    rules.Add("<month>", {month});
+  }
+  for (const char* weekday : {"monday", "tuesday", "wednesday", "thursday",
+                              "friday", "saturday", "sunday"}) {
+    rules.Add("<weekday>", {weekday});
+  }
+  rules.Add("<day>", {"<digits>"});
+  rules.Add("<day>", {"<digits>", "rd"});
+  rules.Add("<year>", {"<4_digits>"});
+  rules.Add("<date>", {"<month>", "<day>", "<year>?"}, kMatchCallback);
+  rules.Add("<date>", {"next", "<weekday>", "<digits>?", "pm?"},
+            kMatchCallback);
+  rules.Add("<date>", {"tomorrow"}, kMatchCallback);
+  rules.Add("<action>", {"please", "call", "me", "at"}, kMatchCallback);
+  rules.Add("<action>", {"send", "invoice", "to"}, kMatchCallback);
+  return rules.Finalize().SerializeAsFlatbuffer();
+}
+
+// Splits the text on spaces.
+std::vector<Token> WhitespaceTokens(const UnicodeText& text) {
+  std::vector<Token> tokens;
+  std::string value;
+  int start = 0;
+  int index = 0;
+  for (auto it = text.begin(); it != text.end(); ++it, ++index) {
+    if (*it == ' ') {
+      if (!value.empty()) {
+        tokens.push_back(Token(value, start, index));
+        value.clear();
+      }
+      start = index + 1;
+    } else {
+      value.append(it.utf8_data(), it.utf8_length());
+    }
+  }
+  if (!value.empty()) {
+    tokens.push_back(Token(value, start, index));
+  }
+  return tokens;
+}
+
+void BM_MatcherProcess(benchmark::State& state) {
+  const UniLib unilib;
+  const std::string rules_buffer = BuildRules();
+  const RulesSet* rules = flatbuffers::GetRoot<RulesSet>(rules_buffer.data());
+  const Lexer lexer(&unilib, rules);
+  CountingCallbackDelegate delegate;
+  Matcher matcher(&unilib, rules, &delegate);
+
+  const std::string text = benchmark_data::SyntheticText(state.range(0));
+  const UnicodeText text_unicode = UTF8ToUnicodeText(text, /*do_copy=*/false);
+  const std::vector<Token> tokens = WhitespaceTokens(text_unicode);
+
+  for (auto _ : state) {
+    matcher.Reset();
+    lexer.Process(text_unicode, tokens, /*annotations=*/nullptr, &matcher);
+    matcher.Finish();
+  }
+  benchmark::DoNotOptimize(delegate.num_matches());
+  state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_MatcherProcess)->ArgName("num_words")->Arg(100)->Arg(1000);
+
+}  // namespace
+}  // namespace libtextclassifier3::grammar
@@ -0,0 +1,252 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "utils/regex-prefilter.h"
+
+#include "utils/strings/utf8.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+bool IsAsciiAlnum(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+         (c >= 'A' && c <= 'Z');
+}
+
+bool IsAsciiAlpha(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Returns the position right after the '}' closing the brace that starts at
+// 'pos', or -1 if there is none.
+int SkipBraces(const std::string& pattern, int pos) {
+  const size_t end = pattern.find('}', pos);
+  if (end == std::string::npos) {
+    return -1;
+  }
+  return end + 1;
+}
+
+// Returns the position right after the character class that starts at 'pos',
+// or -1 if the class is not terminated.
+int SkipCharacterClass(const std::string& pattern, int pos) {
+  const int size = pattern.size();
+  int depth = 0;
+  for (int i = pos; i < size; i++) {
+    switch (pattern[i]) {
+      case '\\':
+        ++i;
+        break;
+      case '[':
+        ++depth;
+        break;
+      case ']':
+        if (--depth == 0) {
+          return i + 1;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return -1;
+}
+
+// Returns the position right after the group that starts at 'pos', or -1 if
+// the group is not terminated.
+int SkipGroup(const std::string& pattern, int pos) {
+  const int size = pattern.size();
+  int depth = 0;
+  int i = pos;
+  while (i < size) {
+    switch (pattern[i]) {
+      case '\\':
+        i += 2;
+        continue;
+      case '[':
+        i = SkipCharacterClass(pattern, i);
+        if (i < 0) {
+          return -1;
+        }
+        continue;
+      case '(':
+        ++depth;
+        break;
+      case ')':
+        if (--depth == 0) {
+          return i + 1;
+        }
+        break;
+      default:
+        break;
+    }
+    ++i;
+  }
+  return -1;
+}
+
+}  // namespace
+
+std::string ExtractRequiredLiteral(const std::string& pattern) {
+  const int size = pattern.size();
+  std::string best_literal;
+
+  // The literal currently being built and the byte offset of its last
+  // codepoint, which a quantifier would apply to.
+  std::string literal;
+  int last_codepoint_start = -1;
+
+  const auto finish_literal = [&best_literal, &literal,
+                               &last_codepoint_start]() {
+    if (literal.size() > best_literal.size()) {
+      best_literal = literal;
+    }
+    literal.clear();
+    last_codepoint_start = -1;
+  };
+
+  // The quantified codepoint is optional, so it is dropped from the literal and
+  // the literal ends.
+  const auto drop_quantified_codepoint = [&literal, &last_codepoint_start,
+                                          &finish_literal]() {
+    if (last_codepoint_start >= 0) {
+      literal.resize(last_codepoint_start);
+    }
+    finish_literal();
+  };
+
+  int i = 0;
+  while (i < size) {
+    const char c = pattern[i];
+    switch (c) {
+      case '|':
+        // With top-level alternation no single literal is required.
+        return "";
+      case ')':
+        // Unbalanced group.
+        return "";
+      case '(':
+        // Inline flags, such as (?i) or (?x:...), change the meaning of the
+        // rest of the pattern.
+        if (i + 2 < size && pattern[i + 1] == '?' &&
+            (IsAsciiAlpha(pattern[i + 2]) || pattern[i + 2] == '-')) {
+          return "";
+        }
+        finish_literal();
+        i = SkipGroup(pattern, i);
+        if (i < 0) {
+          return "";
+        }
+        continue;
+      case '[':
+        finish_literal();
+        i = SkipCharacterClass(pattern, i);
+        if (i < 0) {
+          return "";
+        }
+        continue;
+      case '?':
+      case '*':
+      case '+':
+        drop_quantified_codepoint();
+        ++i;
+        continue;
+      case '{':
+        drop_quantified_codepoint();
+        i = SkipBraces(pattern, i);
+        if (i < 0) {
+          return "";
+        }
+        continue;
+      case '.':
+      case '^':
+      case '$':
+        finish_literal();
+        ++i;
+        continue;
+      case '\\': {
+        if (i + 1 >= size) {
+          return "";
+        }
+        const char escaped = pattern[i + 1];
+        if (IsTrailByte(escaped)) {
+          return "";
+        }
+        if (!IsAsciiAlnum(escaped)) {
+          // Escaped ASCII punctuation and non-ASCII codepoints stand for
+          // themselves. A multi-byte codepoint is a single unit, that a
+          // quantifier drops as a whole.
+          const int num_bytes = GetNumBytesForUTF8Char(&pattern[i + 1]);
+          if (i + 1 + num_bytes > size) {
+            return "";
+          }
+          last_codepoint_start = literal.size();
+          literal.append(pattern, i + 1, num_bytes);
+          i += 1 + num_bytes;
+          continue;
+        }
+        finish_literal();
+        switch (escaped) {
+          case 'p':
+          case 'P':
+            // Property classes: \pL or \p{...}.
+            if (i + 2 < size && pattern[i + 2] == '{') {
+              i = SkipBraces(pattern, i + 2);
+              if (i < 0) {
+                return "";
+              }
+            } else {
+              i += 3;
+            }
+            continue;
+          case 'Q':
+          case 'N':
+          case 'x':
+          case 'u':
+          case 'U':
+          case 'c':
+          case 'k':
+          case '0':
+            // Quoting and escapes that encode literal codepoints or names, the
+            // text of which would otherwise be mistaken for literals.
+            return "";
+          default:
+            break;
+        }
+        i += 2;
+        // Skip the digits of back references.
+        while (i < size && pattern[i] >= '0' && pattern[i] <= '9' &&
+               escaped >= '1' && escaped <= '9') {
+          ++i;
+        }
+        continue;
+      }
+      default: {
+        const int num_bytes = GetNumBytesForUTF8Char(&pattern[i]);
+        if (i + num_bytes > size) {
+          return "";
+        }
+        last_codepoint_start = literal.size();
+        literal.append(pattern, i, num_bytes);
+        i += num_bytes;
+        continue;
+      }
+    }
+  }
+  finish_literal();
+  return best_literal;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,47 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Cheap literal-based prefiltering of regular expressions, used to skip
+// running a full regex match on inputs that cannot possibly match.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_REGEX_PREFILTER_H_
+#define LIBTEXTCLASSIFIER_UTILS_REGEX_PREFILTER_H_
+
+#include <string>
+
+#include "utils/strings/stringpiece.h"
+
+namespace libtextclassifier3 {
+
+// Extracts from a regular expression pattern (in ICU syntax) a literal string
+// that every match of the pattern has to contain. If there are multiple such
+// literals, the longest one is returned.
+// The extraction is conservative: for patterns with top-level alternation,
+// inline flags (e.g. case-insensitivity) or constructs that are not
+// understood, an empty string is returned, meaning that no prefiltering is
+// possible.
+std::string ExtractRequiredLiteral(const std::string& pattern);
+
+// Returns whether the input can possibly match a pattern with the given
+// required literal, as returned by ExtractRequiredLiteral.
+inline bool MayMatchRequiredLiteral(const std::string& required_literal,
+                                    StringPiece input) {
+  return required_literal.empty() ||
+         input.find(required_literal) != StringPiece::npos;
+}
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_REGEX_PREFILTER_H_
@@ -0,0 +1,58 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "utils/regex-prefilter.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TEST(RegexPrefilterTest, ExtractsLongestLiteral) {
+  EXPECT_EQ(ExtractRequiredLiteral("abc"), "abc");
+  EXPECT_EQ(ExtractRequiredLiteral("ab[0-9]+cdef"), "cdef");
+  EXPECT_EQ(ExtractRequiredLiteral("(foo)barbaz\\d"), "barbaz");
+}
+
+TEST(RegexPrefilterTest, DropsQuantifiedCodepoint) {
+  EXPECT_EQ(ExtractRequiredLiteral("abcd?"), "abc");
+  EXPECT_EQ(ExtractRequiredLiteral("abc*de"), "ab");
+  EXPECT_EQ(ExtractRequiredLiteral("abc{0,2}"), "ab");
+}
+
+TEST(RegexPrefilterTest, NoLiteralForUnsupportedPatterns) {
+  EXPECT_EQ(ExtractRequiredLiteral("abc|def"), "");
+  EXPECT_EQ(ExtractRequiredLiteral("(?i)abc"), "");
+  EXPECT_EQ(ExtractRequiredLiteral("\\Qabc\\E"), "");
+  EXPECT_EQ(ExtractRequiredLiteral("abc\\"), "");
+}
+
+TEST(RegexPrefilterTest, EscapedPunctuationIsLiteral) {
+  EXPECT_EQ(ExtractRequiredLiteral("a\\.b\\+c"), "a.b+c");
+  EXPECT_EQ(ExtractRequiredLiteral("ab\\.?"), "ab");
+}
+
+TEST(RegexPrefilterTest, EscapedNonAsciiCodepointIsOneUnit) {
+  EXPECT_EQ(ExtractRequiredLiteral("ab\\中c"), "ab中c");
+  // The quantifier drops the whole escaped codepoint, not its last byte.
+  EXPECT_EQ(ExtractRequiredLiteral("ab\\中?"), "ab");
+  EXPECT_EQ(ExtractRequiredLiteral("\\中?"), "");
+  EXPECT_TRUE(MayMatchRequiredLiteral(ExtractRequiredLiteral("ab\\中?"), "ab"));
+  // A truncated codepoint can't be extracted.
+  EXPECT_EQ(ExtractRequiredLiteral(std::string("ab\\\xE4\xB8", 5)), "");
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
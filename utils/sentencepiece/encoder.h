@@ -57,6 +57,15 @@ class Encoder {
   bool Encode(StringPiece normalized_text,
               std::vector<int>* encoded_text) const;
 
+  // Buffers reused by the Encode overload below across inputs. Not
+  // thread-safe, each thread needs its own instance.
+  struct Scratch;
+
+  // Like above, but keeps the segmentation state in 'scratch'. Once the
+  // buffers have grown to fit the inputs, performs no heap allocations.
+  bool Encode(StringPiece normalized_text, Scratch* scratch,
+              std::vector<int>* encoded_text) const;
+
  private:
   // State in the dynamic programming algorithm.
   struct SegmentationEntry {
@@ -83,6 +92,11 @@ class Encoder {
   const int unknown_score_;
 };
 
+struct Encoder::Scratch {
+  std::vector<SegmentationEntry> segmentation;
+  std::vector<StringSet::Match> matches;
+};
+
 }  // namespace libtextclassifier3
 
 #endif  // LIBTEXTCLASSIFIER_UTILS_SENTENCEPIECE_ENCODER_H_
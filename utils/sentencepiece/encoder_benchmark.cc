@@ -0,0 +1,98 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/benchmark-data.h"
+#include "utils/container/sorted-strings-table.h"
+#include "utils/sentencepiece/encoder.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+void BM_EncoderEncode(benchmark::State& state, bool reuse_scratch) {
+  // All lowercase letters, so that every input can be segmented, and longer
+  // synthetic pieces.
+  std::vector<std::string> pieces;
+  for (char c = 'a'; c <= 'z'; ++c) {
+    pieces.push_back(std::string(1, c));
+  }
+  for (std::string& piece : benchmark_data::SyntheticStrings(
+           /*num_strings=*/state.range(0), /*min_length=*/2,
+           /*max_length=*/6)) {
+    // Drop the digits making the synthetic strings distinct, the input text
+    // has none.
+    piece.erase(std::remove_if(piece.begin(), piece.end(),
+                               [](char c) { return c < 'a' || c > 'z'; }),
+                piece.end());
+    pieces.push_back(piece);
+  }
+  std::sort(pieces.begin(), pieces.end());
+  pieces.erase(std::unique(pieces.begin(), pieces.end()), pieces.end());
+
+  std::vector<uint32> offsets;
+  std::string pieces_data;
+  std::vector<float> scores;
+  for (const std::string& piece : pieces) {
+    offsets.push_back(pieces_data.size());
+    pieces_data.append(piece);
+    pieces_data.push_back('\0');
+    // Prefer longer pieces.
+    scores.push_back(-1.0f / piece.size());
+  }
+  const SortedStringsTable pieces_table(offsets.size(), offsets.data(),
+                                        pieces_data);
+  const Encoder encoder(&pieces_table, pieces.size(), scores.data());
+
+  // Lowercase ASCII text, as the normalizer would produce it.
+  std::string text;
+  for (const char c : benchmark_data::SyntheticText(/*num_words=*/200)) {
+    if (c >= 'a' && c <= 'z') {
+      text.push_back(c);
+    } else if (c >= 'A' && c <= 'Z') {
+      text.push_back(c - 'A' + 'a');
+    } else if (c == ' ') {
+      text.push_back(' ');
+    }
+  }
+
+  Encoder::Scratch scratch;
+  std::vector<int> encoded_text;
+  for (auto _ : state) {
+    encoded_text.clear();
+    if (reuse_scratch) {
+      encoder.Encode(text, &scratch, &encoded_text);
+    } else {
+      encoder.Encode(text, &encoded_text);
+    }
+    benchmark::DoNotOptimize(encoded_text.data());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_CAPTURE(BM_EncoderEncode, fresh_buffers, /*reuse_scratch=*/false)
+    ->ArgName("num_pieces")
+    ->Arg(1000)
+    ->Arg(20000);
+BENCHMARK_CAPTURE(BM_EncoderEncode, reused_scratch, /*reuse_scratch=*/true)
+    ->ArgName("num_pieces")
+    ->Arg(1000)
+    ->Arg(20000);
+
+}  // namespace
+}  // namespace libtextclassifier3
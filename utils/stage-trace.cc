@@ -0,0 +1,61 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "utils/stage-trace.h"
+
+namespace libtextclassifier3 {
+
+void StageTrace::Add(const StageTraceEntry& entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.push_back(entry);
+}
+
+std::vector<StageTraceEntry> StageTrace::entries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_;
+}
+
+void StageTrace::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+void ScopedStageTrace::Start(const char* stage) {
+  if (trace_ == nullptr) {
+    return;
+  }
+  entry_.stage = stage;
+  initial_allocated_bytes_ = trace_->AllocatedBytes();
+  start_time_ = std::chrono::steady_clock::now();
+}
+
+ScopedStageTrace::~ScopedStageTrace() {
+  if (trace_ == nullptr) {
+    return;
+  }
+  entry_.wall_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start_time_)
+                            .count();
+  if (output_size_) {
+    entry_.num_outputs = output_size_() - initial_output_size_;
+  }
+  if (initial_allocated_bytes_ >= 0) {
+    entry_.bytes_allocated =
+        trace_->AllocatedBytes() - initial_allocated_bytes_;
+  }
+  trace_->Add(entry_);
+}
+
+}  // namespace libtextclassifier3
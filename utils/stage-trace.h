@@ -0,0 +1,143 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Per-stage latency instrumentation of a processing pipeline.
+//
+// The pipeline marks its stages with TC3_TRACE_STAGE. Callers that want to
+// see where the time goes pass a StageTrace with the request, and read the
+// recorded entries afterwards. The tracing is only compiled in when
+// TC3_ENABLE_STAGE_TRACE is defined (with the enable_stage_trace GN argument,
+// e.g. `gn gen out --args="enable_stage_trace=true"`); otherwise
+// TC3_TRACE_STAGE expands to nothing and no entries are ever recorded.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_STAGE_TRACE_H_
+#define LIBTEXTCLASSIFIER_UTILS_STAGE_TRACE_H_
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstddef>
+#include <functional>
+#include <mutex>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/base/macros.h"
+
+namespace libtextclassifier3 {
+
+struct StageTraceEntry {
+  // Name of the stage, e.g. "RegexChunk". Points to a string literal.
+  const char* stage = nullptr;
+
+  // Wall time spent in the stage.
+  int64 wall_time_us = 0;
+
+  // Number of outputs (e.g. candidates) the stage produced, or -1 if the stage
+  // has no countable output.
+  int num_outputs = -1;
+
+  // Bytes allocated during the stage as reported by the allocation counter of
+  // the trace, or -1 if the trace has none. As allocations are usually counted
+  // per process or thread, this includes allocations of stages that run
+  // concurrently.
+  int64 bytes_allocated = -1;
+};
+
+// Collects the entries of the traced stages of one or more requests.
+// NOTE: Thread-safe, the stages of a request may run concurrently.
+class StageTrace {
+ public:
+  StageTrace() = default;
+
+  // 'allocated_bytes_counter' returns a monotonically increasing count of
+  // allocated bytes, e.g. from a counting allocator or the malloc library of
+  // the client. This library does not track allocations itself.
+  explicit StageTrace(std::function<int64()> allocated_bytes_counter)
+      : allocated_bytes_counter_(std::move(allocated_bytes_counter)) {}
+
+  void Add(const StageTraceEntry& entry);
+
+  // Returns the entries recorded so far, in the order the stages finished.
+  std::vector<StageTraceEntry> entries() const;
+
+  void Clear();
+
+  // Returns the current value of the allocation counter, or -1 if there is
+  // none.
+  int64 AllocatedBytes() const {
+    return allocated_bytes_counter_ ? allocated_bytes_counter_() : -1;
+  }
+
+ private:
+  const std::function<int64()> allocated_bytes_counter_;
+
+  mutable std::mutex mutex_;
+  std::vector<StageTraceEntry> entries_;
+};
+
+// Records an entry for the stage that runs during the lifetime of the object.
+// Does nothing if the trace is null.
+class ScopedStageTrace {
+ public:
+  ScopedStageTrace(StageTrace* trace, const char* stage, std::nullptr_t)
+      : trace_(trace) {
+    Start(stage);
+  }
+
+  // Also records the number of elements appended to 'output' while the stage
+  // runs.
+  template <typename T>
+  ScopedStageTrace(StageTrace* trace, const char* stage,
+                   const std::vector<T>* output)
+      : trace_(trace) {
+    if (trace_ != nullptr) {
+      output_size_ = [output]() { return static_cast<int>(output->size()); };
+      initial_output_size_ = output_size_();
+    }
+    Start(stage);
+  }
+
+  ~ScopedStageTrace();
+
+ private:
+  void Start(const char* stage);
+
+  StageTrace* const trace_;
+  StageTraceEntry entry_;
+  std::chrono::steady_clock::time_point start_time_;
+  int64 initial_allocated_bytes_ = -1;
+  std::function<int()> output_size_;
+  int initial_output_size_ = 0;
+
+  TC3_DISALLOW_COPY_AND_ASSIGN(ScopedStageTrace);
+};
+
+#define TC3_STAGE_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define TC3_STAGE_TRACE_CONCAT(a, b) TC3_STAGE_TRACE_CONCAT_INTERNAL(a, b)
+
+// Traces the rest of the enclosing scope as 'stage' into 'trace' (a
+// StageTrace*, may be null). 'output' is a pointer to the vector the stage
+// appends its outputs to, or nullptr.
+#ifdef TC3_ENABLE_STAGE_TRACE
+#define TC3_TRACE_STAGE(trace, stage, output)                   \
+  ::libtextclassifier3::ScopedStageTrace TC3_STAGE_TRACE_CONCAT( \
+      tc3_stage_trace_, __LINE__)((trace), (stage), (output))
+#else
+#define TC3_TRACE_STAGE(trace, stage, output)
+#endif  // TC3_ENABLE_STAGE_TRACE
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_STAGE_TRACE_H_
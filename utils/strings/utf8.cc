@@ -17,6 +17,15 @@
 
 #include "utils/base/logging.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TC3_UTF8_NEON
+#endif
+
 namespace libtextclassifier3 {
 
 bool IsValidUTF8(const char *src, int size) {
@@ -30,6 +39,43 @@ bool IsValidUTF8(const char *src, int size) {
   return true;
 }
 
+int AsciiPrefixLength(const char *src, int size) {
+  int i = 0;
+  // Skip whole blocks without a byte with the high bit set, the exact end of
+  // the prefix is then found by the scalar loop below.
+#if defined(__AVX2__)
+  for (; i + 32 <= size; i += 32) {
+    const __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    if (_mm256_movemask_epi8(block) != 0) {
+      break;
+    }
+  }
+#elif defined(__SSE2__)
+  for (; i + 16 <= size; i += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    if (_mm_movemask_epi8(block) != 0) {
+      break;
+    }
+  }
+#elif defined(TC3_UTF8_NEON)
+  for (; i + 16 <= size; i += 16) {
+    const uint8x16_t block =
+        vld1q_u8(reinterpret_cast<const uint8_t *>(src + i));
+    if (vmaxvq_u8(block) >= 0x80) {
+      break;
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    if (static_cast<unsigned char>(src[i]) >= 0x80) {
+      return i;
+    }
+  }
+  return size;
+}
+
 int SafeTruncateLength(const char *str, int truncate_at) {
   // Always want to truncate at the start of a character, so if
   // it's in a middle, back up toward the start
@@ -40,6 +40,11 @@ static inline bool IsTrailByte(char x) {
 // Returns true iff src points to a well-formed UTF-8 string.
 bool IsValidUTF8(const char *src, int size);
 
+// Returns the number of leading ASCII bytes (< 0x80) of the string, i.e. the
+// length of the prefix that consists of single-byte codepoints.
+// Checks 16 or 32 bytes at a time where SIMD instructions are available.
+int AsciiPrefixLength(const char *src, int size);
+
 // Helper to ensure that strings are not truncated in the middle of
 // multi-byte UTF-8 characters.
 // Given a string, and a position at which to truncate, returns the
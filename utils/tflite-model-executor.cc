@@ -264,6 +264,51 @@ std::unique_ptr<tflite::Interpreter> TfLiteModelExecutor::CreateInterpreter()
   return interpreter;
 }
 
+std::unique_ptr<tflite::Interpreter> TfLiteInterpreterPool::Acquire() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_interpreters_.empty()) {
+      std::unique_ptr<tflite::Interpreter> interpreter =
+          std::move(idle_interpreters_.back());
+      idle_interpreters_.pop_back();
+      ++num_reused_;
+      return interpreter;
+    }
+  }
+
+  // Create the interpreter outside of the lock, so that other threads can
+  // concurrently borrow and return interpreters.
+  std::unique_ptr<tflite::Interpreter> interpreter =
+      executor_->CreateInterpreter();
+  if (interpreter != nullptr) {
+    ++num_created_;
+  }
+  return interpreter;
+}
+
+void TfLiteInterpreterPool::Release(
+    std::unique_ptr<tflite::Interpreter> interpreter) {
+  if (interpreter == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (static_cast<int>(idle_interpreters_.size()) < max_size_) {
+      idle_interpreters_.push_back(std::move(interpreter));
+      return;
+    }
+  }
+  ++num_discarded_;
+}
+
+TfLiteInterpreterPool::Stats TfLiteInterpreterPool::GetStats() const {
+  Stats stats;
+  stats.num_created = num_created_.load();
+  stats.num_reused = num_reused_.load();
+  stats.num_discarded = num_discarded_.load();
+  return stats;
+}
+
 template <>
 void TfLiteModelExecutor::SetInput(const int input_index,
                                    const std::vector<std::string>& input_data,
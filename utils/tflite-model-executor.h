@@ -18,8 +18,11 @@
 #ifndef LIBTEXTCLASSIFIER_UTILS_TFLITE_MODEL_EXECUTOR_H_
 #define LIBTEXTCLASSIFIER_UTILS_TFLITE_MODEL_EXECUTOR_H_
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <vector>
 
 #include "utils/base/logging.h"
 #include "utils/tensor-view.h"
@@ -149,6 +152,54 @@ class TfLiteModelExecutor {
   std::unique_ptr<tflite::OpResolver> resolver_;
 };
 
+// A bounded pool of interpreters for a single model. Interpreters are expensive
+// to create (building the graph and allocating the tensors), so instead of
+// creating a fresh one for each request, callers borrow an interpreter from the
+// pool and return it when done. At most 'max_size' idle interpreters are kept
+// around, any interpreter returned beyond that is destroyed.
+// NOTE: The pool itself is thread-safe, the borrowed interpreters are not and
+// must only be used by one thread at a time.
+class TfLiteInterpreterPool {
+ public:
+  struct Stats {
+    // Number of interpreters created because the pool was empty.
+    int64_t num_created = 0;
+
+    // Number of requests served by an interpreter from the pool.
+    int64_t num_reused = 0;
+
+    // Number of returned interpreters destroyed because the pool was full.
+    int64_t num_discarded = 0;
+  };
+
+  // Does not take ownership of the executor, which must outlive the pool.
+  TfLiteInterpreterPool(const TfLiteModelExecutor* executor, int max_size)
+      : executor_(executor), max_size_(max_size) {}
+
+  // Returns an interpreter from the pool or creates a new one if the pool is
+  // empty. Returns nullptr if the interpreter could not be created.
+  std::unique_ptr<tflite::Interpreter> Acquire();
+
+  // Returns a previously acquired interpreter to the pool.
+  void Release(std::unique_ptr<tflite::Interpreter> interpreter);
+
+  // Returns the usage counters of the pool.
+  Stats GetStats() const;
+
+  int max_size() const { return max_size_; }
+
+ private:
+  const TfLiteModelExecutor* executor_;
+  const int max_size_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<tflite::Interpreter>> idle_interpreters_;
+
+  std::atomic<int64_t> num_created_{0};
+  std::atomic<int64_t> num_reused_{0};
+  std::atomic<int64_t> num_discarded_{0};
+};
+
 template <>
 void TfLiteModelExecutor::SetInput(const int input_index,
                                    const std::vector<std::string>& input_data,
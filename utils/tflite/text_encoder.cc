@@ -238,14 +238,16 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const int max_output_length = output_encoded.dims->data[1];
   const int max_encoded_position = max_output_length;
 
+  Encoder::Scratch scratch;
+  std::vector<int> encoded;
   for (int i = 0; i < num_strings; ++i) {
     const auto& strref = tflite::GetString(&input_text, i);
     std::string normalized;
     TF_LITE_ENSURE(context,
                    encoder_op->normalizer->Normalize(
                        StringPiece(strref.str, strref.len), &normalized));
-    std::vector<int> encoded;
-    TF_LITE_ENSURE(context, encoder_op->encoder->Encode(normalized, &encoded));
+    TF_LITE_ENSURE(context, encoder_op->encoder->Encode(normalized, &scratch,
+                                                        &encoded));
     encoded_total.insert(encoded_total.end(), encoded.begin(), encoded.end());
     encoded_offsets.push_back(encoded_total.size());
     for (int i = 0; i < encoded.size(); i++) {
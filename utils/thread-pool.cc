@@ -0,0 +1,135 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "utils/thread-pool.h"
+
+#include <atomic>
+
+namespace libtextclassifier3 {
+
+struct ThreadPool::Job {
+  Job(int arg_num_items, const std::function<void(int)>* arg_fn)
+      : num_items(arg_num_items), fn(arg_fn) {}
+
+  const int num_items;
+  const std::function<void(int)>* fn;
+
+  // Index of the next item to claim.
+  std::atomic<int> next_item{0};
+
+  // Guarded by 'mutex'.
+  int num_finished = 0;
+  std::mutex mutex;
+  std::condition_variable all_finished;
+};
+
+ThreadPool::ThreadPool(int num_threads) {
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  work_available_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::RunItems(Job* job) {
+  int num_run = 0;
+  while (true) {
+    const int item = job->next_item.fetch_add(1, std::memory_order_relaxed);
+    if (item >= job->num_items) {
+      break;
+    }
+    (*job->fn)(item);
+    ++num_run;
+  }
+  if (num_run == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(job->mutex);
+  job->num_finished += num_run;
+  if (job->num_finished == job->num_items) {
+    job->all_finished.notify_all();
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock,
+                           [this] { return shutting_down_ || !jobs_.empty(); });
+      if (jobs_.empty()) {
+        return;
+      }
+      job = jobs_.front();
+
+      // Once all items of the job are claimed, nobody else needs to see it.
+      if (job->next_item.load(std::memory_order_relaxed) >= job->num_items) {
+        jobs_.pop_front();
+        continue;
+      }
+    }
+    RunItems(job.get());
+  }
+}
+
+void ThreadPool::ParallelFor(int num_items,
+                             const std::function<void(int)>& fn) {
+  if (num_items <= 0) {
+    return;
+  }
+  if (workers_.empty() || num_items == 1) {
+    for (int i = 0; i < num_items; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  auto job = std::make_shared<Job>(num_items, &fn);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+  }
+  work_available_.notify_all();
+
+  RunItems(job.get());
+
+  {
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->all_finished.wait(
+        lock, [&job] { return job->num_finished == job->num_items; });
+  }
+
+  // Drop the job from the queue if no worker got to it, 'fn' goes out of scope
+  // when we return.
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = jobs_.begin(); it != jobs_.end(); ++it) {
+    if (*it == job) {
+      jobs_.erase(it);
+      break;
+    }
+  }
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,76 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// A small fixed-size thread pool for fanning out independent work items.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_THREAD_POOL_H_
+#define LIBTEXTCLASSIFIER_UTILS_THREAD_POOL_H_
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "utils/base/macros.h"
+
+namespace libtextclassifier3 {
+
+class ThreadPool {
+ public:
+  // Creates a pool with 'num_threads' worker threads. With num_threads <= 0
+  // no workers are started and all the work runs on the calling thread.
+  explicit ThreadPool(int num_threads);
+
+  // Waits for the workers to finish the currently running items and joins
+  // them.
+  ~ThreadPool();
+
+  // Calls fn(i) for every i in [0, num_items) and returns when all the calls
+  // have finished. The items are not pre-assigned to threads: each participant
+  // (the idle workers and the calling thread itself) repeatedly claims the next
+  // unclaimed index, so threads that finish early pick up the remaining work.
+  // Because the calling thread always participates, this makes progress even
+  // when all workers are busy, which also makes nested calls (fn calling
+  // ParallelFor on the same pool) safe.
+  // NOTE: fn is called concurrently from several threads, and must only write
+  // to state owned by its own item.
+  void ParallelFor(int num_items, const std::function<void(int)>& fn);
+
+  int num_threads() const { return workers_.size(); }
+
+ private:
+  struct Job;
+
+  // Claims and runs items of 'job' until none are left.
+  static void RunItems(Job* job);
+
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  bool shutting_down_ = false;
+
+  TC3_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_THREAD_POOL_H_
@@ -21,49 +21,58 @@
 #include "utils/base/logging.h"
 #include "utils/hash/farmhash.h"
 #include "utils/strings/stringpiece.h"
+#include "utils/strings/utf8.h"
 #include "utils/utf8/unicodetext.h"
 
 namespace libtextclassifier3 {
 
 namespace {
 
-std::string RemapTokenAscii(const std::string& token,
-                            const TokenFeatureExtractorOptions& options) {
+// Writes the remapped token to 'remapped'. Returns false (and leaves
+// 'remapped' untouched) if no remapping is configured.
+bool RemapTokenAscii(StringPiece token,
+                     const TokenFeatureExtractorOptions& options,
+                     std::string* remapped) {
   if (!options.remap_digits && !options.lowercase_tokens) {
-    return token;
+    return false;
   }
 
-  std::string copy = token;
-  for (int i = 0; i < token.size(); ++i) {
-    if (options.remap_digits && isdigit(copy[i])) {
-      copy[i] = '0';
+  remapped->assign(token.data(), token.size());
+  for (int i = 0; i < remapped->size(); ++i) {
+    if (options.remap_digits && isdigit((*remapped)[i])) {
+      (*remapped)[i] = '0';
     }
     if (options.lowercase_tokens) {
-      copy[i] = tolower(copy[i]);
+      (*remapped)[i] = tolower((*remapped)[i]);
     }
   }
-  return copy;
+  return true;
 }
 
-void RemapTokenUnicode(const std::string& token,
+// Writes the UTF8 encoding of the remapped token to 'remapped'. Returns false
+// (and leaves 'remapped' untouched) if no remapping is configured.
+bool RemapTokenUnicode(const std::string& token,
                        const TokenFeatureExtractorOptions& options,
-                       const UniLib& unilib, UnicodeText* remapped) {
+                       const UniLib& unilib, std::string* remapped) {
   if (!options.remap_digits && !options.lowercase_tokens) {
-    // Leave remapped untouched.
-    return;
+    return false;
   }
 
-  UnicodeText word = UTF8ToUnicodeText(token, /*do_copy=*/false);
+  const UnicodeText word = UTF8ToUnicodeText(token, /*do_copy=*/false);
   remapped->clear();
+  char encoded[4];
   for (auto it = word.begin(); it != word.end(); ++it) {
+    char32 codepoint;
     if (options.remap_digits && unilib.IsDigit(*it)) {
-      remapped->push_back('0');
+      codepoint = '0';
     } else if (options.lowercase_tokens) {
-      remapped->push_back(unilib.ToLower(*it));
+      codepoint = unilib.ToLower(*it);
     } else {
-      remapped->push_back(*it);
+      codepoint = *it;
     }
+    remapped->append(encoded, ValidRuneToChar(codepoint, encoded));
   }
+  return true;
 }
 
 }  // namespace
@@ -91,45 +100,74 @@ bool TokenFeatureExtractor::Extract(const Token& token, bool is_in_span,
   return true;
 }
 
+bool TokenFeatureExtractor::Extract(const Token& token, bool is_in_span,
+                                    Scratch* scratch,
+                                    std::vector<int>* sparse_features,
+                                    float* dense_features) const {
+  if (!dense_features || !scratch) {
+    return false;
+  }
+  if (sparse_features) {
+    sparse_features->clear();
+    AppendCharactergramFeatures(token, scratch, sparse_features);
+  }
+  WriteDenseFeatures(token, is_in_span, dense_features);
+  return true;
+}
+
 std::vector<int> TokenFeatureExtractor::ExtractCharactergramFeatures(
     const Token& token) const {
+  Scratch scratch;
+  std::vector<int> result;
+  AppendCharactergramFeatures(token, &scratch, &result);
+  return result;
+}
+
+void TokenFeatureExtractor::AppendCharactergramFeatures(
+    const Token& token, Scratch* scratch, std::vector<int>* result) const {
   if (options_.unicode_aware_features) {
-    return ExtractCharactergramFeaturesUnicode(token);
+    AppendCharactergramFeaturesUnicode(token, scratch, result);
   } else {
-    return ExtractCharactergramFeaturesAscii(token);
+    AppendCharactergramFeaturesAscii(token, scratch, result);
   }
 }
 
 std::vector<float> TokenFeatureExtractor::ExtractDenseFeatures(
     const Token& token, bool is_in_span) const {
-  std::vector<float> dense_features;
+  std::vector<float> dense_features(DenseFeaturesCount());
+  WriteDenseFeatures(token, is_in_span, dense_features.data());
+  return dense_features;
+}
 
+void TokenFeatureExtractor::WriteDenseFeatures(const Token& token,
+                                               bool is_in_span,
+                                               float* dest) const {
   if (options_.extract_case_feature) {
     if (options_.unicode_aware_features) {
       UnicodeText token_unicode =
           UTF8ToUnicodeText(token.value, /*do_copy=*/false);
       if (!token.value.empty() && unilib_.IsUpper(*token_unicode.begin())) {
-        dense_features.push_back(1.0);
+        *dest++ = 1.0;
       } else {
-        dense_features.push_back(-1.0);
+        *dest++ = -1.0;
       }
     } else {
       if (!token.value.empty() && isupper(*token.value.begin())) {
-        dense_features.push_back(1.0);
+        *dest++ = 1.0;
       } else {
-        dense_features.push_back(-1.0);
+        *dest++ = -1.0;
       }
     }
   }
 
   if (options_.extract_selection_mask_feature) {
     if (is_in_span) {
-      dense_features.push_back(1.0);
+      *dest++ = 1.0;
     } else {
       if (options_.unicode_aware_features) {
-        dense_features.push_back(-1.0);
+        *dest++ = -1.0;
       } else {
-        dense_features.push_back(0.0);
+        *dest++ = 0.0;
       }
     }
   }
@@ -140,23 +178,27 @@ std::vector<float> TokenFeatureExtractor::ExtractDenseFeatures(
         UTF8ToUnicodeText(token.value, /*do_copy=*/false);
     for (int i = 0; i < regex_patterns_.size(); ++i) {
       if (!regex_patterns_[i].get()) {
-        dense_features.push_back(-1.0);
+        *dest++ = -1.0;
         continue;
       }
       auto matcher = regex_patterns_[i]->Matcher(token_unicode);
       int status;
       if (matcher->Matches(&status)) {
-        dense_features.push_back(1.0);
+        *dest++ = 1.0;
       } else {
-        dense_features.push_back(-1.0);
+        *dest++ = -1.0;
       }
     }
   }
-
-  return dense_features;
 }
 
 int TokenFeatureExtractor::HashToken(StringPiece token) const {
+  std::string key;
+  return HashToken(token, &key);
+}
+
+int TokenFeatureExtractor::HashToken(StringPiece token,
+                                     std::string* key) const {
   if (options_.allowed_chargrams.empty()) {
     return tc3farmhash::Fingerprint64(token) % options_.num_buckets;
   } else {
@@ -165,10 +207,10 @@ int TokenFeatureExtractor::HashToken(StringPiece token) const {
     // embedding with other charactergrams.
     // TODO(zilka): Experimentally verify.
     const int kNumExtraBuckets = 2;
-    const std::string token_string = token.ToString();
-    if (token_string == "<PAD>") {
+    key->assign(token.data(), token.size());
+    if (*key == "<PAD>") {
       return 1;
-    } else if (options_.allowed_chargrams.find(token_string) ==
+    } else if (options_.allowed_chargrams.find(*key) ==
                options_.allowed_chargrams.end()) {
       return 0;  // Out-of-vocabulary.
     } else {
@@ -181,129 +223,155 @@ int TokenFeatureExtractor::HashToken(StringPiece token) const {
 
 std::vector<int> TokenFeatureExtractor::ExtractCharactergramFeaturesAscii(
     const Token& token) const {
+  Scratch scratch;
   std::vector<int> result;
+  AppendCharactergramFeaturesAscii(token, &scratch, &result);
+  return result;
+}
+
+void TokenFeatureExtractor::AppendCharactergramFeaturesAscii(
+    const Token& token, Scratch* scratch, std::vector<int>* result) const {
   if (token.is_padding || token.value.empty()) {
-    result.push_back(HashToken("<PAD>"));
+    result->push_back(HashToken("<PAD>", &scratch->key));
+    return;
+  }
+
+  const StringPiece word =
+      RemapTokenAscii(token.value, options_, &scratch->remapped_word)
+          ? StringPiece(scratch->remapped_word)
+          : StringPiece(token.value);
+
+  // Trim words that are over max_word_length characters.
+  const int max_word_length = options_.max_word_length;
+  std::string& feature_word = scratch->feature_word;
+  feature_word.assign("^");
+  if (word.size() > max_word_length) {
+    feature_word.append(word.data(), max_word_length / 2);
+    feature_word.append("\1");
+    feature_word.append(word.data() + word.size() - max_word_length / 2,
+                        max_word_length / 2);
   } else {
-    const std::string word = RemapTokenAscii(token.value, options_);
-
-    // Trim words that are over max_word_length characters.
-    const int max_word_length = options_.max_word_length;
-    std::string feature_word;
-    if (word.size() > max_word_length) {
-      feature_word =
-          "^" + word.substr(0, max_word_length / 2) + "\1" +
-          word.substr(word.size() - max_word_length / 2, max_word_length / 2) +
-          "$";
-    } else {
-      // Add a prefix and suffix to the word.
-      feature_word = "^" + word + "$";
-    }
+    feature_word.append(word.data(), word.size());
+  }
+  feature_word.append("$");
 
-    // Upper-bound the number of charactergram extracted to avoid resizing.
-    result.reserve(options_.chargram_orders.size() * feature_word.size());
+  // Upper-bound the number of charactergram extracted to avoid resizing.
+  result->reserve(result->size() +
+                  options_.chargram_orders.size() * feature_word.size());
 
-    if (options_.chargram_orders.empty()) {
-      result.push_back(HashToken(feature_word));
-    } else {
-      // Generate the character-grams.
-      for (int chargram_order : options_.chargram_orders) {
-        if (chargram_order == 1) {
-          for (int i = 1; i < feature_word.size() - 1; ++i) {
-            result.push_back(
-                HashToken(StringPiece(feature_word, /*offset=*/i, /*len=*/1)));
-          }
-        } else {
-          for (int i = 0;
-               i < static_cast<int>(feature_word.size()) - chargram_order + 1;
-               ++i) {
-            result.push_back(HashToken(StringPiece(feature_word, /*offset=*/i,
-                                                   /*len=*/chargram_order)));
-          }
+  if (options_.chargram_orders.empty()) {
+    result->push_back(HashToken(feature_word, &scratch->key));
+  } else {
+    // Generate the character-grams.
+    for (int chargram_order : options_.chargram_orders) {
+      if (chargram_order == 1) {
+        for (int i = 1; i < feature_word.size() - 1; ++i) {
+          result->push_back(
+              HashToken(StringPiece(feature_word, /*offset=*/i, /*len=*/1),
+                        &scratch->key));
+        }
+      } else {
+        for (int i = 0;
+             i < static_cast<int>(feature_word.size()) - chargram_order + 1;
+             ++i) {
+          result->push_back(HashToken(StringPiece(feature_word, /*offset=*/i,
+                                                  /*len=*/chargram_order),
+                                      &scratch->key));
         }
       }
     }
   }
-  return result;
 }
 
 std::vector<int> TokenFeatureExtractor::ExtractCharactergramFeaturesUnicode(
     const Token& token) const {
+  Scratch scratch;
   std::vector<int> result;
+  AppendCharactergramFeaturesUnicode(token, &scratch, &result);
+  return result;
+}
+
+void TokenFeatureExtractor::AppendCharactergramFeaturesUnicode(
+    const Token& token, Scratch* scratch, std::vector<int>* result) const {
   if (token.is_padding || token.value.empty()) {
-    result.push_back(HashToken("<PAD>"));
-  } else {
-    UnicodeText word = UTF8ToUnicodeText(token.value, /*do_copy=*/false);
-    RemapTokenUnicode(token.value, options_, unilib_, &word);
-
-    // Trim the word if needed by finding a left-cut point and right-cut point.
-    auto left_cut = word.begin();
-    auto right_cut = word.end();
-    for (int i = 0; i < options_.max_word_length / 2; i++) {
-      if (left_cut < right_cut) {
-        ++left_cut;
-      }
-      if (left_cut < right_cut) {
-        --right_cut;
-      }
-    }
+    result->push_back(HashToken("<PAD>", &scratch->key));
+    return;
+  }
 
-    std::string feature_word;
-    if (left_cut == right_cut) {
-      feature_word = "^" + word.UTF8Substring(word.begin(), word.end()) + "$";
-    } else {
-      // clang-format off
-      feature_word = "^" +
-                     word.UTF8Substring(word.begin(), left_cut) +
-                     "\1" +
-                     word.UTF8Substring(right_cut, word.end()) +
-                     "$";
-      // clang-format on
+  const UnicodeText word =
+      RemapTokenUnicode(token.value, options_, unilib_,
+                        &scratch->remapped_word)
+          ? UTF8ToUnicodeText(scratch->remapped_word, /*do_copy=*/false)
+          : UTF8ToUnicodeText(token.value, /*do_copy=*/false);
+
+  // Trim the word if needed by finding a left-cut point and right-cut point.
+  auto left_cut = word.begin();
+  auto right_cut = word.end();
+  for (int i = 0; i < options_.max_word_length / 2; i++) {
+    if (left_cut < right_cut) {
+      ++left_cut;
     }
+    if (left_cut < right_cut) {
+      --right_cut;
+    }
+  }
 
-    const UnicodeText feature_word_unicode =
-        UTF8ToUnicodeText(feature_word, /*do_copy=*/false);
+  std::string& feature_word = scratch->feature_word;
+  feature_word.assign("^");
+  if (left_cut == right_cut) {
+    feature_word.append(word.data(), word.size_bytes());
+  } else {
+    feature_word.append(word.data(),
+                        left_cut.utf8_data() - word.begin().utf8_data());
+    feature_word.append("\1");
+    feature_word.append(right_cut.utf8_data(),
+                        word.end().utf8_data() - right_cut.utf8_data());
+  }
+  feature_word.append("$");
 
-    // Upper-bound the number of charactergram extracted to avoid resizing.
-    result.reserve(options_.chargram_orders.size() * feature_word.size());
+  const UnicodeText feature_word_unicode =
+      UTF8ToUnicodeText(feature_word, /*do_copy=*/false);
 
-    if (options_.chargram_orders.empty()) {
-      result.push_back(HashToken(feature_word));
-    } else {
-      // Generate the character-grams.
-      for (int chargram_order : options_.chargram_orders) {
-        UnicodeText::const_iterator it_start = feature_word_unicode.begin();
-        UnicodeText::const_iterator it_end = feature_word_unicode.end();
-        if (chargram_order == 1) {
-          ++it_start;
-          --it_end;
-        }
+  // Upper-bound the number of charactergram extracted to avoid resizing.
+  result->reserve(result->size() +
+                  options_.chargram_orders.size() * feature_word.size());
 
-        UnicodeText::const_iterator it_chargram_start = it_start;
-        UnicodeText::const_iterator it_chargram_end = it_start;
-        bool chargram_is_complete = true;
-        for (int i = 0; i < chargram_order; ++i) {
-          if (it_chargram_end == it_end) {
-            chargram_is_complete = false;
-            break;
-          }
-          ++it_chargram_end;
-        }
-        if (!chargram_is_complete) {
-          continue;
-        }
+  if (options_.chargram_orders.empty()) {
+    result->push_back(HashToken(feature_word, &scratch->key));
+  } else {
+    // Generate the character-grams.
+    for (int chargram_order : options_.chargram_orders) {
+      UnicodeText::const_iterator it_start = feature_word_unicode.begin();
+      UnicodeText::const_iterator it_end = feature_word_unicode.end();
+      if (chargram_order == 1) {
+        ++it_start;
+        --it_end;
+      }
 
-        for (; it_chargram_end <= it_end;
-             ++it_chargram_start, ++it_chargram_end) {
-          const int length_bytes =
-              it_chargram_end.utf8_data() - it_chargram_start.utf8_data();
-          result.push_back(HashToken(
-              StringPiece(it_chargram_start.utf8_data(), length_bytes)));
+      UnicodeText::const_iterator it_chargram_start = it_start;
+      UnicodeText::const_iterator it_chargram_end = it_start;
+      bool chargram_is_complete = true;
+      for (int i = 0; i < chargram_order; ++i) {
+        if (it_chargram_end == it_end) {
+          chargram_is_complete = false;
+          break;
         }
+        ++it_chargram_end;
+      }
+      if (!chargram_is_complete) {
+        continue;
+      }
+
+      for (; it_chargram_end <= it_end;
+           ++it_chargram_start, ++it_chargram_end) {
+        const int length_bytes =
+            it_chargram_end.utf8_data() - it_chargram_start.utf8_data();
+        result->push_back(HashToken(
+            StringPiece(it_chargram_start.utf8_data(), length_bytes),
+            &scratch->key));
       }
     }
   }
-  return result;
 }
 
 }  // namespace libtextclassifier3
@@ -17,6 +17,7 @@
 #define LIBTEXTCLASSIFIER_UTILS_TOKEN_FEATURE_EXTRACTOR_H_
 
 #include <memory>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
@@ -78,6 +79,22 @@ class TokenFeatureExtractor {
                std::vector<int>* sparse_features,
                std::vector<float>* dense_features) const;
 
+  // Buffers reused by the Extract overload below across tokens. Not
+  // thread-safe, each thread needs its own instance.
+  struct Scratch {
+    std::string remapped_word;
+    std::string feature_word;
+    std::string key;
+  };
+
+  // Like above, but writes into caller-owned memory: the sparse features
+  // replace the contents of 'sparse_features' (optional), whose capacity is
+  // reused, and exactly DenseFeaturesCount() dense features are written to
+  // 'dense_features'. Once the buffers have grown to fit the tokens, performs
+  // no heap allocations per token, except for matching the regexp features.
+  bool Extract(const Token& token, bool is_in_span, Scratch* scratch,
+               std::vector<int>* sparse_features, float* dense_features) const;
+
   // Extracts the sparse (charactergram) features from the token.
   std::vector<int> ExtractCharactergramFeatures(const Token& token) const;
 
@@ -97,6 +114,9 @@ class TokenFeatureExtractor {
   // Hashes given token to given number of buckets.
   int HashToken(StringPiece token) const;
 
+  // Same as above, but uses 'key' as a buffer for the allowed chargrams lookup.
+  int HashToken(StringPiece token, std::string* key) const;
+
   // Extracts the charactergram features from the token in a non-unicode-aware
   // way.
   std::vector<int> ExtractCharactergramFeaturesAscii(const Token& token) const;
@@ -105,6 +125,19 @@ class TokenFeatureExtractor {
   std::vector<int> ExtractCharactergramFeaturesUnicode(
       const Token& token) const;
 
+  // Versions of the above that append the features to 'result' and use the
+  // buffers of 'scratch' instead of temporaries.
+  void AppendCharactergramFeatures(const Token& token, Scratch* scratch,
+                                   std::vector<int>* result) const;
+  void AppendCharactergramFeaturesAscii(const Token& token, Scratch* scratch,
+                                        std::vector<int>* result) const;
+  void AppendCharactergramFeaturesUnicode(const Token& token, Scratch* scratch,
+                                          std::vector<int>* result) const;
+
+  // Writes the DenseFeaturesCount() dense features of the token to 'dest'.
+  void WriteDenseFeatures(const Token& token, bool is_in_span,
+                          float* dest) const;
+
  private:
   TokenFeatureExtractorOptions options_;
   std::vector<std::unique_ptr<UniLib::RegexPattern>> regex_patterns_;
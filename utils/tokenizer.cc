@@ -16,6 +16,7 @@
 #include "utils/tokenizer.h"
 
 #include <algorithm>
+#include <map>
 
 #include "utils/base/logging.h"
 #include "utils/base/macros.h"
@@ -49,6 +50,74 @@ Tokenizer::Tokenizer(
 
   SortCodepointRanges(internal_tokenizer_codepoint_ranges,
                       &internal_tokenizer_codepoint_ranges_);
+
+  BuildRoleAndScriptTable();
+}
+
+namespace {
+
+constexpr int kNumBmpCodepoints = 0x10000;
+constexpr int kBmpBlockSize = 256;
+
+// The role (a bit mask of up to 4 bits) is stored in the low bits of the
+// packed value, the script id, offset to make kUnknownScript zero, in the
+// remaining bits.
+constexpr int kRoleBits = 4;
+constexpr int kScriptOffset = -kUnknownScript;
+constexpr int kMaxPackedScript = (1 << (32 - kRoleBits - 1)) - 1;
+
+bool CanPackRoleAndScript(int role, int script) {
+  return role >= 0 && role < (1 << kRoleBits) && script + kScriptOffset >= 0 &&
+         script + kScriptOffset <= kMaxPackedScript;
+}
+
+uint32 PackRoleAndScript(int role, int script) {
+  return (static_cast<uint32>(script + kScriptOffset) << kRoleBits) | role;
+}
+
+void UnpackRoleAndScript(uint32 packed, TokenizationCodepointRange_::Role* role,
+                         int* script) {
+  *role = static_cast<TokenizationCodepointRange_::Role>(
+      packed & ((1 << kRoleBits) - 1));
+  *script = static_cast<int>(packed >> kRoleBits) - kScriptOffset;
+}
+
+}  // namespace
+
+void Tokenizer::BuildRoleAndScriptTable() {
+  for (const auto& range : codepoint_ranges_) {
+    if (!CanPackRoleAndScript(range->role, range->script_id)) {
+      return;
+    }
+  }
+
+  std::vector<uint32> bmp(
+      kNumBmpCodepoints,
+      PackRoleAndScript(TokenizationCodepointRange_::Role_DEFAULT_ROLE,
+                        kUnknownScript));
+  for (const auto& range : codepoint_ranges_) {
+    const uint32 packed = PackRoleAndScript(range->role, range->script_id);
+    for (int codepoint = std::max(range->start, 0);
+         codepoint < std::min(range->end, kNumBmpCodepoints); ++codepoint) {
+      bmp[codepoint] = packed;
+    }
+  }
+
+  // Store each distinct block only once, most of them are uniform.
+  std::map<std::vector<uint32>, int> block_offsets;
+  bmp_block_offsets_.resize(kNumBmpCodepoints / kBmpBlockSize);
+  for (int block = 0; block < bmp_block_offsets_.size(); ++block) {
+    std::vector<uint32> block_values(
+        bmp.begin() + block * kBmpBlockSize,
+        bmp.begin() + (block + 1) * kBmpBlockSize);
+    const auto it =
+        block_offsets.emplace(block_values, bmp_role_and_script_.size()).first;
+    if (it->second == bmp_role_and_script_.size()) {
+      bmp_role_and_script_.insert(bmp_role_and_script_.end(),
+                                  block_values.begin(), block_values.end());
+    }
+    bmp_block_offsets_[block] = it->second;
+  }
 }
 
 const TokenizationCodepointRangeT* Tokenizer::FindTokenizationRange(
@@ -79,6 +148,15 @@ const TokenizationCodepointRangeT* Tokenizer::FindTokenizationRange(
 void Tokenizer::GetScriptAndRole(char32 codepoint,
                                  TokenizationCodepointRange_::Role* role,
                                  int* script) const {
+  if (codepoint >= 0 && codepoint < kNumBmpCodepoints &&
+      !bmp_block_offsets_.empty()) {
+    UnpackRoleAndScript(
+        bmp_role_and_script_[bmp_block_offsets_[codepoint / kBmpBlockSize] +
+                             codepoint % kBmpBlockSize],
+        role, script);
+    return;
+  }
+
   const TokenizationCodepointRangeT* range = FindTokenizationRange(codepoint);
   if (range) {
     *role = range->role;
@@ -89,118 +167,247 @@ void Tokenizer::GetScriptAndRole(char32 codepoint,
   }
 }
 
+namespace {
+
+// Accumulates the codepoints of the token that is currently being built as a
+// range of the tokenized text.
+class TokenViewBuilder {
+ public:
+  // Starts a new, empty token at the given codepoint index.
+  void Reset(CodepointIndex start, bool is_whitespace = false) {
+    begin_ = nullptr;
+    end_ = nullptr;
+    start_ = start;
+    num_codepoints_ = 0;
+    is_whitespace_ = is_whitespace;
+    has_discarded_codepoints_ = false;
+    discarded_codepoint_pending_ = false;
+  }
+
+  void AddCodepoint(const char* codepoint_begin, int num_bytes) {
+    if (begin_ == nullptr) {
+      begin_ = codepoint_begin;
+    } else if (discarded_codepoint_pending_) {
+      has_discarded_codepoints_ = true;
+    }
+    end_ = codepoint_begin + num_bytes;
+    ++num_codepoints_;
+    discarded_codepoint_pending_ = false;
+  }
+
+  void AddCodepoint(UnicodeText::const_iterator it) {
+    AddCodepoint(it.utf8_data(), GetNumBytesForUTF8Char(it.utf8_data()));
+  }
+
+  // Records that a codepoint was skipped. It only ends up inside the token if
+  // more codepoints are added afterwards.
+  void DiscardCodepoint() {
+    if (begin_ != nullptr) {
+      discarded_codepoint_pending_ = true;
+    }
+  }
+
+  // Appends the token to the result, unless it is empty.
+  void AppendTo(std::vector<TokenView>* result) const {
+    if (begin_ == nullptr) {
+      return;
+    }
+    result->emplace_back(StringPiece(begin_, end_ - begin_), start_,
+                         start_ + num_codepoints_, is_whitespace_);
+    result->back().has_discarded_codepoints = has_discarded_codepoints_;
+  }
+
+ private:
+  const char* begin_ = nullptr;
+  const char* end_ = nullptr;
+  CodepointIndex start_ = 0;
+  int num_codepoints_ = 0;
+  bool is_whitespace_ = false;
+  bool has_discarded_codepoints_ = false;
+  bool discarded_codepoint_pending_ = false;
+};
+
+StringPiece CodepointValue(UnicodeText::const_iterator it) {
+  return StringPiece(it.utf8_data(), GetNumBytesForUTF8Char(it.utf8_data()));
+}
+
+}  // namespace
+
 std::vector<Token> Tokenizer::Tokenize(const std::string& text) const {
   UnicodeText text_unicode = UTF8ToUnicodeText(text, /*do_copy=*/false);
   return Tokenize(text_unicode);
 }
 
 std::vector<Token> Tokenizer::Tokenize(const UnicodeText& text_unicode) const {
+  std::vector<TokenView> token_views;
+  if (!TokenizeInto(text_unicode, &token_views)) {
+    return {};
+  }
+  std::vector<Token> result;
+  result.reserve(token_views.size());
+  for (const TokenView& token_view : token_views) {
+    result.push_back(ToToken(token_view));
+  }
+  return result;
+}
+
+bool Tokenizer::TokenizeInto(const UnicodeText& text_unicode,
+                             std::vector<TokenView>* tokens) const {
+  tokens->clear();
   switch (type_) {
     case TokenizationType_INTERNAL_TOKENIZER:
-      return InternalTokenize(text_unicode);
+      InternalTokenize(text_unicode, tokens);
+      return true;
     case TokenizationType_ICU:
       TC3_FALLTHROUGH_INTENDED;
     case TokenizationType_MIXED: {
-      std::vector<Token> result;
-      if (!ICUTokenize(text_unicode, &result)) {
-        return {};
+      if (!ICUTokenize(text_unicode, tokens)) {
+        tokens->clear();
+        return false;
       }
       if (type_ == TokenizationType_MIXED) {
-        InternalRetokenize(text_unicode, &result);
+        InternalRetokenize(text_unicode, tokens);
       }
-      return result;
+      return true;
     }
     case TokenizationType_LETTER_DIGIT: {
-      std::vector<Token> result;
-      if (!NumberTokenize(text_unicode, &result)) {
-        return {};
+      if (!NumberTokenize(text_unicode, tokens)) {
+        tokens->clear();
+        return false;
       }
-      return result;
+      return true;
     }
     default:
       TC3_LOG(ERROR) << "Unknown tokenization type specified. Using internal.";
-      return InternalTokenize(text_unicode);
+      InternalTokenize(text_unicode, tokens);
+      return true;
   }
 }
 
-void AppendCodepointToToken(UnicodeText::const_iterator it, Token* token) {
-  token->value += std::string(
-      it.utf8_data(), it.utf8_data() + GetNumBytesForUTF8Char(it.utf8_data()));
-}
-
-std::vector<Token> Tokenizer::InternalTokenize(
-    const UnicodeText& text_unicode) const {
-  std::vector<Token> result;
-  Token new_token("", 0, 0);
-  int codepoint_index = 0;
+Token Tokenizer::ToToken(const TokenView& token_view) const {
+  if (!token_view.has_discarded_codepoints) {
+    return Token(token_view.value.ToString(), token_view.start, token_view.end,
+                 /*is_padding=*/false, token_view.is_whitespace);
+  }
 
-  int last_script = kInvalidScript;
-  for (auto it = text_unicode.begin(); it != text_unicode.end();
-       ++it, ++codepoint_index) {
+  // Drop the codepoints that the tokenizer discarded from the value.
+  std::string value;
+  const UnicodeText token_unicode =
+      UTF8ToUnicodeText(token_view.value.data(), token_view.value.size(),
+                        /*do_copy=*/false);
+  for (auto it = token_unicode.begin(); it != token_unicode.end(); ++it) {
     TokenizationCodepointRange_::Role role;
     int script;
     GetScriptAndRole(*it, &role, &script);
+    if (!(role & TokenizationCodepointRange_::Role_DISCARD_CODEPOINT)) {
+      const StringPiece codepoint = CodepointValue(it);
+      value.append(codepoint.data(), codepoint.size());
+    }
+  }
+  return Token(value, token_view.start, token_view.end,
+               /*is_padding=*/false, token_view.is_whitespace);
+}
+
+void Tokenizer::InternalTokenize(const UnicodeText& text_unicode,
+                                 std::vector<TokenView>* result) const {
+  TokenViewBuilder new_token;
+  new_token.Reset(/*start=*/0);
+  int codepoint_index = 0;
 
+  int last_script = kInvalidScript;
+  auto process_codepoint = [this, &new_token, &codepoint_index, &last_script,
+                            result](const char* codepoint_begin, int num_bytes,
+                                    TokenizationCodepointRange_::Role role,
+                                    int script) {
     if (role & TokenizationCodepointRange_::Role_SPLIT_BEFORE ||
         (split_on_script_change_ && last_script != kInvalidScript &&
          last_script != script)) {
-      if (!new_token.value.empty()) {
-        result.push_back(new_token);
-      }
-      new_token = Token("", codepoint_index, codepoint_index);
+      new_token.AppendTo(result);
+      new_token.Reset(codepoint_index);
     }
     if (!(role & TokenizationCodepointRange_::Role_DISCARD_CODEPOINT)) {
-      new_token.end += 1;
-      AppendCodepointToToken(it, &new_token);
+      new_token.AddCodepoint(codepoint_begin, num_bytes);
+    } else {
+      new_token.DiscardCodepoint();
     }
     if (role & TokenizationCodepointRange_::Role_SPLIT_AFTER) {
-      if (!new_token.value.empty()) {
-        result.push_back(new_token);
-      }
-      new_token = Token("", codepoint_index + 1, codepoint_index + 1);
+      new_token.AppendTo(result);
+      new_token.Reset(codepoint_index + 1);
     }
 
     last_script = script;
-  }
-  if (!new_token.value.empty()) {
-    result.push_back(new_token);
-  }
+    ++codepoint_index;
+  };
 
-  return result;
+  // The roles of ASCII codepoints can be read from the table directly, without
+  // decoding the UTF8.
+  const uint32* ascii_role_and_script =
+      bmp_block_offsets_.empty()
+          ? nullptr
+          : bmp_role_and_script_.data() + bmp_block_offsets_[0];
+
+  const char* data = text_unicode.data();
+  const char* const data_end = data + text_unicode.size_bytes();
+  TokenizationCodepointRange_::Role role;
+  int script;
+  while (data < data_end) {
+    if (ascii_role_and_script != nullptr) {
+      const char* const ascii_end =
+          data + AsciiPrefixLength(data, data_end - data);
+      for (; data < ascii_end; ++data) {
+        UnpackRoleAndScript(ascii_role_and_script[static_cast<uint8>(*data)],
+                            &role, &script);
+        process_codepoint(data, /*num_bytes=*/1, role, script);
+      }
+      if (data >= data_end) {
+        break;
+      }
+    }
+
+    const int num_bytes = GetNumBytesForUTF8Char(data);
+    GetScriptAndRole(ValidCharToRune(data), &role, &script);
+    process_codepoint(data, num_bytes, role, script);
+    data += num_bytes;
+  }
+  new_token.AppendTo(result);
 }
 
 void Tokenizer::TokenizeSubstring(const UnicodeText& unicode_text,
                                   CodepointSpan span,
-                                  std::vector<Token>* result) const {
+                                  std::vector<TokenView>* result) const {
   if (span.first < 0) {
     // There is no span to tokenize.
     return;
   }
 
-  // Extract the substring.
-  UnicodeText text = UnicodeText::Substring(unicode_text, span.first,
-                                            span.second, /*do_copy=*/false);
+  // Extract the substring. It needs to point into the buffer of the full text,
+  // as the token views refer to it.
+  auto it_begin = unicode_text.begin();
+  std::advance(it_begin, span.first);
+  auto it_end = it_begin;
+  std::advance(it_end, span.second - span.first);
+  UnicodeText text;
+  text.PointToUTF8(it_begin.utf8_data(),
+                   it_end.utf8_data() - it_begin.utf8_data());
 
   // Run the tokenizer and update the token bounds to reflect the offset of the
   // substring.
-  std::vector<Token> tokens = InternalTokenize(text);
-
-  // Avoids progressive capacity increases in the for loop.
-  result->reserve(result->size() + tokens.size());
-  for (Token& token : tokens) {
-    token.start += span.first;
-    token.end += span.first;
-    result->emplace_back(std::move(token));
+  const int first_new_token = result->size();
+  InternalTokenize(text, result);
+  for (int i = first_new_token; i < result->size(); ++i) {
+    (*result)[i].start += span.first;
+    (*result)[i].end += span.first;
   }
 }
 
 void Tokenizer::InternalRetokenize(const UnicodeText& unicode_text,
-                                   std::vector<Token>* tokens) const {
-  std::vector<Token> result;
+                                   std::vector<TokenView>* tokens) const {
+  std::vector<TokenView> result;
+  result.reserve(tokens->size());
   CodepointSpan span(-1, -1);
-  for (Token& token : *tokens) {
-    const UnicodeText unicode_token_value =
-        UTF8ToUnicodeText(token.value, /*do_copy=*/false);
+  for (const TokenView& token : *tokens) {
+    const UnicodeText unicode_token_value = UTF8ToUnicodeText(
+        token.value.data(), token.value.size(), /*do_copy=*/false);
     bool should_retokenize = true;
     for (const int codepoint : unicode_token_value) {
       if (!IsCodepointInRanges(codepoint,
@@ -218,7 +425,7 @@ void Tokenizer::InternalRetokenize(const UnicodeText& unicode_text,
     } else {
       TokenizeSubstring(unicode_text, span, &result);
       span.first = -1;
-      result.emplace_back(std::move(token));
+      result.push_back(token);
     }
   }
   TokenizeSubstring(unicode_text, span, &result);
@@ -227,7 +434,7 @@ void Tokenizer::InternalRetokenize(const UnicodeText& unicode_text,
 }
 
 bool Tokenizer::ICUTokenize(const UnicodeText& context_unicode,
-                            std::vector<Token>* result) const {
+                            std::vector<TokenView>* result) const {
   std::unique_ptr<UniLib::BreakIterator> break_iterator =
       unilib_->CreateBreakIterator(context_unicode);
   if (!break_iterator) {
@@ -252,12 +459,11 @@ bool Tokenizer::ICUTokenize(const UnicodeText& context_unicode,
       }
     }
 
-    const std::string token =
-        context_unicode.UTF8Substring(token_begin_it, token_end_it);
-
     if (!is_whitespace || icu_preserve_whitespace_tokens_) {
-      result->push_back(Token(token, last_unicode_index, unicode_index,
-                              /*is_padding=*/false, is_whitespace));
+      result->emplace_back(
+          StringPiece(token_begin_it.utf8_data(),
+                      token_end_it.utf8_data() - token_begin_it.utf8_data()),
+          last_unicode_index, unicode_index, is_whitespace);
     }
 
     last_unicode_index = unicode_index;
@@ -268,40 +474,33 @@ bool Tokenizer::ICUTokenize(const UnicodeText& context_unicode,
 }
 
 bool Tokenizer::NumberTokenize(const UnicodeText& text_unicode,
-                               std::vector<Token>* result) const {
-  Token new_token("", 0, 0);
+                               std::vector<TokenView>* result) const {
+  TokenViewBuilder new_token;
+  new_token.Reset(/*start=*/0);
   NumberTokenType current_token_type = NOT_SET;
   int codepoint_index = 0;
 
-  auto PushToken = [&new_token, result]() {
-    if (!new_token.value.empty()) {
-      result->push_back(new_token);
-    }
-  };
-
   auto MaybeResetTokenAndAddChar =
-      [&new_token, PushToken, &current_token_type](
+      [&new_token, result, &current_token_type](
           int codepoint_index, NumberTokenType token_type,
           UnicodeText::const_iterator it, bool is_whitespace = false) {
         if (current_token_type != token_type) {
-          PushToken();
-          new_token = Token("", codepoint_index, codepoint_index,
-                            /*is_padding=*/false, is_whitespace);
+          new_token.AppendTo(result);
+          new_token.Reset(codepoint_index, is_whitespace);
         }
-        new_token.end += 1;
-        AppendCodepointToToken(it, &new_token);
+        new_token.AddCodepoint(it);
         current_token_type = token_type;
       };
 
   auto FinishTokenAndAddSeparator =
-      [&new_token, result, &current_token_type, PushToken](
+      [&new_token, result, &current_token_type](
           int codepoint_index, UnicodeText::const_iterator it) {
-        PushToken();
+        new_token.AppendTo(result);
 
-        result->emplace_back("", codepoint_index, codepoint_index + 1);
-        AppendCodepointToToken(it, &result->back());
+        result->emplace_back(CodepointValue(it), codepoint_index,
+                             codepoint_index + 1);
 
-        new_token = Token("", codepoint_index + 1, codepoint_index + 1);
+        new_token.Reset(codepoint_index + 1);
         current_token_type = NOT_SET;
       };
 
@@ -318,8 +517,7 @@ bool Tokenizer::NumberTokenize(const UnicodeText& text_unicode,
       auto it_next = std::next(it);
       if (current_token_type == NUMERICAL && it_next != text_unicode.end() &&
           unilib_->IsDigit(*it_next)) {
-        new_token.end += 1;
-        AppendCodepointToToken(it, &new_token);
+        new_token.AddCodepoint(it);
       } else {
         // If the current token is not a number or dot at the end or followed
         // by a non digit => separate token
@@ -329,7 +527,7 @@ bool Tokenizer::NumberTokenize(const UnicodeText& text_unicode,
       FinishTokenAndAddSeparator(codepoint_index, it);
     }
   }
-  PushToken();
+  new_token.AppendTo(result);
 
   return true;
 }
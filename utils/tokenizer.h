@@ -94,6 +94,16 @@ class Tokenizer {
   // Same as above but takes UnicodeText.
   std::vector<Token> Tokenize(const UnicodeText& text_unicode) const;
 
+  // Same as above, but instead of copying the token values, records the tokens
+  // as views into the UTF8 buffer of 'text_unicode', which must outlive them.
+  // Replaces the contents of 'tokens', reusing its capacity. Returns false if
+  // the tokenization failed.
+  bool TokenizeInto(const UnicodeText& text_unicode,
+                    std::vector<TokenView>* tokens) const;
+
+  // Creates an owning token from a token view produced by this tokenizer.
+  Token ToToken(const TokenView& token_view) const;
+
  protected:
   // Finds the tokenization codepoint range config for given codepoint.
   // Internally uses binary search so should be O(log(# of codepoint_ranges)).
@@ -105,26 +115,32 @@ class Tokenizer {
                         TokenizationCodepointRange_::Role* role,
                         int* script) const;
 
+  // Precomputes the direct-indexed role and script table of the BMP.
+  void BuildRoleAndScriptTable();
+
   // Tokenizes a substring of the unicode string, appending the resulting tokens
   // to the output vector. The resulting tokens have bounds relative to the full
   // string. Does nothing if the start of the span is negative.
   void TokenizeSubstring(const UnicodeText& unicode_text, CodepointSpan span,
-                         std::vector<Token>* result) const;
+                         std::vector<TokenView>* result) const;
 
-  std::vector<Token> InternalTokenize(const UnicodeText& text_unicode) const;
+  // Tokenizes the input text using the internal tokenizer, appending the tokens
+  // to the output vector.
+  void InternalTokenize(const UnicodeText& text_unicode,
+                        std::vector<TokenView>* result) const;
 
   // Takes the result of ICU tokenization and retokenizes stretches of tokens
   // made of a specific subset of characters using the internal tokenizer.
   void InternalRetokenize(const UnicodeText& unicode_text,
-                          std::vector<Token>* tokens) const;
+                          std::vector<TokenView>* tokens) const;
 
   // Tokenizes the input text using ICU tokenizer.
   bool ICUTokenize(const UnicodeText& context_unicode,
-                   std::vector<Token>* result) const;
+                   std::vector<TokenView>* result) const;
 
   // Tokenizes the input in number, word and separator tokens.
   bool NumberTokenize(const UnicodeText& text_unicode,
-                      std::vector<Token>* result) const;
+                      std::vector<TokenView>* result) const;
 
  private:
   const TokenizationType type_;
@@ -136,6 +152,15 @@ class Tokenizer {
   std::vector<std::unique_ptr<const TokenizationCodepointRangeT>>
       codepoint_ranges_;
 
+  // Role and script of every BMP codepoint, packed into one value each (see
+  // BuildRoleAndScriptTable). The codepoints are split into blocks of 256,
+  // 'bmp_block_offsets_' holds the offset of the table of each block into
+  // 'bmp_role_and_script_', where identical blocks are stored only once.
+  // Empty if the script ids cannot be packed, in which case the codepoint
+  // ranges are searched for every codepoint.
+  std::vector<int> bmp_block_offsets_;
+  std::vector<uint32> bmp_role_and_script_;
+
   // Codepoint ranges that define which tokens (consisting of which codepoints)
   // should be re-tokenized with the internal tokenizer in the mixed
   // tokenization mode.
@@ -0,0 +1,158 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "utils/benchmark-data.h"
+#include "utils/token-feature-extractor.h"
+#include "utils/tokenizer.h"
+#include "utils/tokenizer_generated.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+// Holds the flatbuffers backing the codepoint ranges of a tokenizer.
+class CodepointRanges {
+ public:
+  void Add(int start, int end, TokenizationCodepointRange_::Role role,
+           int script_id = 0) {
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(CreateTokenizationCodepointRange(builder, start, end, role,
+                                                    script_id));
+    buffers_.emplace_back(builder.Release());
+  }
+
+  std::vector<const TokenizationCodepointRange*> Get() const {
+    std::vector<const TokenizationCodepointRange*> ranges;
+    for (const flatbuffers::DetachedBuffer& buffer : buffers_) {
+      ranges.push_back(
+          flatbuffers::GetRoot<TokenizationCodepointRange>(buffer.data()));
+    }
+    return ranges;
+  }
+
+ private:
+  std::vector<flatbuffers::DetachedBuffer> buffers_;
+};
+
+// Whitespace and ASCII punctuation split the tokens, CJK codepoints are
+// tokens of their own, roughly like the production configurations.
+CodepointRanges DefaultCodepointRanges() {
+  CodepointRanges ranges;
+  ranges.Add(0, 33, TokenizationCodepointRange_::Role_WHITESPACE_SEPARATOR);
+  ranges.Add(33, 48, TokenizationCodepointRange_::Role_TOKEN_SEPARATOR);
+  ranges.Add(58, 65, TokenizationCodepointRange_::Role_TOKEN_SEPARATOR);
+  ranges.Add(0x3000, 0x3001,
+             TokenizationCodepointRange_::Role_WHITESPACE_SEPARATOR);
+  ranges.Add(0x4E00, 0x9FFF, TokenizationCodepointRange_::Role_TOKEN_SEPARATOR,
+             /*script_id=*/1);
+  return ranges;
+}
+
+void BM_Tokenize(benchmark::State& state, TokenizationType type) {
+  const UniLib unilib;
+  const CodepointRanges ranges = DefaultCodepointRanges();
+  const Tokenizer tokenizer(type, &unilib, ranges.Get(),
+                            /*internal_tokenizer_codepoint_ranges=*/{},
+                            /*split_on_script_change=*/true,
+                            /*icu_preserve_whitespace_tokens=*/false);
+  const std::string text = benchmark_data::SyntheticText(state.range(0));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tokenizer.Tokenize(text));
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_CAPTURE(BM_Tokenize, Internal, TokenizationType_INTERNAL_TOKENIZER)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_CAPTURE(BM_Tokenize, Icu, TokenizationType_ICU)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_CAPTURE(BM_Tokenize, LetterDigit, TokenizationType_LETTER_DIGIT)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+
+void BM_TokenizeInto(benchmark::State& state, TokenizationType type) {
+  const UniLib unilib;
+  const CodepointRanges ranges = DefaultCodepointRanges();
+  const Tokenizer tokenizer(type, &unilib, ranges.Get(),
+                            /*internal_tokenizer_codepoint_ranges=*/{},
+                            /*split_on_script_change=*/true,
+                            /*icu_preserve_whitespace_tokens=*/false);
+  const std::string text = benchmark_data::SyntheticText(state.range(0));
+  const UnicodeText text_unicode = UTF8ToUnicodeText(text, /*do_copy=*/false);
+
+  std::vector<TokenView> tokens;
+  for (auto _ : state) {
+    tokenizer.TokenizeInto(text_unicode, &tokens);
+    benchmark::DoNotOptimize(tokens.data());
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK_CAPTURE(BM_TokenizeInto, Internal,
+                  TokenizationType_INTERNAL_TOKENIZER)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_CAPTURE(BM_TokenizeInto, LetterDigit, TokenizationType_LETTER_DIGIT)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+
+void BM_TokenFeatureExtractorExtract(benchmark::State& state) {
+  const UniLib unilib;
+  TokenFeatureExtractorOptions options;
+  options.num_buckets = 1000;
+  options.chargram_orders = {1, 2, 3};
+  options.extract_case_feature = true;
+  options.unicode_aware_features = state.range(0);
+  options.extract_selection_mask_feature = true;
+  options.remap_digits = true;
+  const TokenFeatureExtractor extractor(options, &unilib);
+
+  const CodepointRanges ranges = DefaultCodepointRanges();
+  const Tokenizer tokenizer(ranges.Get(), /*split_on_script_change=*/true);
+  const std::vector<Token> tokens =
+      tokenizer.Tokenize(benchmark_data::SyntheticText(/*num_words=*/100));
+
+  std::vector<int> sparse_features;
+  std::vector<float> dense_features;
+  for (auto _ : state) {
+    for (const Token& token : tokens) {
+      sparse_features.clear();
+      dense_features.clear();
+      extractor.Extract(token, /*is_in_span=*/false, &sparse_features,
+                        &dense_features);
+      benchmark::DoNotOptimize(sparse_features.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_TokenFeatureExtractorExtract)
+    ->ArgName("unicode_aware")
+    ->Arg(0)
+    ->Arg(1);
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -23,6 +23,27 @@
 
 namespace libtextclassifier3 {
 
+UNumberFormat* UniLibBase::GetNumberFormat() {
+  static thread_local std::unique_ptr<UNumberFormat,
+                                      std::function<void(UNumberFormat*)>>
+      format = [] {
+        UErrorCode status = U_ZERO_ERROR;
+        UNumberFormat* format_alias =
+            unum_open(/*style=*/UNUM_DECIMAL, /*pattern=*/nullptr,
+                      /*patternLength=*/0, /*locale=*/"en_US_POSIX",
+                      /*parseErr=*/nullptr, &status);
+        if (U_FAILURE(status)) {
+          unum_close(format_alias);
+          format_alias = nullptr;
+        }
+        return std::unique_ptr<UNumberFormat,
+                               std::function<void(UNumberFormat*)>>(
+            format_alias,
+            [](UNumberFormat* format_alias) { unum_close(format_alias); });
+      }();
+  return format.get();
+}
+
 bool UniLibBase::ParseInt32(const UnicodeText& text, int32* result) const {
   return ParseInt(text, result);
 }
@@ -32,17 +53,6 @@ bool UniLibBase::ParseInt64(const UnicodeText& text, int64* result) const {
 }
 
 bool UniLibBase::ParseDouble(const UnicodeText& text, double* result) const {
-  UErrorCode status = U_ZERO_ERROR;
-  std::unique_ptr<UNumberFormat, std::function<void(UNumberFormat*)>>
-      format_alias(
-          unum_open(/*style=*/UNUM_DECIMAL, /*pattern=*/nullptr,
-                    /*patternLength=*/0, /*locale=*/"en_US_POSIX",
-                    /*parseErr=*/nullptr, &status),
-          [](UNumberFormat* format_alias) { unum_close(format_alias); });
-  if (U_FAILURE(status)) {
-    return false;
-  }
-
   auto it_dot = text.begin();
   for (; it_dot != text.end() && !IsDot(*it_dot); it_dot++) {
   }
@@ -131,16 +141,19 @@ UniLibBase::RegexPattern::RegexPattern(const UnicodeText& pattern, bool lazy)
       initialization_failure_(false),
       pattern_text_(pattern) {
   if (!lazy) {
-    LockedInitializeIfNotAlready();
+    InitializeIfNotAlready();
   }
 }
 
-void UniLibBase::RegexPattern::LockedInitializeIfNotAlready() const {
-  std::lock_guard<std::mutex> guard(mutex_);
-  if (initialized_ || initialization_failure_) {
+void UniLibBase::RegexPattern::InitializeIfNotAlready() const {
+  // Fast path: the initialization has already been done.
+  if (initialized_.load(std::memory_order_acquire)) {
     return;
   }
+  std::call_once(once_flag_, [this]() { Initialize(); });
+}
 
+void UniLibBase::RegexPattern::Initialize() const {
   UErrorCode status = U_ZERO_ERROR;
   pattern_.reset(icu::RegexPattern::compile(
       icu::UnicodeString::fromUTF8(
@@ -149,15 +162,20 @@ void UniLibBase::RegexPattern::LockedInitializeIfNotAlready() const {
   if (U_FAILURE(status) || pattern_ == nullptr) {
     initialization_failure_ = true;
     pattern_.reset();
-    return;
+  } else {
+    pattern_text_.clear();  // We don't need this anymore.
   }
-  initialized_ = true;
-  pattern_text_.clear();  // We don't need this anymore.
+  initialized_.store(true, std::memory_order_release);
+}
+
+bool UniLibBase::RegexPattern::Compile() const {
+  InitializeIfNotAlready();
+  return !initialization_failure_;
 }
 
 std::unique_ptr<UniLibBase::RegexMatcher> UniLibBase::RegexPattern::Matcher(
     const UnicodeText& input) const {
-  LockedInitializeIfNotAlready();  // Possibly lazy initialization.
+  InitializeIfNotAlready();  // Possibly lazy initialization.
   if (initialization_failure_) {
     return nullptr;
   }
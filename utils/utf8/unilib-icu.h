@@ -19,6 +19,7 @@
 #ifndef LIBTEXTCLASSIFIER_UTILS_UTF8_UNILIB_ICU_H_
 #define LIBTEXTCLASSIFIER_UTILS_UTF8_UNILIB_ICU_H_
 
+#include <atomic>
 #include <cmath>
 #include <functional>
 #include <memory>
@@ -130,17 +131,24 @@ class UniLibBase {
    public:
     std::unique_ptr<RegexMatcher> Matcher(const UnicodeText& input) const;
 
+    // Compiles the pattern now if it is lazily compiled and was not compiled
+    // yet, e.g. to move the compilation cost out of the first request.
+    // Returns false if the pattern could not be compiled.
+    bool Compile() const;
+
    private:
     friend class UniLibBase;
     explicit RegexPattern(const UnicodeText& pattern, bool lazy = false);
-    void LockedInitializeIfNotAlready() const;
+    void InitializeIfNotAlready() const;
+    void Initialize() const;
 
     // These members need to be mutable because of the lazy initialization.
-    // NOTE: The Matcher method first ensures (using a lock) that the
-    // initialization was attempted (by using LockedInitializeIfNotAlready) and
-    // then can access them without locking.
-    mutable std::mutex mutex_;
-    mutable bool initialized_;
+    // NOTE: The initialization runs exactly once (guarded by once_flag_), after
+    // which initialized_ is set. Once initialized_ is observed as true, the
+    // other members are only read, so the Matcher method does not need to take
+    // any lock in the steady state.
+    mutable std::once_flag once_flag_;
+    mutable std::atomic<bool> initialized_;
     mutable bool initialization_failure_;
     mutable UnicodeText pattern_text_;
     mutable std::unique_ptr<icu::RegexPattern> pattern_;
@@ -173,43 +181,63 @@ class UniLibBase {
  private:
   template <class T>
   bool ParseInt(const UnicodeText& text, T* result) const;
+
+  // Returns the number format used for parsing, opened once per thread as
+  // that is expensive. Null if it could not be opened.
+  static UNumberFormat* GetNumberFormat();
+
+  // Longest run of ASCII digits that always fits into an uint64.
+  static constexpr int kMaxAsciiDigits = 19;
 };
 
 template <class T>
 bool UniLibBase::ParseInt(const UnicodeText& text, T* result) const {
-  // Fail fast if the text is unlikely to be a number (consistency with
-  // javaicu).
-  if (!PassesIntPreChesks(text, result)) {
-    return false;
-  }
-
+  // Plain ASCII digits, by far the most common, are converted directly if they
+  // fit. The value is rounded to double like the parse below to get the same
+  // results, so this only short-circuits the parse and accepts the same texts.
+  double double_parse;
+  int parse_index = 0;
+  int parse_length = 0;
   UErrorCode status = U_ZERO_ERROR;
-  std::unique_ptr<UNumberFormat, std::function<void(UNumberFormat*)>>
-      format_alias(
-          unum_open(/*style=*/UNUM_DECIMAL, /*pattern=*/nullptr,
-                    /*patternLength=*/0, /*locale=*/"en_US_POSIX",
-                    /*parseErr=*/nullptr, &status),
-          [](UNumberFormat* format_alias) { unum_close(format_alias); });
-  if (U_FAILURE(status)) {
-    return false;
+  const char* const begin = text.data();
+  const char* const end = begin + text.size_bytes();
+  const char* it = begin;
+  uint64 ascii_value = 0;
+  for (; it != end && *it >= '0' && *it <= '9' &&
+         it - begin < kMaxAsciiDigits;
+       ++it) {
+    ascii_value = ascii_value * 10 + (*it - '0');
   }
-  icu::UnicodeString utf8_string = icu::UnicodeString::fromUTF8(
-      icu::StringPiece(text.data(), text.size_bytes()));
-  int parse_index = 0;
+  if (it == end && !text.empty()) {
+    double_parse = static_cast<double>(ascii_value);
+  } else {
+    // Fail fast if the text is unlikely to be a number (consistency with
+    // javaicu).
+    if (!PassesIntPreChesks(text, result)) {
+      return false;
+    }
 
-  // Using the unum_parseDouble here because unum_parse called for an input
-  // like "1.23" returns 1, parse_index == utf8_string.length() and the status
-  // is not error. Consequently there is no indication about floating numbers.
-  const double double_parse =
-      unum_parseDouble(format_alias.get(), utf8_string.getBuffer(),
-                       utf8_string.length(), &parse_index, &status);
+    UNumberFormat* format = GetNumberFormat();
+    if (format == nullptr) {
+      return false;
+    }
+    icu::UnicodeString utf16_text =
+        icu::UnicodeString::fromUTF8(icu::StringPiece(begin, end - begin));
+    parse_length = utf16_text.length();
+
+    // Using the unum_parseDouble here because unum_parse called for an input
+    // like "1.23" returns 1, parse_index == parse_length and the status is
+    // not error. Consequently there is no indication about floating numbers.
+    double_parse = unum_parseDouble(format, utf16_text.getBuffer(),
+                                    parse_length, &parse_index, &status);
+  }
   if (isnan(double_parse) || isinf(double_parse) ||
       double_parse >= std::numeric_limits<T>::max() ||
       double_parse <= std::numeric_limits<T>::min()) {
     return false;
   }
   *result = std::trunc(double_parse);
-  if (U_FAILURE(status) || parse_index != utf8_string.length() ||
+  if (U_FAILURE(status) || parse_index != parse_length ||
       *result != double_parse) {
     return false;
   }
@@ -0,0 +1,87 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <string>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/benchmark-data.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+#include "benchmark/benchmark.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+// Returns number candidates as found in number-heavy texts, with
+// 'num_digits' digits each. If 'arabic_indic' is set, the digits are
+// Arabic-Indic (U+0660-U+0669) instead of ASCII.
+std::vector<std::string> SyntheticNumbers(int num_numbers, int num_digits,
+                                          bool arabic_indic) {
+  benchmark_data::Random random(42);
+  std::vector<std::string> numbers(num_numbers);
+  for (std::string& number : numbers) {
+    for (int i = 0; i < num_digits; ++i) {
+      const int digit = random.Uniform(10);
+      if (arabic_indic) {
+        number += "\xD9";
+        number += static_cast<char>(0xA0 + digit);
+      } else {
+        number += static_cast<char>('0' + digit);
+      }
+    }
+  }
+  return numbers;
+}
+
+void BM_ParseInt32(benchmark::State& state, bool arabic_indic) {
+  const UniLib unilib;
+  std::vector<UnicodeText> numbers;
+  for (const std::string& number :
+       SyntheticNumbers(/*num_numbers=*/64, state.range(0), arabic_indic)) {
+    numbers.push_back(UTF8ToUnicodeText(number));
+  }
+
+  for (auto _ : state) {
+    for (const UnicodeText& number : numbers) {
+      int32 value;
+      benchmark::DoNotOptimize(unilib.ParseInt32(number, &value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numbers.size());
+}
+BENCHMARK_CAPTURE(BM_ParseInt32, ascii, /*arabic_indic=*/false)->Arg(4);
+BENCHMARK_CAPTURE(BM_ParseInt32, arabic_indic, /*arabic_indic=*/true)->Arg(4);
+
+void BM_ParseDouble(benchmark::State& state) {
+  const UniLib unilib;
+  std::vector<UnicodeText> numbers;
+  for (const std::string& number : SyntheticNumbers(
+           /*num_numbers=*/64, state.range(0), /*arabic_indic=*/false)) {
+    numbers.push_back(UTF8ToUnicodeText(number + "." + number));
+  }
+
+  for (auto _ : state) {
+    for (const UnicodeText& number : numbers) {
+      double value;
+      benchmark::DoNotOptimize(unilib.ParseDouble(number, &value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numbers.size());
+}
+BENCHMARK(BM_ParseDouble)->Arg(4);
+
+}  // namespace
+}  // namespace libtextclassifier3